@@ -77,6 +77,8 @@ struct _EmpathyChatViewIface {
 						  gboolean         has_focus);
 	void             (*message_acknowledged) (EmpathyChatView *view,
 						  EmpathyMessage  *message);
+	void             (*begin_batch)          (EmpathyChatView *view);
+	void             (*end_batch)            (EmpathyChatView *view);
 };
 
 GType            empathy_chat_view_get_type             (void) G_GNUC_CONST;
@@ -115,6 +117,8 @@ void             empathy_chat_view_focus_toggled        (EmpathyChatView *view,
 							 gboolean         has_focus);
 void             empathy_chat_view_message_acknowledged (EmpathyChatView *view,
 							 EmpathyMessage  *message);
+void             empathy_chat_view_begin_batch          (EmpathyChatView *view);
+void             empathy_chat_view_end_batch            (EmpathyChatView *view);
 
 G_END_DECLS
 
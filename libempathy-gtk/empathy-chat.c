@@ -66,6 +66,8 @@
 
 #define IS_ENTER(v) (v == GDK_KEY_Return || v == GDK_KEY_ISO_Enter || v == GDK_KEY_KP_Enter)
 #define COMPOSING_STOP_TIMEOUT 5
+/* Number of words spell checked by each run of update_misspelled_words () */
+#define SPELL_CHECK_CHUNK 64
 
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyChat)
 struct _EmpathyChatPriv {
@@ -102,7 +104,8 @@ struct _EmpathyChatPriv {
 	gulong		   delete_range_id;
 	gulong		   notify_cursor_position_id;
 
-	/* Source func ID for update_misspelled_words () */
+	/* Source func ID for update_misspelled_words (), which checks the
+	 * words tagged "spell-check-pending" */
 	guint              update_misspelled_words_id;
 	/* Source func ID for save_paned_pos_timeout () */
 	guint              save_paned_pos_id;
@@ -1678,6 +1681,67 @@ chat_input_text_get_word_from_iter (GtkTextIter   *iter,
 	return TRUE;
 }
 
+/* The word being typed isn't flagged, it's checked once the cursor leaves
+ * it */
+static void
+chat_input_check_word (GtkTextBuffer *buffer,
+                       GtkTextIter   *start,
+                       GtkTextIter   *end,
+                       GtkTextIter   *pos)
+{
+	gchar *str;
+
+	str = gtk_text_buffer_get_text (buffer, start, end, FALSE);
+
+	if (gtk_text_iter_in_range (pos, start, end) ||
+			gtk_text_iter_equal (pos, end) ||
+			empathy_spell_check (str)) {
+		gtk_text_buffer_remove_tag_by_name (buffer, "misspelled", start, end);
+	} else {
+		gtk_text_buffer_apply_tag_by_name (buffer, "misspelled", start, end);
+	}
+
+	g_free (str);
+}
+
+/* Words are checked in idles, a few at a time, so pasting a lot of text
+ * doesn't block the UI. Only the words overlapping the edited ranges are
+ * tagged as pending, and the tag moves along with the text. */
+static void
+chat_input_spell_check_range (EmpathyChat       *chat,
+                              const GtkTextIter *start,
+                              const GtkTextIter *end)
+{
+	EmpathyChatPriv *priv = GET_PRIV (chat);
+	GtkTextBuffer *buffer = gtk_text_iter_get_buffer (start);
+	GtkTextIter iter, range_start, range_end, tmp;
+
+	iter = *start;
+	chat_input_text_get_word_from_iter (&iter, &range_start, &tmp);
+	iter = *end;
+	chat_input_text_get_word_from_iter (&iter, &tmp, &range_end);
+
+	gtk_text_buffer_apply_tag_by_name (buffer, "spell-check-pending",
+					   &range_start, &range_end);
+
+	if (priv->update_misspelled_words_id == 0) {
+		priv->update_misspelled_words_id =
+			g_idle_add (update_misspelled_words, chat);
+	}
+}
+
+static void
+chat_input_spell_check_all (EmpathyChat *chat)
+{
+	GtkTextBuffer *buffer;
+	GtkTextIter start, end;
+
+	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (chat->input_text_view));
+	gtk_text_buffer_get_bounds (buffer, &start, &end);
+
+	chat_input_spell_check_range (chat, &start, &end);
+}
+
 static void
 chat_input_text_buffer_insert_text_cb (GtkTextBuffer *buffer,
                                        GtkTextIter   *location,
@@ -1685,38 +1749,17 @@ chat_input_text_buffer_insert_text_cb (GtkTextBuffer *buffer,
                                        gint           len,
                                        EmpathyChat   *chat)
 {
-	GtkTextIter iter, pos;
+	GtkTextIter start;
 
 	/* Remove all misspelled tags in the inserted text.
 	 * This happens when text is inserted within a misspelled word. */
-	gtk_text_buffer_get_iter_at_offset (buffer, &iter,
-					    gtk_text_iter_get_offset (location) - len);
+	gtk_text_buffer_get_iter_at_offset (buffer, &start,
+					    gtk_text_iter_get_offset (location) -
+					    g_utf8_strlen (text, len));
 	gtk_text_buffer_remove_tag_by_name (buffer, "misspelled",
-					    &iter, location);
-
-	gtk_text_buffer_get_iter_at_mark (buffer, &pos, gtk_text_buffer_get_insert (buffer));
+					    &start, location);
 
-	do {
-		GtkTextIter start, end;
-		gchar *str;
-
-		if (!chat_input_text_get_word_from_iter (&iter, &start, &end))
-			continue;
-
-		str = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
-
-		if (gtk_text_iter_in_range (&pos, &start, &end) ||
-				gtk_text_iter_equal (&pos, &end) ||
-				empathy_spell_check (str)) {
-			gtk_text_buffer_remove_tag_by_name (buffer, "misspelled", &start, &end);
-		} else {
-			gtk_text_buffer_apply_tag_by_name (buffer, "misspelled", &start, &end);
-		}
-
-		g_free (str);
-
-	} while (gtk_text_iter_forward_word_end (&iter) &&
-		 gtk_text_iter_compare (&iter, location) <= 0);
+	chat_input_spell_check_range (chat, &start, location);
 }
 
 static void
@@ -1731,6 +1774,9 @@ chat_input_text_buffer_delete_range_cb (GtkTextBuffer *buffer,
 		gtk_text_buffer_remove_tag_by_name (buffer, "misspelled",
 						    &word_start, &word_end);
 	}
+
+	/* The words before and after the deleted text may be one now */
+	chat_input_spell_check_range (chat, start, end);
 }
 
 static void
@@ -2176,8 +2222,7 @@ chat_add_to_dictionary_activate_cb (GtkMenuItem     *menu_item,
 
 	empathy_spell_add_to_dictionary (chat_word->code,
 					 chat_word->word);
-	priv->update_misspelled_words_id =
-		g_idle_add (update_misspelled_words, chat_word->chat);
+	chat_input_spell_check_all (chat_word->chat);
 }
 
 static GtkWidget *
@@ -2460,6 +2505,10 @@ got_filtered_messages_cb (GObject *manager,
 	EmpathyChatPriv *priv = GET_PRIV (chat);
 	GError *error = NULL;
 
+	/* Display the whole backlog, and the pending messages following it,
+	 * in one go */
+	empathy_chat_view_begin_batch (chat->view);
+
 	if (!tpl_log_manager_get_filtered_events_finish (TPL_LOG_MANAGER (manager),
 		result, &messages, &error)) {
 		DEBUG ("%s. Aborting.", error->message);
@@ -2512,6 +2561,8 @@ out:
 	priv->can_show_pending = TRUE;
 	show_pending_messages (chat);
 
+	empathy_chat_view_end_batch (chat->view);
+
 	/* FIXME: See Bug#610994, we are forcing the ACK of the queue. See comments
 	 * about it in EmpathyChatPriv definition */
 	priv->retrieving_backlogs = FALSE;
@@ -2861,15 +2912,59 @@ update_misspelled_words (gpointer data)
 	EmpathyChat *chat = EMPATHY_CHAT (data);
 	EmpathyChatPriv *priv = GET_PRIV (chat);
 	GtkTextBuffer *buffer;
-	GtkTextIter iter;
-	gint length;
+	GtkTextTag *pending;
+	GtkTextIter iter, pos;
+	guint n_words = 0;
 
 	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (chat->input_text_view));
+	pending = gtk_text_tag_table_lookup (
+			gtk_text_buffer_get_tag_table (buffer),
+			"spell-check-pending");
 
-	gtk_text_buffer_get_end_iter (buffer, &iter);
-	length = gtk_text_iter_get_offset (&iter);
-	chat_input_text_buffer_insert_text_cb (buffer, &iter,
-					       NULL, length, chat);
+	gtk_text_buffer_get_iter_at_mark (buffer, &pos,
+					  gtk_text_buffer_get_insert (buffer));
+	gtk_text_buffer_get_start_iter (buffer, &iter);
+
+	while (gtk_text_iter_has_tag (&iter, pending) ||
+	       gtk_text_iter_forward_to_tag_toggle (&iter, pending)) {
+		GtkTextIter end, word, checked;
+
+		end = iter;
+		gtk_text_iter_forward_to_tag_toggle (&end, pending);
+
+		word = iter;
+		checked = iter;
+
+		do {
+			GtkTextIter word_start, word_end;
+
+			chat_input_text_get_word_from_iter (&word,
+							    &word_start,
+							    &word_end);
+			if (gtk_text_iter_equal (&word_start, &word_end))
+				continue;
+
+			chat_input_check_word (buffer, &word_start, &word_end,
+					       &pos);
+			n_words++;
+
+			if (gtk_text_iter_compare (&word_end, &checked) > 0)
+				checked = word_end;
+		} while (n_words < SPELL_CHECK_CHUNK &&
+			 gtk_text_iter_forward_word_end (&word) &&
+			 gtk_text_iter_compare (&word, &end) <= 0);
+
+		if (gtk_text_iter_compare (&checked, &end) < 0 &&
+		    n_words >= SPELL_CHECK_CHUNK) {
+			/* The rest is checked in the next idle */
+			gtk_text_buffer_remove_tag (buffer, pending,
+						    &iter, &checked);
+			return TRUE;
+		}
+
+		gtk_text_buffer_remove_tag (buffer, pending, &iter, &end);
+		iter = end;
+	}
 
 	priv->update_misspelled_words_id = 0;
 
@@ -2901,10 +2996,9 @@ conf_spell_checking_cb (GSettings *gsettings_chat,
 	if (spell_checker == priv->spell_checking_enabled) {
 		if (spell_checker) {
 			/* Possibly changed dictionaries,
-			 * update misspelled words. Need to do so in idle
+			 * update misspelled words. They're checked in idle
 			 * so the spell checker is updated. */
-			priv->update_misspelled_words_id =
-				g_idle_add (update_misspelled_words, chat);
+			chat_input_spell_check_all (chat);
 		}
 
 		return;
@@ -2929,6 +3023,8 @@ conf_spell_checking_cb (GSettings *gsettings_chat,
 		gtk_text_buffer_create_tag (buffer, "misspelled",
 					    "underline", PANGO_UNDERLINE_ERROR,
 					    NULL);
+		gtk_text_buffer_create_tag (buffer, "spell-check-pending",
+					    NULL);
 
 		gtk_text_buffer_get_iter_at_mark (buffer, &iter,
 	                                          gtk_text_buffer_get_insert (buffer));
@@ -2936,9 +3032,8 @@ conf_spell_checking_cb (GSettings *gsettings_chat,
 					     &iter, TRUE);
 
 		/* Mark misspelled words in the existing buffer.
-		 * Need to do so in idle so the spell checker is updated. */
-		priv->update_misspelled_words_id =
-			g_idle_add (update_misspelled_words, chat);
+		 * They're checked in idle so the spell checker is updated. */
+		chat_input_spell_check_all (chat);
 	} else {
 		GtkTextTagTable *table;
 		GtkTextTag *tag;
@@ -2950,9 +3045,16 @@ conf_spell_checking_cb (GSettings *gsettings_chat,
 		g_signal_handler_disconnect (buffer, priv->delete_range_id);
 		priv->delete_range_id = 0;
 
+		if (priv->update_misspelled_words_id != 0) {
+			g_source_remove (priv->update_misspelled_words_id);
+			priv->update_misspelled_words_id = 0;
+		}
+
 		table = gtk_text_buffer_get_tag_table (buffer);
 		tag = gtk_text_tag_table_lookup (table, "misspelled");
 		gtk_text_tag_table_remove (table, tag);
+		tag = gtk_text_tag_table_lookup (table, "spell-check-pending");
+		gtk_text_tag_table_remove (table, tag);
 
 		gtk_text_buffer_delete_mark_by_name (buffer,
 						     "previous-cursor-position");
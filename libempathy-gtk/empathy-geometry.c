@@ -28,6 +28,7 @@
 #include <glib.h>
 #include <gdk/gdk.h>
 
+#include "libempathy/empathy-file-store.h"
 #include "libempathy/empathy-utils.h"
 #include "empathy-geometry.h"
 #include "empathy-ui-utils.h"
@@ -36,7 +37,6 @@
 #include <libempathy/empathy-debug.h>
 
 #define GEOMETRY_DIR_CREATE_MODE  (S_IRUSR | S_IWUSR | S_IXUSR)
-#define GEOMETRY_FILE_CREATE_MODE (S_IRUSR | S_IWUSR)
 
 /* geometry.ini file contains 2 groups:
  *  - one with position and size of each window
@@ -50,53 +50,35 @@
 /* Key used to keep window's name inside the object's qdata */
 #define GEOMETRY_NAME_KEY             "geometry-name-key"
 
-static guint store_id = 0;
-
-static void
-geometry_real_store (GKeyFile *key_file)
+static gchar *
+geometry_serialize (gsize *length,
+    gpointer key_file)
 {
-  gchar *filename;
   gchar *content;
-  gsize length;
   GError *error = NULL;
 
-  content = g_key_file_to_data (key_file, &length, &error);
+  content = g_key_file_to_data (key_file, length, &error);
   if (error != NULL)
     {
       DEBUG ("Error: %s", error->message);
       g_error_free (error);
-      return;
-    }
-
-  filename = g_build_filename (g_get_user_config_dir (),
-    PACKAGE_NAME, GEOMETRY_FILENAME, NULL);
-
-  if (!g_file_set_contents (filename, content, length, &error))
-    {
-      DEBUG ("Error: %s", error->message);
-      g_error_free (error);
+      return NULL;
     }
 
-  g_free (content);
-  g_free (filename);
-}
-
-static gboolean
-geometry_store_cb (gpointer key_file)
-{
-  geometry_real_store (key_file);
-  store_id = 0;
-
-  return FALSE;
+  return content;
 }
 
 static void
 geometry_schedule_store (GKeyFile *key_file)
 {
-  if (store_id != 0)
-    g_source_remove (store_id);
+  static gchar *filename = NULL;
+
+  if (filename == NULL)
+    filename = g_build_filename (g_get_user_config_dir (),
+      PACKAGE_NAME, GEOMETRY_FILENAME, NULL);
 
-  store_id = g_timeout_add_seconds (1, geometry_store_cb, key_file);
+  /* Windows being moved around are only saved once they've settled */
+  empathy_file_store_schedule (filename, 1, geometry_serialize, key_file);
 }
 
 static GKeyFile *
@@ -38,8 +38,10 @@
 
 #include <libempathy/empathy-utils.h>
 #include <libempathy/empathy-enum-types.h>
+#include <libempathy/empathy-timer-wheel.h>
 
 #include "empathy-individual-store.h"
+#include "empathy-live-search.h"
 #include "empathy-ui-utils.h"
 #include "empathy-gtk-enum-types.h"
 
@@ -56,6 +58,14 @@
 /* Time in seconds after connecting which we wait before active users are enabled */
 #define ACTIVE_USER_WAIT_TO_ENABLE_TIME 5
 
+/* Time in milliseconds individual updates are collected before being applied
+ * to the rows, about one frame */
+#define UPDATE_FLUSH_INTERVAL 16
+
+/* Above that many updates at once, sorting the whole store once is cheaper
+ * than moving each updated row */
+#define UPDATE_RESORT_THRESHOLD 32
+
 struct _EmpathyIndividualStorePriv
 {
   gboolean show_avatars;
@@ -72,17 +82,52 @@ struct _EmpathyIndividualStorePriv
   GHashTable                  *folks_individual_cache;
   /* Hash: char *groupname -> GtkTreeIter * */
   GHashTable                  *empathy_group_cache;
+  /* Hash: FolksIndividual* -> SearchKeys, built when first searched */
+  GHashTable                  *search_keys;
+  /* Hash: FolksIndividual* -> SortKey, built when first sorted */
+  GHashTable                  *sort_keys;
+  /* Hash: EmpathyContact* -> FolksIndividual* they are a persona of */
+  GHashTable                  *contact_individuals;
+  /* Set of owned FolksIndividual* waiting for their rows to be updated */
+  GHashTable                  *pending_updates;
+  guint pending_updates_id;
   gboolean show_active;
+  /* Owned ShowActiveData of the individuals currently shown as active */
+  EmpathyTimerWheel *active_wheel;
 };
 
 typedef struct
 {
-  EmpathyIndividualStore *self;
-  FolksIndividual *individual;
+  FolksIndividual *individual; /* weak */
   gboolean remove;
-  guint timeout;
 } ShowActiveData;
 
+/* What the live search matches an individual against, stripped by
+ * empathy_live_search_strip_utf8_string() */
+typedef struct
+{
+  GPtrArray *alias_words;
+  /* Display IDs of the interesting personas */
+  GPtrArray *ids;
+  /* Stripped ids without their @server part, in the same order */
+  GPtrArray *id_words;
+} SearchKeys;
+
+/* What contacts are sorted by, so comparing them doesn't need collating
+ * strings or looking up their EmpathyContact */
+typedef struct
+{
+  /* Higher is more available */
+  gint presence_rank;
+  /* g_utf8_collate_key() of the alias and of the individual ID */
+  gchar *alias_key;
+  gchar *id_key;
+  /* From the EmpathyContact's account, if the individual has one */
+  gboolean has_contact;
+  gchar *protocol;
+  gchar *account_path;
+} SortKey;
+
 enum
 {
   PROP_0,
@@ -324,6 +369,9 @@ empathy_individual_store_remove_individual (EmpathyIndividualStore *self,
     }
 
   g_hash_table_remove (self->priv->folks_individual_cache, individual);
+  g_hash_table_remove (self->priv->search_keys, individual);
+  g_hash_table_remove (self->priv->sort_keys, individual);
+  g_hash_table_remove (self->priv->pending_updates, individual);
 }
 
 void
@@ -454,29 +502,17 @@ individual_store_contact_set_active (EmpathyIndividualStore *self,
   free_iters (iters);
 }
 
-static void individual_store_contact_active_free (ShowActiveData *data);
-
 static void
 individual_store_contact_active_invalidated (ShowActiveData *data,
     GObject *old_object)
 {
-  /* Remove the timeout and free the struct, since the individual or individual
-   * store has disappeared. */
-  g_source_remove (data->timeout);
-
-  if (old_object == (GObject *) data->self)
-    data->self = NULL;
-  else if (old_object == (GObject *) data->individual)
-    data->individual = NULL;
-  else
-    g_assert_not_reached ();
-
-  individual_store_contact_active_free (data);
+  /* The individual has disappeared, there is nothing left to do when the
+   * data expires. */
+  data->individual = NULL;
 }
 
 static ShowActiveData *
-individual_store_contact_active_new (EmpathyIndividualStore *self,
-    FolksIndividual *individual,
+individual_store_contact_active_new (FolksIndividual *individual,
     gboolean remove_)
 {
   ShowActiveData *data;
@@ -487,18 +523,14 @@ individual_store_contact_active_new (EmpathyIndividualStore *self,
 
   data = g_slice_new0 (ShowActiveData);
 
-  /* We don't actually want to force either the IndividualStore or the
-   * Individual to stay alive, since the user could quit Empathy or disable
-   * the account before the contact_active timeout is fired. */
-  g_object_weak_ref (G_OBJECT (self),
-      (GWeakNotify) individual_store_contact_active_invalidated, data);
+  /* We don't actually want to force the Individual to stay alive, since the
+   * user could disable the account before the contact_active timeout is
+   * fired. The data doesn't outlive the store, which owns the wheel. */
   g_object_weak_ref (G_OBJECT (individual),
       (GWeakNotify) individual_store_contact_active_invalidated, data);
 
-  data->self = self;
   data->individual = individual;
   data->remove = remove_;
-  data->timeout = 0;
 
   return data;
 }
@@ -506,12 +538,6 @@ individual_store_contact_active_new (EmpathyIndividualStore *self,
 static void
 individual_store_contact_active_free (ShowActiveData *data)
 {
-  if (data->self != NULL)
-    {
-      g_object_weak_unref (G_OBJECT (data->self),
-          (GWeakNotify) individual_store_contact_active_invalidated, data);
-    }
-
   if (data->individual != NULL)
     {
       g_object_weak_unref (G_OBJECT (data->individual),
@@ -521,26 +547,35 @@ individual_store_contact_active_free (ShowActiveData *data)
   g_slice_free (ShowActiveData, data);
 }
 
-static gboolean
-individual_store_contact_active_cb (ShowActiveData *data)
+static void
+individual_store_contact_active_cb (GPtrArray *expired,
+    gpointer user_data)
 {
-  if (data->remove)
+  EmpathyIndividualStore *self = user_data;
+  guint i;
+
+  for (i = 0; i < expired->len; i++)
     {
-      DEBUG ("Individual'%s' active timeout, removing item",
-          folks_alias_details_get_alias (
-            FOLKS_ALIAS_DETAILS (data->individual)));
-      empathy_individual_store_remove_individual (data->self, data->individual);
-    }
+      ShowActiveData *data = g_ptr_array_index (expired, i);
 
-  DEBUG ("Individual'%s' no longer active",
-      folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (data->individual)));
+      if (data->individual == NULL)
+        continue;
 
-  individual_store_contact_set_active (data->self,
-      data->individual, FALSE, TRUE);
+      if (data->remove)
+        {
+          DEBUG ("Individual'%s' active timeout, removing item",
+              folks_alias_details_get_alias (
+                FOLKS_ALIAS_DETAILS (data->individual)));
+          empathy_individual_store_remove_individual (self, data->individual);
+        }
 
-  individual_store_contact_active_free (data);
+      DEBUG ("Individual'%s' no longer active",
+          folks_alias_details_get_alias (
+            FOLKS_ALIAS_DETAILS (data->individual)));
 
-  return FALSE;
+      individual_store_contact_set_active (self,
+          data->individual, FALSE, TRUE);
+    }
 }
 
 typedef struct {
@@ -599,7 +634,6 @@ static void
 individual_store_contact_update (EmpathyIndividualStore *self,
     FolksIndividual *individual)
 {
-  ShowActiveData *data;
   GtkTreeModel *model;
   GList *iters, *l;
   gboolean in_list;
@@ -615,6 +649,9 @@ individual_store_contact_update (EmpathyIndividualStore *self,
 
   model = GTK_TREE_MODEL (self);
 
+  /* Presence or alias may have changed, the rows will be sorted again */
+  g_hash_table_remove (self->priv->sort_keys, individual);
+
   iters = individual_store_find_contact (self, individual);
   if (!iters)
     {
@@ -740,11 +777,8 @@ individual_store_contact_update (EmpathyIndividualStore *self,
 
       if (do_set_active)
         {
-          data =
-              individual_store_contact_active_new (self, individual,
-              do_remove);
-          data->timeout = g_timeout_add_seconds (ACTIVE_USER_SHOW_TIME,
-              (GSourceFunc) individual_store_contact_active_cb, data);
+          empathy_timer_wheel_add (self->priv->active_wheel,
+              individual_store_contact_active_new (individual, do_remove));
         }
     }
 
@@ -756,6 +790,64 @@ individual_store_contact_update (EmpathyIndividualStore *self,
   free_iters (iters);
 }
 
+static gboolean
+individual_store_flush_updates_cb (gpointer user_data)
+{
+  EmpathyIndividualStore *self = user_data;
+  GHashTable *pending;
+  GHashTableIter iter;
+  gpointer individual;
+  gint sort_column_id;
+  GtkSortType order;
+  gboolean resort = FALSE;
+
+  self->priv->pending_updates_id = 0;
+
+  /* Updating rows can queue more updates */
+  pending = self->priv->pending_updates;
+  self->priv->pending_updates = g_hash_table_new_full (NULL, NULL,
+      g_object_unref, NULL);
+
+  DEBUG ("Updating %u individuals", g_hash_table_size (pending));
+
+  /* Don't move each row, sort everything once at the end */
+  if (g_hash_table_size (pending) > UPDATE_RESORT_THRESHOLD &&
+      gtk_tree_sortable_get_sort_column_id (GTK_TREE_SORTABLE (self),
+          &sort_column_id, &order))
+    {
+      resort = TRUE;
+      gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (self),
+          GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, order);
+    }
+
+  g_hash_table_iter_init (&iter, pending);
+  while (g_hash_table_iter_next (&iter, &individual, NULL))
+    individual_store_contact_update (self, individual);
+
+  if (resort)
+    gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (self),
+        sort_column_id, order);
+
+  g_hash_table_unref (pending);
+
+  return FALSE;
+}
+
+/* Rows of @individual will be updated with the next batch of updates */
+static void
+individual_store_queue_update (EmpathyIndividualStore *self,
+    FolksIndividual *individual)
+{
+  if (!g_hash_table_lookup_extended (self->priv->pending_updates, individual,
+          NULL, NULL))
+    g_hash_table_insert (self->priv->pending_updates,
+        g_object_ref (individual), NULL);
+
+  if (self->priv->pending_updates_id == 0)
+    self->priv->pending_updates_id = g_timeout_add (UPDATE_FLUSH_INTERVAL,
+        individual_store_flush_updates_cb, self);
+}
+
 static void
 individual_store_individual_updated_cb (FolksIndividual *individual,
     GParamSpec *param,
@@ -764,7 +856,17 @@ individual_store_individual_updated_cb (FolksIndividual *individual,
   DEBUG ("Individual'%s' updated, checking roster is in sync...",
       folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (individual)));
 
-  individual_store_contact_update (self, individual);
+  individual_store_queue_update (self, individual);
+}
+
+static void
+individual_store_alias_changed_cb (FolksIndividual *individual,
+    GParamSpec *param,
+    EmpathyIndividualStore *self)
+{
+  g_hash_table_remove (self->priv->search_keys, individual);
+
+  individual_store_individual_updated_cb (individual, param, self);
 }
 
 static void
@@ -781,7 +883,7 @@ individual_store_contact_updated_cb (EmpathyContact *contact,
   if (individual == NULL)
     return;
 
-  individual_store_contact_update (self, individual);
+  individual_store_queue_update (self, individual);
 }
 
 static void
@@ -795,6 +897,9 @@ individual_personas_changed_cb (FolksIndividual *individual,
   DEBUG ("Individual '%s' personas-changed.",
       folks_individual_get_id (individual));
 
+  g_hash_table_remove (self->priv->search_keys, individual);
+  g_hash_table_remove (self->priv->sort_keys, individual);
+
   iter = gee_iterable_iterator (GEE_ITERABLE (removed));
   /* FIXME: libfolks hasn't grown capabilities support yet, so we have to go
    * through the EmpathyContacts for them. */
@@ -813,6 +918,9 @@ individual_personas_changed_cb (FolksIndividual *individual,
               empathy_contact_set_persona (contact, FOLKS_PERSONA (persona));
 
               g_object_set_data (G_OBJECT (contact), "individual", NULL);
+              if (g_hash_table_lookup (self->priv->contact_individuals,
+                      contact) == individual)
+                g_hash_table_remove (self->priv->contact_individuals, contact);
               g_signal_handlers_disconnect_by_func (contact,
                   (GCallback) individual_store_contact_updated_cb, self);
 
@@ -840,6 +948,8 @@ individual_personas_changed_cb (FolksIndividual *individual,
               empathy_contact_set_persona (contact, FOLKS_PERSONA (persona));
 
               g_object_set_data (G_OBJECT (contact), "individual", individual);
+              g_hash_table_insert (self->priv->contact_individuals, contact,
+                  individual);
               g_signal_connect (contact, "notify::capabilities",
                   (GCallback) individual_store_contact_updated_cb, self);
               g_signal_connect (contact, "notify::client-types",
@@ -883,7 +993,7 @@ individual_store_add_individual_and_connect (EmpathyIndividualStore *self,
   g_signal_connect (individual, "notify::presence-message",
       (GCallback) individual_store_individual_updated_cb, self);
   g_signal_connect (individual, "notify::alias",
-      (GCallback) individual_store_individual_updated_cb, self);
+      (GCallback) individual_store_alias_changed_cb, self);
   g_signal_connect (individual, "personas-changed",
       (GCallback) individual_personas_changed_cb, self);
   g_signal_connect (individual, "notify::is-favourite",
@@ -908,10 +1018,14 @@ empathy_individual_store_disconnect_individual (EmpathyIndividualStore *self,
 
   g_signal_handlers_disconnect_by_func (individual,
       (GCallback) individual_store_individual_updated_cb, self);
+  g_signal_handlers_disconnect_by_func (individual,
+      (GCallback) individual_store_alias_changed_cb, self);
   g_signal_handlers_disconnect_by_func (individual,
       (GCallback) individual_personas_changed_cb, self);
   g_signal_handlers_disconnect_by_func (individual,
       (GCallback) individual_store_favourites_changed_cb, self);
+
+  g_hash_table_remove (self->priv->pending_updates, individual);
 }
 
 void
@@ -946,9 +1060,22 @@ individual_store_dispose (GObject *object)
       g_source_remove (self->priv->inhibit_active);
     }
 
+  if (self->priv->pending_updates_id != 0)
+    {
+      g_source_remove (self->priv->pending_updates_id);
+      self->priv->pending_updates_id = 0;
+    }
+
+  empathy_timer_wheel_free (self->priv->active_wheel);
+  self->priv->active_wheel = NULL;
+
   g_hash_table_unref (self->priv->status_icons);
   g_hash_table_unref (self->priv->folks_individual_cache);
   g_hash_table_unref (self->priv->empathy_group_cache);
+  g_hash_table_unref (self->priv->search_keys);
+  g_hash_table_unref (self->priv->sort_keys);
+  g_hash_table_unref (self->priv->pending_updates);
+  g_hash_table_unref (self->priv->contact_individuals);
   G_OBJECT_CLASS (empathy_individual_store_parent_class)->dispose (object);
 }
 
@@ -1161,117 +1288,173 @@ compare_separator_and_groups (gboolean is_separator_a,
   return 0;
 }
 
+/* Turns tp_connection_presence_type_cmp_availability() into a rank, so
+ * sort keys can be compared without it */
 static gint
-individual_store_contact_sort (FolksIndividual *individual_a,
-    FolksIndividual *individual_b)
+presence_type_get_rank (TpConnectionPresenceType type)
 {
-  gint ret_val;
-  EmpathyContact *contact_a = NULL, *contact_b = NULL;
-  TpAccount *account_a, *account_b;
+  static gint ranks[TP_NUM_CONNECTION_PRESENCE_TYPES];
+  static gboolean initialized = FALSE;
 
-  g_return_val_if_fail (individual_a != NULL || individual_b != NULL, 0);
+  if (G_UNLIKELY (!initialized))
+    {
+      guint i, j;
 
-  /* alias */
-  ret_val = g_utf8_collate (
-      folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (individual_a)),
-      folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (individual_b)));
+      for (i = 0; i < TP_NUM_CONNECTION_PRESENCE_TYPES; i++)
+        {
+          ranks[i] = 0;
+          for (j = 0; j < TP_NUM_CONNECTION_PRESENCE_TYPES; j++)
+            if (tp_connection_presence_type_cmp_availability (i, j) > 0)
+              ranks[i]++;
+        }
 
-  if (ret_val != 0)
-    goto out;
+      initialized = TRUE;
+    }
+
+  if (type >= TP_NUM_CONNECTION_PRESENCE_TYPES)
+    type = TP_CONNECTION_PRESENCE_TYPE_UNSET;
+
+  return ranks[type];
+}
 
-  contact_a = empathy_contact_dup_from_folks_individual (individual_a);
-  contact_b = empathy_contact_dup_from_folks_individual (individual_b);
-  if (contact_a != NULL && contact_b != NULL)
+static SortKey *
+individual_store_get_sort_key (EmpathyIndividualStore *self,
+    FolksIndividual *individual)
+{
+  SortKey *key;
+  EmpathyContact *contact;
+
+  key = g_hash_table_lookup (self->priv->sort_keys, individual);
+  if (key != NULL)
+    return key;
+
+  key = g_slice_new0 (SortKey);
+  key->presence_rank = presence_type_get_rank (
+      empathy_folks_presence_type_to_tp (
+          folks_presence_details_get_presence_type (
+              FOLKS_PRESENCE_DETAILS (individual))));
+  key->alias_key = g_utf8_collate_key (
+      folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (individual)), -1);
+  key->id_key = g_utf8_collate_key (folks_individual_get_id (individual), -1);
+
+  contact = empathy_contact_dup_from_folks_individual (individual);
+  if (contact != NULL)
     {
-      account_a = empathy_contact_get_account (contact_a);
-      account_b = empathy_contact_get_account (contact_b);
+      TpAccount *account = empathy_contact_get_account (contact);
 
-      g_assert (account_a != NULL);
-      g_assert (account_b != NULL);
+      g_assert (account != NULL);
 
-      /* protocol */
-      ret_val = g_strcmp0 (tp_account_get_protocol (account_a),
-          tp_account_get_protocol (account_b));
+      key->has_contact = TRUE;
+      key->protocol = g_strdup (tp_account_get_protocol (account));
+      key->account_path = g_strdup (tp_proxy_get_object_path (account));
 
+      g_object_unref (contact);
+    }
+
+  /* Dropped when the individual is updated or removed from the store */
+  g_hash_table_insert (self->priv->sort_keys, individual, key);
+
+  return key;
+}
+
+static gint
+individual_store_contact_sort (SortKey *key_a,
+    SortKey *key_b)
+{
+  gint ret_val;
+
+  /* alias */
+  ret_val = strcmp (key_a->alias_key, key_b->alias_key);
+  if (ret_val != 0)
+    return ret_val;
+
+  if (key_a->has_contact && key_b->has_contact)
+    {
+      /* protocol */
+      ret_val = g_strcmp0 (key_a->protocol, key_b->protocol);
       if (ret_val != 0)
-        goto out;
+        return ret_val;
 
       /* account ID */
-      ret_val = g_strcmp0 (tp_proxy_get_object_path (account_a),
-          tp_proxy_get_object_path (account_b));
-
+      ret_val = g_strcmp0 (key_a->account_path, key_b->account_path);
       if (ret_val != 0)
-        goto out;
+        return ret_val;
     }
 
   /* identifier */
-  ret_val = g_utf8_collate (folks_individual_get_id (individual_a),
-      folks_individual_get_id (individual_b));
-
-out:
-  tp_clear_object (&contact_a);
-  tp_clear_object (&contact_b);
-
-  return ret_val;
+  return strcmp (key_a->id_key, key_b->id_key);
 }
 
+/* Compares rows which are not both contacts */
 static gint
-individual_store_state_sort_func (GtkTreeModel *model,
+individual_store_sort_groups (GtkTreeModel *model,
     GtkTreeIter *iter_a,
     GtkTreeIter *iter_b,
-    gpointer user_data)
+    FolksIndividual *individual_a,
+    FolksIndividual *individual_b)
 {
-  gint ret_val;
-  FolksIndividual *individual_a, *individual_b;
   gchar *name_a, *name_b;
   gboolean is_separator_a, is_separator_b;
   gboolean fake_group_a, fake_group_b;
-  FolksPresenceType folks_presence_type_a, folks_presence_type_b;
-  TpConnectionPresenceType tp_presence_a, tp_presence_b;
+  gint ret_val;
 
   gtk_tree_model_get (model, iter_a,
       EMPATHY_INDIVIDUAL_STORE_COL_NAME, &name_a,
-      EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual_a,
       EMPATHY_INDIVIDUAL_STORE_COL_IS_SEPARATOR, &is_separator_a,
       EMPATHY_INDIVIDUAL_STORE_COL_IS_FAKE_GROUP, &fake_group_a, -1);
   gtk_tree_model_get (model, iter_b,
       EMPATHY_INDIVIDUAL_STORE_COL_NAME, &name_b,
-      EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual_b,
       EMPATHY_INDIVIDUAL_STORE_COL_IS_SEPARATOR, &is_separator_b,
       EMPATHY_INDIVIDUAL_STORE_COL_IS_FAKE_GROUP, &fake_group_b, -1);
 
+  ret_val = compare_separator_and_groups (is_separator_a, is_separator_b,
+      name_a, name_b, individual_a, individual_b, fake_group_a,
+      fake_group_b);
+
+  g_free (name_a);
+  g_free (name_b);
+
+  return ret_val;
+}
+
+static gint
+individual_store_state_sort_func (GtkTreeModel *model,
+    GtkTreeIter *iter_a,
+    GtkTreeIter *iter_b,
+    gpointer user_data)
+{
+  EmpathyIndividualStore *self = user_data;
+  gint ret_val;
+  FolksIndividual *individual_a, *individual_b;
+  SortKey *key_a, *key_b;
+
+  gtk_tree_model_get (model, iter_a,
+      EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual_a, -1);
+  gtk_tree_model_get (model, iter_b,
+      EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual_b, -1);
+
   if (individual_a == NULL || individual_b == NULL)
     {
-      ret_val = compare_separator_and_groups (is_separator_a, is_separator_b,
-          name_a, name_b, individual_a, individual_b, fake_group_a,
-          fake_group_b);
+      ret_val = individual_store_sort_groups (model, iter_a, iter_b,
+          individual_a, individual_b);
       goto free_and_out;
     }
 
   /* If we managed to get this far, we can start looking at
    * the presences.
    */
-  folks_presence_type_a =
-      folks_presence_details_get_presence_type (
-          FOLKS_PRESENCE_DETAILS (individual_a));
-  folks_presence_type_b =
-      folks_presence_details_get_presence_type (
-          FOLKS_PRESENCE_DETAILS (individual_b));
-  tp_presence_a = empathy_folks_presence_type_to_tp (folks_presence_type_a);
-  tp_presence_b = empathy_folks_presence_type_to_tp (folks_presence_type_b);
-
-  ret_val = -tp_connection_presence_type_cmp_availability (tp_presence_a,
-      tp_presence_b);
+  key_a = individual_store_get_sort_key (self, individual_a);
+  key_b = individual_store_get_sort_key (self, individual_b);
+
+  ret_val = key_b->presence_rank - key_a->presence_rank;
 
   if (ret_val == 0)
     {
       /* Fallback: compare by name et al. */
-      ret_val = individual_store_contact_sort (individual_a, individual_b);
+      ret_val = individual_store_contact_sort (key_a, key_b);
     }
 
 free_and_out:
-  g_free (name_a);
-  g_free (name_b);
   tp_clear_object (&individual_a);
   tp_clear_object (&individual_b);
 
@@ -1284,33 +1467,25 @@ individual_store_name_sort_func (GtkTreeModel *model,
     GtkTreeIter *iter_b,
     gpointer user_data)
 {
-  gchar *name_a, *name_b;
+  EmpathyIndividualStore *self = user_data;
   FolksIndividual *individual_a, *individual_b;
-  gboolean is_separator_a = FALSE, is_separator_b = FALSE;
   gint ret_val;
-  gboolean fake_group_a, fake_group_b;
 
   gtk_tree_model_get (model, iter_a,
-      EMPATHY_INDIVIDUAL_STORE_COL_NAME, &name_a,
-      EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual_a,
-      EMPATHY_INDIVIDUAL_STORE_COL_IS_SEPARATOR, &is_separator_a,
-      EMPATHY_INDIVIDUAL_STORE_COL_IS_FAKE_GROUP, &fake_group_a, -1);
+      EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual_a, -1);
   gtk_tree_model_get (model, iter_b,
-      EMPATHY_INDIVIDUAL_STORE_COL_NAME, &name_b,
-      EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual_b,
-      EMPATHY_INDIVIDUAL_STORE_COL_IS_SEPARATOR, &is_separator_b,
-      EMPATHY_INDIVIDUAL_STORE_COL_IS_FAKE_GROUP, &fake_group_b, -1);
+      EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual_b, -1);
 
   if (individual_a == NULL || individual_b == NULL)
-    ret_val = compare_separator_and_groups (is_separator_a, is_separator_b,
-        name_a, name_b, individual_a, individual_b, fake_group_a, fake_group_b);
+    ret_val = individual_store_sort_groups (model, iter_a, iter_b,
+        individual_a, individual_b);
   else
-    ret_val = individual_store_contact_sort (individual_a, individual_b);
+    ret_val = individual_store_contact_sort (
+        individual_store_get_sort_key (self, individual_a),
+        individual_store_get_sort_key (self, individual_b));
 
   tp_clear_object (&individual_a);
   tp_clear_object (&individual_b);
-  g_free (name_a);
-  g_free (name_b);
 
   return ret_val;
 }
@@ -1372,6 +1547,26 @@ g_queue_free_full_iter (gpointer data)
   g_queue_free (queue);
 }
 
+static void
+search_keys_free (SearchKeys *keys)
+{
+  if (keys->alias_words != NULL)
+    g_ptr_array_unref (keys->alias_words);
+  g_ptr_array_unref (keys->ids);
+  g_ptr_array_unref (keys->id_words);
+  g_slice_free (SearchKeys, keys);
+}
+
+static void
+sort_key_free (SortKey *key)
+{
+  g_free (key->alias_key);
+  g_free (key->id_key);
+  g_free (key->protocol);
+  g_free (key->account_path);
+  g_slice_free (SortKey, key);
+}
+
 static void
 empathy_individual_store_init (EmpathyIndividualStore *self)
 {
@@ -1390,6 +1585,16 @@ empathy_individual_store_init (EmpathyIndividualStore *self)
       g_queue_free_full_iter);
   self->priv->empathy_group_cache = g_hash_table_new_full (g_str_hash,
       g_str_equal, g_free, (GDestroyNotify) gtk_tree_iter_free);
+  self->priv->search_keys = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) search_keys_free);
+  self->priv->sort_keys = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) sort_key_free);
+  self->priv->pending_updates = g_hash_table_new_full (NULL, NULL,
+      g_object_unref, NULL);
+  self->priv->contact_individuals = g_hash_table_new (NULL, NULL);
+  self->priv->active_wheel = empathy_timer_wheel_new (ACTIVE_USER_SHOW_TIME,
+      individual_store_contact_active_cb, self,
+      (GDestroyNotify) individual_store_contact_active_free);
   individual_store_setup (self);
 }
 
@@ -1521,6 +1726,8 @@ empathy_individual_store_set_show_groups (EmpathyIndividualStore *self,
       /* Also clear the cache */
       g_hash_table_remove_all (self->priv->folks_individual_cache);
       g_hash_table_remove_all (self->priv->empathy_group_cache);
+      g_hash_table_remove_all (self->priv->search_keys);
+      g_hash_table_remove_all (self->priv->sort_keys);
 
       klass->reload_individuals (self);
     }
@@ -1773,3 +1980,131 @@ empathy_individual_store_refresh_individual (EmpathyIndividualStore *self,
   empathy_individual_store_add_individual (self, individual);
   self->priv->show_active = show_active;
 }
+
+static SearchKeys *
+search_keys_new (FolksIndividual *individual)
+{
+  SearchKeys *keys;
+  GeeSet *personas;
+  GeeIterator *iter;
+
+  keys = g_slice_new0 (SearchKeys);
+  keys->alias_words = empathy_live_search_strip_utf8_string (
+      folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (individual)));
+  keys->ids = g_ptr_array_new_with_free_func (g_free);
+  keys->id_words = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) g_ptr_array_unref);
+
+  personas = folks_individual_get_personas (individual);
+  iter = gee_iterable_iterator (GEE_ITERABLE (personas));
+  while (gee_iterator_next (iter))
+    {
+      FolksPersona *persona = gee_iterator_get (iter);
+
+      if (empathy_folks_persona_is_interesting (persona))
+        {
+          const gchar *id = folks_persona_get_display_id (persona);
+          const gchar *at;
+          GPtrArray *words;
+          gchar *user;
+
+          /* remove the @server.com part */
+          at = strchr (id, '@');
+          user = at != NULL ? g_strndup (id, at - id) : g_strdup (id);
+          words = empathy_live_search_strip_utf8_string (user);
+          g_free (user);
+
+          if (words == NULL)
+            words = g_ptr_array_new ();
+
+          g_ptr_array_add (keys->ids, g_strdup (id));
+          g_ptr_array_add (keys->id_words, words);
+        }
+      g_clear_object (&persona);
+    }
+  g_clear_object (&iter);
+
+  return keys;
+}
+
+/* @words = empathy_live_search_strip_utf8_string (@text);
+ *
+ * Same as empathy_individual_match_string(), but the stripped alias and IDs
+ * of individuals in @self are kept until they change. */
+gboolean
+empathy_individual_store_match_individual (EmpathyIndividualStore *self,
+    FolksIndividual *individual,
+    const gchar *text,
+    GPtrArray *words)
+{
+  SearchKeys *keys;
+  gboolean cached = TRUE;
+  gboolean retval = FALSE;
+  guint i;
+
+  g_return_val_if_fail (EMPATHY_IS_INDIVIDUAL_STORE (self), FALSE);
+  g_return_val_if_fail (FOLKS_IS_INDIVIDUAL (individual), FALSE);
+
+  keys = g_hash_table_lookup (self->priv->search_keys, individual);
+  if (keys == NULL)
+    {
+      keys = search_keys_new (individual);
+
+      /* Only cache keys of individuals in the store, they are dropped
+       * when the individual is removed */
+      cached = g_hash_table_lookup (self->priv->folks_individual_cache,
+          individual) != NULL;
+      if (cached)
+        g_hash_table_insert (self->priv->search_keys, individual, keys);
+    }
+
+  /* check alias name */
+  if (empathy_live_search_match_stripped_words (keys->alias_words, words))
+    {
+      retval = TRUE;
+      goto out;
+    }
+
+  /* check contact ids. Accept the persona if @text is a full prefix of its
+   * ID; that allows user to find, say, a jabber contact by typing their
+   * JID. */
+  for (i = 0; i < keys->ids->len; i++)
+    {
+      if (g_str_has_prefix (g_ptr_array_index (keys->ids, i), text) ||
+          empathy_live_search_match_stripped_words (
+              g_ptr_array_index (keys->id_words, i), words))
+        {
+          retval = TRUE;
+          break;
+        }
+    }
+
+out:
+  if (!cached)
+    search_keys_free (keys);
+
+  return retval;
+}
+
+/* Returns the rows of @individual, as a list of GtkTreeIter to free with
+ * g_list_free_full (iters, (GDestroyNotify) gtk_tree_iter_free) */
+GList *
+empathy_individual_store_find_individual (EmpathyIndividualStore *self,
+    FolksIndividual *individual)
+{
+  g_return_val_if_fail (EMPATHY_IS_INDIVIDUAL_STORE (self), NULL);
+  g_return_val_if_fail (FOLKS_IS_INDIVIDUAL (individual), NULL);
+
+  return individual_store_find_contact (self, individual);
+}
+
+/* Returns the individual of the store having @contact as persona, or NULL */
+FolksIndividual *
+empathy_individual_store_lookup_contact (EmpathyIndividualStore *self,
+    EmpathyContact *contact)
+{
+  g_return_val_if_fail (EMPATHY_IS_INDIVIDUAL_STORE (self), NULL);
+  g_return_val_if_fail (EMPATHY_IS_CONTACT (contact), NULL);
+
+  return g_hash_table_lookup (self->priv->contact_individuals, contact);
+}
@@ -29,6 +29,10 @@
 
 #include <gtk/gtk.h>
 
+#include <folks/folks.h>
+
+#include <libempathy/empathy-contact.h>
+
 G_BEGIN_DECLS
 #define EMPATHY_TYPE_INDIVIDUAL_STORE         (empathy_individual_store_get_type ())
 #define EMPATHY_INDIVIDUAL_STORE(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), EMPATHY_TYPE_INDIVIDUAL_STORE, EmpathyIndividualStore))
@@ -135,6 +139,20 @@ GdkPixbuf *empathy_individual_store_get_individual_status_icon (
     EmpathyIndividualStore *store,
     FolksIndividual *individual);
 
+GList *empathy_individual_store_find_individual (
+    EmpathyIndividualStore *self,
+    FolksIndividual *individual);
+
+FolksIndividual *empathy_individual_store_lookup_contact (
+    EmpathyIndividualStore *self,
+    EmpathyContact *contact);
+
+gboolean empathy_individual_store_match_individual (
+    EmpathyIndividualStore *self,
+    FolksIndividual *individual,
+    const gchar *text,
+    GPtrArray *words);
+
 void individual_store_add_individual_and_connect (EmpathyIndividualStore *self,
     FolksIndividual *individual);
 
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_INDIVIDUAL_VIEW_PRIVATE_H__
+#define __EMPATHY_INDIVIDUAL_VIEW_PRIVATE_H__
+
+#include <libempathy-gtk/empathy-individual-view.h>
+
+G_BEGIN_DECLS
+
+/* Whether @individual matches the search; used by the tests to count how
+ * many individuals are matched */
+typedef gboolean (*EmpathyIndividualViewMatchFunc) (
+    FolksIndividual *individual,
+    const gchar *text,
+    GPtrArray *words,
+    gpointer user_data);
+
+void empathy_individual_view_set_match_func (EmpathyIndividualView *self,
+    EmpathyIndividualViewMatchFunc func,
+    gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_INDIVIDUAL_VIEW_PRIVATE_H__ */
@@ -44,6 +44,7 @@
 #include <libempathy/empathy-utils.h>
 
 #include "empathy-individual-view.h"
+#include "empathy-individual-view-private.h"
 #include "empathy-individual-menu.h"
 #include "empathy-individual-store.h"
 #include "empathy-individual-edit-dialog.h"
@@ -78,6 +79,19 @@ typedef struct
 
   GtkTreeModelFilter *filter;
   GtkWidget *search_widget;
+  /* Search text the filter is up to date with, NULL when not searching */
+  gchar *filtered_search_text;
+  /* Individuals not matching the search text they were last checked with,
+   * which is filtered_search_text or a prefix of it:
+   * owned FolksIndividual -> NULL */
+  GHashTable *search_mismatches;
+  /* TRUE while refiltering because the search text grew */
+  gboolean search_text_grew;
+  /* Individuals which matched while refiltering because the search text
+   * changed, so they're only matched once even though they're checked for
+   * each of their rows and again for their groups: FolksIndividual -> NULL.
+   * NULL the rest of the time. */
+  GHashTable *search_matches;
 
   guint expand_groups_idle_handler;
   /* owned string (group name) -> bool (whether to expand/contract) */
@@ -91,6 +105,9 @@ typedef struct
 
   GtkTreeModelFilterVisibleFunc custom_filter;
   gpointer custom_filter_data;
+
+  EmpathyIndividualViewMatchFunc match_func;
+  gpointer match_data;
 } EmpathyIndividualViewPriv;
 
 typedef struct
@@ -1343,8 +1360,29 @@ individual_view_search_text_notify_cb (EmpathyLiveSearch *search,
   GtkTreeModel *model;
   GtkTreeIter iter;
   gboolean set_cursor = FALSE;
+  const gchar *text;
+
+  text = empathy_live_search_get_text (search);
+
+  /* Every row is checked again, but when the search text only grows,
+   * individuals which didn't match aren't matched again: an individual not
+   * matching "jo" doesn't match "joh" either. */
+  if (priv->filtered_search_text != NULL &&
+      gtk_widget_get_visible (priv->search_widget) &&
+      g_str_has_prefix (text, priv->filtered_search_text))
+    priv->search_text_grew = TRUE;
+  else
+    g_hash_table_remove_all (priv->search_mismatches);
 
+  priv->search_matches = g_hash_table_new (NULL, NULL);
   gtk_tree_model_filter_refilter (priv->filter);
+  tp_clear_pointer (&priv->search_matches, g_hash_table_unref);
+  priv->search_text_grew = FALSE;
+
+  g_free (priv->filtered_search_text);
+  priv->filtered_search_text = NULL;
+  if (gtk_widget_get_visible (priv->search_widget))
+    priv->filtered_search_text = g_strdup (text);
 
   /* Set cursor on the first contact. If it is already set on a group,
    * set it on its first child contact. Note that first child of a group
@@ -1435,6 +1473,9 @@ individual_view_search_hide_cb (EmpathyLiveSearch *search,
   GtkTreeIter iter;
   gboolean valid = FALSE;
 
+  tp_clear_pointer (&priv->filtered_search_text, g_free);
+  g_hash_table_remove_all (priv->search_mismatches);
+
   /* block expand or collapse handlers, they would write the
    * expand or collapsed setting to file otherwise */
   g_signal_handlers_block_by_func (view,
@@ -1498,6 +1539,12 @@ static void
 individual_view_search_show_cb (EmpathyLiveSearch *search,
     EmpathyIndividualView *view)
 {
+  EmpathyIndividualViewPriv *priv = GET_PRIV (view);
+
+  /* The filter doesn't know about the search yet */
+  tp_clear_pointer (&priv->filtered_search_text, g_free);
+  g_hash_table_remove_all (priv->search_mismatches);
+
   /* block expand or collapse handlers during expand all, they would
    * write the expand or collapsed setting to file otherwise */
   g_signal_handlers_block_by_func (view,
@@ -1651,6 +1698,7 @@ individual_view_is_visible_individual (EmpathyIndividualView *self,
   GeeSet *personas;
   GeeIterator *iter;
   gboolean is_favorite;
+  gboolean matches;
 
   /* Always display individuals having pending events */
   if (event_count > 0)
@@ -1698,9 +1746,41 @@ individual_view_is_visible_individual (EmpathyIndividualView *self,
     return (priv->show_offline || is_online);
   }
 
-  return empathy_individual_match_string (individual,
-      empathy_live_search_get_text (live),
-      empathy_live_search_get_words (live));
+  if (priv->search_text_grew &&
+      g_hash_table_lookup_extended (priv->search_mismatches, individual,
+          NULL, NULL))
+    return FALSE;
+
+  if (priv->search_matches != NULL &&
+      g_hash_table_lookup_extended (priv->search_matches, individual,
+          NULL, NULL))
+    return TRUE;
+
+  if (priv->match_func != NULL)
+    matches = priv->match_func (individual,
+        empathy_live_search_get_text (live),
+        empathy_live_search_get_words (live), priv->match_data);
+  else if (priv->store == NULL)
+    matches = empathy_individual_match_string (individual,
+        empathy_live_search_get_text (live),
+        empathy_live_search_get_words (live));
+  else
+    matches = empathy_individual_store_match_individual (priv->store,
+        individual, empathy_live_search_get_text (live),
+        empathy_live_search_get_words (live));
+
+  if (matches)
+    {
+      g_hash_table_remove (priv->search_mismatches, individual);
+
+      if (priv->search_matches != NULL)
+        g_hash_table_insert (priv->search_matches, individual, NULL);
+    }
+  else
+    g_hash_table_insert (priv->search_mismatches, g_object_ref (individual),
+        NULL);
+
+  return matches;
 }
 
 static gchar *
@@ -2018,6 +2098,8 @@ individual_view_finalize (GObject *object)
   if (priv->expand_groups_idle_handler != 0)
     g_source_remove (priv->expand_groups_idle_handler);
   g_hash_table_unref (priv->expand_groups);
+  g_free (priv->filtered_search_text);
+  g_hash_table_unref (priv->search_mismatches);
 
   G_OBJECT_CLASS (empathy_individual_view_parent_class)->finalize (object);
 }
@@ -2202,6 +2284,8 @@ empathy_individual_view_init (EmpathyIndividualView *view)
 
   priv->expand_groups = g_hash_table_new_full (g_str_hash, g_str_equal,
       (GDestroyNotify) g_free, NULL);
+  priv->search_mismatches = g_hash_table_new_full (NULL, NULL,
+      g_object_unref, NULL);
 
   gtk_tree_view_set_row_separator_func (GTK_TREE_VIEW (view),
       empathy_individual_store_row_separator_func, NULL, NULL);
@@ -2680,6 +2764,9 @@ empathy_individual_view_set_live_search (EmpathyIndividualView *view,
       priv->search_widget = NULL;
     }
 
+  tp_clear_pointer (&priv->filtered_search_text, g_free);
+  g_hash_table_remove_all (priv->search_mismatches);
+
   /* connect handlers if new search is not null */
   if (search != NULL)
     {
@@ -2842,6 +2929,20 @@ empathy_individual_view_set_custom_filter (EmpathyIndividualView *self,
   priv->custom_filter_data = data;
 }
 
+/* Replaces the matching of individuals against the search, for the tests */
+void
+empathy_individual_view_set_match_func (EmpathyIndividualView *self,
+    EmpathyIndividualViewMatchFunc func,
+    gpointer user_data)
+{
+  EmpathyIndividualViewPriv *priv = GET_PRIV (self);
+
+  g_return_if_fail (EMPATHY_IS_INDIVIDUAL_VIEW (self));
+
+  priv->match_func = func;
+  priv->match_data = user_data;
+}
+
 void
 empathy_individual_view_refilter (EmpathyIndividualView *self)
 {
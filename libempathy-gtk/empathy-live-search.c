@@ -238,6 +238,67 @@ empathy_live_search_match_words (const gchar *string,
   return TRUE;
 }
 
+/* Same as live_search_match_prefix(), on a string already stripped by
+ * empathy_live_search_strip_utf8_string() */
+static gboolean
+live_search_match_prefix_stripped (GPtrArray *string_words,
+    const gchar *prefix)
+{
+  const gchar *prefix_p;
+  guint i;
+
+  if (prefix == NULL || prefix[0] == 0)
+    return TRUE;
+
+  if (string_words == NULL)
+    return FALSE;
+
+  prefix_p = prefix;
+  for (i = 0; i < string_words->len; i++)
+    {
+      const gchar *p;
+
+      for (p = g_ptr_array_index (string_words, i); *p != '\0';
+           p = g_utf8_next_char (p))
+        {
+          /* If this char does not match prefix_p, go to next word and start
+           * again from the beginning of prefix */
+          if (g_utf8_get_char (p) != g_utf8_get_char (prefix_p))
+            {
+              prefix_p = prefix;
+              break;
+            }
+
+          prefix_p = g_utf8_next_char (prefix_p);
+          if (*prefix_p == '\0')
+            return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/* @string_words = empathy_live_search_strip_utf8_string (@string);
+ *
+ * Same as empathy_live_search_match_words (@string, @words), for callers
+ * keeping the stripped version of strings they match often. */
+gboolean
+empathy_live_search_match_stripped_words (GPtrArray *string_words,
+    GPtrArray *words)
+{
+  guint i;
+
+  if (words == NULL)
+    return TRUE;
+
+  for (i = 0; i < words->len; i++)
+    if (!live_search_match_prefix_stripped (string_words,
+            g_ptr_array_index (words, i)))
+      return FALSE;
+
+  return TRUE;
+}
+
 static gboolean
 fire_key_navigation_sig (EmpathyLiveSearch *self,
     GdkEventKey *event)
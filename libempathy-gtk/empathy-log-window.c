@@ -1262,7 +1262,6 @@ log_window_append_chat_message (TplEvent *event,
   GtkTreeIter iter, parent;
   gchar *pretty_date, *alias, *body;
   GDateTime *date;
-  EmpathyStringParser *parsers;
   GString *msg;
 
   date = g_date_time_new_from_unix_local (
@@ -1276,13 +1275,12 @@ log_window_append_chat_message (TplEvent *event,
       tpl_entity_get_alias (tpl_event_get_sender (event)), -1);
 
   /* escape the text */
-  parsers = empathy_webkit_get_string_parser (
-      g_settings_get_boolean (log_window->priv->gsettings_chat,
-        EMPATHY_PREFS_CHAT_SHOW_SMILEYS));
   msg = g_string_new ("");
 
-  empathy_string_parser_substr (empathy_message_get_body (message), -1,
-      parsers, msg);
+  empathy_webkit_parse_text (empathy_message_get_body (message), -1,
+      g_settings_get_boolean (log_window->priv->gsettings_chat,
+        EMPATHY_PREFS_CHAT_SHOW_SMILEYS),
+      msg);
 
   if (tpl_text_event_get_message_type (TPL_TEXT_EVENT (event))
       == TP_CHANNEL_TEXT_MESSAGE_TYPE_ACTION)
@@ -38,6 +38,7 @@
 #include <folks/folks.h>
 #include <folks/folks-telepathy.h>
 
+#include <libempathy/empathy-timer-wheel.h>
 #include <libempathy/empathy-utils.h>
 
 #include "empathy-persona-store.h"
@@ -82,6 +83,8 @@ typedef struct
   guint setup_idle_id;
 
   GHashTable *status_icons; /* owned icon name -> owned GdkPixbuf */
+  /* owned ShowActiveData of the personas currently shown as active */
+  EmpathyTimerWheel *active_wheel;
 } EmpathyPersonaStorePriv;
 
 enum {
@@ -108,35 +111,21 @@ inhibit_active_cb (EmpathyPersonaStore *store)
 }
 
 typedef struct {
-  EmpathyPersonaStore *store;
-  FolksPersona *persona;
+  FolksPersona *persona; /* weak */
   gboolean remove;
-  guint timeout;
 } ShowActiveData;
 
-static void persona_active_free (ShowActiveData *data);
-
 static void
 persona_active_invalidated (ShowActiveData *data,
     GObject *old_object)
 {
-  /* Remove the timeout and free the struct, since the persona or persona
-   * store has disappeared. */
-  g_source_remove (data->timeout);
-
-  if (old_object == (GObject *) data->store)
-    data->store = NULL;
-  else if (old_object == (GObject *) data->persona)
-    data->persona = NULL;
-  else
-    g_assert_not_reached ();
-
-  persona_active_free (data);
+  /* The persona has disappeared, there is nothing left to do when the data
+   * expires. */
+  data->persona = NULL;
 }
 
 static ShowActiveData *
-persona_active_new (EmpathyPersonaStore *self,
-    FolksPersona *persona,
+persona_active_new (FolksPersona *persona,
     gboolean remove_)
 {
   ShowActiveData *data;
@@ -147,15 +136,12 @@ persona_active_new (EmpathyPersonaStore *self,
 
   data = g_slice_new0 (ShowActiveData);
 
-  /* We don't actually want to force either the PersonaStore or the
-   * Persona to stay alive, since the user could quit Empathy or disable
-   * the account before the persona_active timeout is fired. */
-  g_object_weak_ref (G_OBJECT (self),
-      (GWeakNotify) persona_active_invalidated, data);
+  /* We don't actually want to force the Persona to stay alive, since the
+   * user could disable the account before the persona_active timeout is
+   * fired. The data doesn't outlive the store, which owns the wheel. */
   g_object_weak_ref (G_OBJECT (persona),
       (GWeakNotify) persona_active_invalidated, data);
 
-  data->store = self;
   data->persona = persona;
   data->remove = remove_;
 
@@ -165,12 +151,6 @@ persona_active_new (EmpathyPersonaStore *self,
 static void
 persona_active_free (ShowActiveData *data)
 {
-  if (data->store != NULL)
-    {
-      g_object_weak_unref (G_OBJECT (data->store),
-          (GWeakNotify) persona_active_invalidated, data);
-    }
-
   if (data->persona != NULL)
     {
       g_object_weak_unref (G_OBJECT (data->persona),
@@ -206,24 +186,33 @@ persona_set_active (EmpathyPersonaStore *self,
   gtk_tree_path_free (path);
 }
 
-static gboolean
-persona_active_cb (ShowActiveData *data)
+static void
+persona_active_cb (GPtrArray *expired,
+    gpointer user_data)
 {
-  const gchar *alias =
-      folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (data->persona));
+  EmpathyPersonaStore *self = user_data;
+  guint i;
 
-  if (data->remove)
+  for (i = 0; i < expired->len; i++)
     {
-      DEBUG ("Contact:'%s' active timeout, removing item", alias);
-      remove_persona (data->store, data->persona);
-    }
+      ShowActiveData *data = g_ptr_array_index (expired, i);
+      const gchar *alias;
 
-  DEBUG ("Contact:'%s' no longer active", alias);
-  persona_set_active (data->store, data->persona, FALSE, TRUE);
+      if (data->persona == NULL)
+        continue;
 
-  persona_active_free (data);
+      alias = folks_alias_details_get_alias (
+          FOLKS_ALIAS_DETAILS (data->persona));
 
-  return FALSE;
+      if (data->remove)
+        {
+          DEBUG ("Contact:'%s' active timeout, removing item", alias);
+          remove_persona (self, data->persona);
+        }
+
+      DEBUG ("Contact:'%s' no longer active", alias);
+      persona_set_active (self, data->persona, FALSE, TRUE);
+    }
 }
 
 static void
@@ -521,12 +510,8 @@ update_persona (EmpathyPersonaStore *self,
 
       if (do_set_active)
         {
-          ShowActiveData *data;
-
-          data = persona_active_new (self, persona, FALSE);
-          data->timeout = g_timeout_add_seconds (ACTIVE_USER_SHOW_TIME,
-              (GSourceFunc) persona_active_cb,
-              data);
+          empathy_timer_wheel_add (priv->active_wheel,
+              persona_active_new (persona, FALSE));
         }
     }
 
@@ -808,6 +793,8 @@ empathy_persona_store_init (EmpathyPersonaStore *self)
       g_object_unref);
   priv->personas = g_hash_table_new_full (g_direct_hash, g_direct_equal,
       g_object_unref, (GDestroyNotify) gtk_tree_row_reference_free);
+  priv->active_wheel = empathy_timer_wheel_new (ACTIVE_USER_SHOW_TIME,
+      persona_active_cb, self, (GDestroyNotify) persona_active_free);
 
   set_up (self);
 }
@@ -890,6 +877,9 @@ dispose (GObject *object)
       priv->setup_idle_id = 0;
     }
 
+  empathy_timer_wheel_free (priv->active_wheel);
+  priv->active_wheel = NULL;
+
   G_OBJECT_CLASS (empathy_persona_store_parent_class)->dispose (object);
 }
 
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include "empathy-pixbuf-cache.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_OTHER
+#include <libempathy/empathy-debug.h>
+
+/* About 2000 avatars of 32x32 pixels */
+#define AVATARS_BUDGET (8 * 1024 * 1024)
+
+struct _EmpathyPixbufCache
+{
+  /* "<width>x<height>:<id>" -> owned Entry */
+  GHashTable *entries;
+  /* Most recently used first */
+  GQueue lru;
+  gsize budget;
+  gsize size;
+};
+
+typedef struct
+{
+  gchar *key;
+  GdkPixbuf *pixbuf;
+  gsize size;
+  GList link;
+} Entry;
+
+static gchar *
+pixbuf_cache_make_key (const gchar *id,
+    gint width,
+    gint height)
+{
+  return g_strdup_printf ("%dx%d:%s", width, height, id);
+}
+
+static gsize
+pixbuf_get_byte_size (GdkPixbuf *pixbuf)
+{
+  return (gsize) gdk_pixbuf_get_rowstride (pixbuf) *
+      gdk_pixbuf_get_height (pixbuf);
+}
+
+static void
+entry_free (Entry *entry)
+{
+  g_free (entry->key);
+  g_object_unref (entry->pixbuf);
+  g_slice_free (Entry, entry);
+}
+
+static void
+pixbuf_cache_remove (EmpathyPixbufCache *cache,
+    Entry *entry)
+{
+  g_queue_unlink (&cache->lru, &entry->link);
+  cache->size -= entry->size;
+
+  /* Frees the entry */
+  g_hash_table_remove (cache->entries, entry->key);
+}
+
+/**
+ * empathy_pixbuf_cache_new:
+ * @budget: the number of bytes of pixels the cache can keep
+ *
+ * Pixbufs are kept by the id of the image they were decoded from, and the
+ * size they were scaled to. The least recently used ones are dropped once
+ * they take more than @budget.
+ *
+ * Returns: a new #EmpathyPixbufCache
+ */
+EmpathyPixbufCache *
+empathy_pixbuf_cache_new (gsize budget)
+{
+  EmpathyPixbufCache *cache;
+
+  cache = g_slice_new0 (EmpathyPixbufCache);
+  cache->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+      NULL, (GDestroyNotify) entry_free);
+  g_queue_init (&cache->lru);
+  cache->budget = budget;
+
+  return cache;
+}
+
+/* Returns: (transfer full): the pixbuf, or %NULL if it isn't cached */
+GdkPixbuf *
+empathy_pixbuf_cache_lookup (EmpathyPixbufCache *cache,
+    const gchar *id,
+    gint width,
+    gint height)
+{
+  Entry *entry;
+  gchar *key;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (id != NULL, NULL);
+
+  key = pixbuf_cache_make_key (id, width, height);
+  entry = g_hash_table_lookup (cache->entries, key);
+  g_free (key);
+
+  if (entry == NULL)
+    return NULL;
+
+  g_queue_unlink (&cache->lru, &entry->link);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+
+  return g_object_ref (entry->pixbuf);
+}
+
+/* The pixbuf is shared by everyone looking it up, so it must not be changed
+ * once it's inserted */
+void
+empathy_pixbuf_cache_insert (EmpathyPixbufCache *cache,
+    const gchar *id,
+    gint width,
+    gint height,
+    GdkPixbuf *pixbuf)
+{
+  Entry *entry;
+  gchar *key;
+  gsize size;
+
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (id != NULL);
+  g_return_if_fail (GDK_IS_PIXBUF (pixbuf));
+
+  size = pixbuf_get_byte_size (pixbuf);
+  if (size > cache->budget)
+    return;
+
+  key = pixbuf_cache_make_key (id, width, height);
+
+  entry = g_hash_table_lookup (cache->entries, key);
+  if (entry != NULL)
+    pixbuf_cache_remove (cache, entry);
+
+  while (cache->size + size > cache->budget)
+    pixbuf_cache_remove (cache, g_queue_peek_tail_link (&cache->lru)->data);
+
+  entry = g_slice_new0 (Entry);
+  entry->key = key;
+  entry->pixbuf = g_object_ref (pixbuf);
+  entry->size = size;
+  entry->link.data = entry;
+
+  g_hash_table_insert (cache->entries, entry->key, entry);
+  g_queue_push_head_link (&cache->lru, &entry->link);
+  cache->size += size;
+}
+
+gsize
+empathy_pixbuf_cache_get_size (EmpathyPixbufCache *cache)
+{
+  g_return_val_if_fail (cache != NULL, 0);
+
+  return cache->size;
+}
+
+void
+empathy_pixbuf_cache_free (EmpathyPixbufCache *cache)
+{
+  g_return_if_fail (cache != NULL);
+
+  g_hash_table_unref (cache->entries);
+  g_slice_free (EmpathyPixbufCache, cache);
+}
+
+/**
+ * empathy_pixbuf_cache_get_avatars:
+ *
+ * Returns: (transfer none): the cache shared by everything showing avatars,
+ * with ids which change whenever the avatar does (such as the file named
+ * after the avatar token)
+ */
+EmpathyPixbufCache *
+empathy_pixbuf_cache_get_avatars (void)
+{
+  static EmpathyPixbufCache *avatars = NULL;
+
+  if (G_UNLIKELY (avatars == NULL))
+    avatars = empathy_pixbuf_cache_new (AVATARS_BUDGET);
+
+  return avatars;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_PIXBUF_CACHE_H__
+#define __EMPATHY_PIXBUF_CACHE_H__
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EmpathyPixbufCache EmpathyPixbufCache;
+
+EmpathyPixbufCache *empathy_pixbuf_cache_new (gsize budget);
+GdkPixbuf *empathy_pixbuf_cache_lookup (EmpathyPixbufCache *cache,
+    const gchar *id,
+    gint width,
+    gint height);
+void empathy_pixbuf_cache_insert (EmpathyPixbufCache *cache,
+    const gchar *id,
+    gint width,
+    gint height,
+    GdkPixbuf *pixbuf);
+gsize empathy_pixbuf_cache_get_size (EmpathyPixbufCache *cache);
+void empathy_pixbuf_cache_free (EmpathyPixbufCache *cache);
+
+EmpathyPixbufCache *empathy_pixbuf_cache_get_avatars (void);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_PIXBUF_CACHE_H__ */
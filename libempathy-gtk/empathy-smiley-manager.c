@@ -30,10 +30,27 @@
 
 typedef struct _SmileyManagerTree SmileyManagerTree;
 
+/* A node of the flattened tree. Children of a node are stored next to each
+ * other in the nodes array, sorted by character. Index 0 is the root, which
+ * is nobody's child, so a child index of 0 means "no child". */
+typedef struct {
+	gunichar     c;
+	guint        first_child;
+	guint        n_children;
+	GdkPixbuf   *pixbuf;     /* Owned by the SmileyManagerTree node */
+	const gchar *path;       /* Owned by the SmileyManagerTree node */
+} SmileyManagerNode;
+
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathySmileyManager)
 typedef struct {
 	SmileyManagerTree *tree;
 	GSList            *smileys;
+	/* Array of SmileyManagerNode flattened from tree, rebuilt when
+	 * smileys are added. */
+	GArray            *nodes;
+	gboolean           nodes_dirty;
+	/* Bitmap of the first byte (in UTF-8) of all smileys */
+	guint32            start_bytes[256 / 32];
 } EmpathySmileyManagerPriv;
 
 struct _SmileyManagerTree {
@@ -108,6 +125,7 @@ smiley_manager_finalize (GObject *object)
 	EmpathySmileyManagerPriv *priv = GET_PRIV (object);
 
 	smiley_manager_tree_free (priv->tree);
+	g_array_unref (priv->nodes);
 	g_slist_foreach (priv->smileys, (GFunc) smiley_free, NULL);
 	g_slist_free (priv->smileys);
 }
@@ -152,6 +170,7 @@ empathy_smiley_manager_init (EmpathySmileyManager *manager)
 	manager->priv = priv;
 	priv->tree = smiley_manager_tree_new ('\0');
 	priv->smileys = NULL;
+	priv->nodes = g_array_new (FALSE, TRUE, sizeof (SmileyManagerNode));
 
 	empathy_smiley_manager_load (manager);
 }
@@ -227,6 +246,7 @@ smiley_manager_add_valist (EmpathySmileyManager *manager,
 	for (str = first_str; str; str = va_arg (var_args, gchar*)) {
 		smiley_manager_tree_insert (priv->tree, pixbuf, str, path);
 	}
+	priv->nodes_dirty = TRUE;
 
 	g_object_set_data_full (G_OBJECT (pixbuf), "smiley_str",
 				g_strdup (first_str), g_free);
@@ -260,6 +280,103 @@ empathy_smiley_manager_add (EmpathySmileyManager *manager,
 	}
 }
 
+static gint
+smiley_manager_tree_compare (gconstpointer a,
+			     gconstpointer b)
+{
+	const SmileyManagerTree *tree_a = a;
+	const SmileyManagerTree *tree_b = b;
+
+	if (tree_a->c == tree_b->c) {
+		return 0;
+	}
+
+	return tree_a->c < tree_b->c ? -1 : 1;
+}
+
+#define SMILEY_START_BYTE_IS_SET(priv, byte) \
+	(((priv)->start_bytes[(guchar) (byte) / 32] & \
+	  (1U << ((guchar) (byte) % 32))) != 0)
+
+static void
+smiley_manager_flatten (EmpathySmileyManager *manager)
+{
+	EmpathySmileyManagerPriv *priv = GET_PRIV (manager);
+	GPtrArray                *trees;
+	SmileyManagerNode         root = { 0, };
+	GSList                   *l;
+	guint                     i;
+
+	/* Nodes are added breadth-first, trees[i] is the tree of nodes[i] */
+	g_array_set_size (priv->nodes, 0);
+	trees = g_ptr_array_new ();
+
+	g_array_append_val (priv->nodes, root);
+	g_ptr_array_add (trees, priv->tree);
+
+	for (i = 0; i < trees->len; i++) {
+		SmileyManagerTree *tree = g_ptr_array_index (trees, i);
+		SmileyManagerNode *node;
+		GSList            *children;
+
+		node = &g_array_index (priv->nodes, SmileyManagerNode, i);
+		node->c = tree->c;
+		node->pixbuf = tree->pixbuf;
+		node->path = tree->path;
+		node->first_child = trees->len;
+		node->n_children = g_slist_length (tree->childrens);
+
+		/* Children are sorted so we can bisect them */
+		children = g_slist_sort (g_slist_copy (tree->childrens),
+					 smiley_manager_tree_compare);
+		for (l = children; l; l = l->next) {
+			SmileyManagerNode child = { 0, };
+
+			g_array_append_val (priv->nodes, child);
+			g_ptr_array_add (trees, l->data);
+		}
+		g_slist_free (children);
+	}
+
+	/* Remember which bytes can start a smiley */
+	memset (priv->start_bytes, 0, sizeof (priv->start_bytes));
+	for (l = priv->tree->childrens; l; l = l->next) {
+		SmileyManagerTree *child = l->data;
+		gchar              utf8[6];
+		guchar             byte;
+
+		g_unichar_to_utf8 (child->c, utf8);
+		byte = utf8[0];
+		priv->start_bytes[byte / 32] |= 1U << (byte % 32);
+	}
+
+	g_ptr_array_unref (trees);
+	priv->nodes_dirty = FALSE;
+}
+
+static guint
+smiley_manager_find_child (const SmileyManagerNode *nodes,
+			   guint                    parent,
+			   gunichar                 c)
+{
+	guint lower = nodes[parent].first_child;
+	guint upper = lower + nodes[parent].n_children;
+
+	while (lower < upper) {
+		guint middle = lower + (upper - lower) / 2;
+
+		if (nodes[middle].c == c) {
+			return middle;
+		} else if (nodes[middle].c < c) {
+			lower = middle + 1;
+		} else {
+			upper = middle;
+		}
+	}
+
+	return 0;
+}
+
 void
 empathy_smiley_manager_load (EmpathySmileyManager *manager)
 {
@@ -287,46 +404,50 @@ empathy_smiley_manager_load (EmpathySmileyManager *manager)
 	empathy_smiley_manager_add (manager, "face-uncertain",  ":-/",   ":/",   NULL);
 	empathy_smiley_manager_add (manager, "face-wink",       ";-)",   ";)",   NULL);
 	empathy_smiley_manager_add (manager, "face-worried",    ":-S",   ":S",   ":-s", ":s", NULL);
-}
-
-static EmpathySmileyHit *
-smiley_hit_new (SmileyManagerTree *tree,
-		guint              start,
-		guint              end)
-{
-	EmpathySmileyHit *hit;
-
-	hit = g_slice_new (EmpathySmileyHit);
-	hit->pixbuf = tree->pixbuf;
-	hit->path = tree->path;
-	hit->start = start;
-	hit->end = end;
 
-	return hit;
+	smiley_manager_flatten (manager);
 }
 
-void
-empathy_smiley_hit_free (EmpathySmileyHit *hit)
+static void
+smiley_hit_append (GArray                  *hits,
+		   const SmileyManagerNode *node,
+		   guint                    start,
+		   guint                    end)
 {
-	g_return_if_fail (hit != NULL);
+	EmpathySmileyHit hit;
+
+	hit.pixbuf = node->pixbuf;
+	hit.path = node->path;
+	hit.start = start;
+	hit.end = end;
 
-	g_slice_free (EmpathySmileyHit, hit);
+	g_array_append_val (hits, hit);
 }
 
-GSList *
+/* Appends an EmpathySmileyHit to hits for each smiley found in the len first
+ * bytes of text, and returns the number of smileys found. */
+guint
 empathy_smiley_manager_parse_len (EmpathySmileyManager *manager,
 				  const gchar          *text,
-				  gssize                len)
+				  gssize                len,
+				  GArray               *hits)
 {
 	EmpathySmileyManagerPriv *priv = GET_PRIV (manager);
-	EmpathySmileyHit         *hit;
-	GSList                   *hits = NULL;
-	SmileyManagerTree        *cur_tree = priv->tree;
+	const SmileyManagerNode  *nodes;
+	guint                     cur_node = 0;
+	guint                     old_len;
 	const gchar              *cur_str;
 	const gchar              *start = NULL;
 
-	g_return_val_if_fail (EMPATHY_IS_SMILEY_MANAGER (manager), NULL);
-	g_return_val_if_fail (text != NULL, NULL);
+	g_return_val_if_fail (EMPATHY_IS_SMILEY_MANAGER (manager), 0);
+	g_return_val_if_fail (text != NULL, 0);
+	g_return_val_if_fail (hits != NULL, 0);
+
+	if (priv->nodes_dirty) {
+		smiley_manager_flatten (manager);
+	}
+	nodes = (const SmileyManagerNode *) priv->nodes->data;
+	old_len = hits->len;
 
 	/* If len is negative, parse the string until we find '\0' */
 	if (len < 0) {
@@ -334,9 +455,8 @@ empathy_smiley_manager_parse_len (EmpathySmileyManager *manager,
 	}
 
 	/* Parse the len first bytes of text to find smileys. Each time a smiley
-	 * is detected, append a EmpathySmileyHit struct to the returned list,
-	 * containing the smiley pixbuf and the position of the text to be
-	 * replaced by it.
+	 * is detected, append a EmpathySmileyHit struct to hits, containing
+	 * the smiley pixbuf and the position of the text to be replaced by it.
 	 * cur_str is a pointer in the text showing the current position
 	 * of the parsing. It is always at the begining of an UTF-8 character,
 	 * because we support unicode smileys! For example we could want to
@@ -345,40 +465,51 @@ empathy_smiley_manager_parse_len (EmpathySmileyManager *manager,
 	for (cur_str = text;
 	     *cur_str != '\0' && cur_str - text < len;
 	     cur_str = g_utf8_next_char (cur_str)) {
-		SmileyManagerTree *child;
-		gunichar           c;
+		guint    child;
+		gunichar c;
+
+		/* Not in a smiley: skip bytes which can't start one. Those
+		 * include UTF-8 continuation bytes so we still end up at the
+		 * begining of a character. */
+		if (cur_node == 0) {
+			while (*cur_str != '\0' && cur_str - text < len &&
+			       !SMILEY_START_BYTE_IS_SET (priv, *cur_str)) {
+				cur_str++;
+			}
+
+			if (*cur_str == '\0' || cur_str - text >= len) {
+				break;
+			}
+		}
 
 		c = g_utf8_get_char (cur_str);
-		child = smiley_manager_tree_find_child (cur_tree, c);
+		child = smiley_manager_find_child (nodes, cur_node, c);
 
 		/* If we have a child it means c is part of a smiley */
-		if (child) {
-			if (cur_tree == priv->tree) {
+		if (child != 0) {
+			if (cur_node == 0) {
 				/* c is the first char of some smileys, keep
 				 * the begining position */
 				start = cur_str;
 			}
-			cur_tree = child;
+			cur_node = child;
 			continue;
 		}
 
 		/* c is not part of a smiley. let's check if we found a smiley
 		 * before it. */
-		if (cur_tree->pixbuf != NULL) {
+		if (nodes[cur_node].pixbuf != NULL) {
 			/* found! */
-			hit = smiley_hit_new (cur_tree, start - text,
-					      cur_str - text);
-			hits = g_slist_prepend (hits, hit);
+			smiley_hit_append (hits, &nodes[cur_node],
+					   start - text, cur_str - text);
 
 			/* c was not part of this smiley, check if a new smiley
 			 * start with it. */
-			cur_tree = smiley_manager_tree_find_child (priv->tree, c);
-			if (cur_tree) {
+			cur_node = smiley_manager_find_child (nodes, 0, c);
+			if (cur_node != 0) {
 				start = cur_str;
-			} else {
-				cur_tree = priv->tree;
 			}
-		} else if (cur_tree != priv->tree) {
+		} else if (cur_node != 0) {
 			/* We searched a smiley starting at 'start' but we ended
 			 * with no smiley. Look again starting from next char.
 			 *
@@ -391,17 +522,17 @@ empathy_smiley_manager_parse_len (EmpathySmileyManager *manager,
 			 * have to start again from ':' to find ":(" which is
 			 * correct smiley. */
 			cur_str = start;
-			cur_tree = priv->tree;
+			cur_node = 0;
 		}
 	}
 
 	/* Check if last char of the text was the end of a smiley */
-	if (cur_tree->pixbuf != NULL) {
-		hit = smiley_hit_new (cur_tree, start - text, cur_str - text);
-		hits = g_slist_prepend (hits, hit);
+	if (nodes[cur_node].pixbuf != NULL) {
+		smiley_hit_append (hits, &nodes[cur_node],
+				   start - text, cur_str - text);
 	}
 
-	return g_slist_reverse (hits);
+	return hits->len - old_len;
 }
 
 GSList *
@@ -71,13 +71,13 @@ void                  empathy_smiley_manager_add             (EmpathySmileyManag
 							      const gchar          *first_str,
 							      ...);
 GSList *              empathy_smiley_manager_get_all         (EmpathySmileyManager *manager);
-GSList *              empathy_smiley_manager_parse_len       (EmpathySmileyManager *manager,
+guint                 empathy_smiley_manager_parse_len       (EmpathySmileyManager *manager,
 							      const gchar          *text,
-							      gssize                len);
+							      gssize                len,
+							      GArray               *hits);
 GtkWidget *           empathy_smiley_menu_new                (EmpathySmileyManager *manager,
 							      EmpathySmileyMenuFunc func,
 							      gpointer              user_data);
-void                  empathy_smiley_hit_free                (EmpathySmileyHit     *hit);
 
 G_END_DECLS
 
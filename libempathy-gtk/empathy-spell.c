@@ -45,14 +45,29 @@ typedef struct {
 	EnchantDict   *speller;
 } SpellLanguage;
 
+typedef struct {
+	gchar    *word;
+	gboolean  correct;
+	GList     link;
+} SpellCacheEntry;
+
 #define ISO_CODES_DATADIR    ISO_CODES_PREFIX "/share/xml/iso-codes"
 #define ISO_CODES_LOCALESDIR ISO_CODES_PREFIX "/share/locale"
 
+/* Number of words whose spelling is remembered */
+#define WORD_CACHE_SIZE 2048
+
 /* Language code (gchar *) -> language name (gchar *) */
 static GHashTable  *iso_code_names = NULL;
 /* Contains only _enabled_ languages
  * Language code (gchar *) -> language (SpellLanguage *) */
 static GHashTable  *languages = NULL;
+/* Results of empathy_spell_check() with the enabled languages, so words
+ * typed again and again don't go through every dictionary each time.
+ * Word (gchar *) -> result (SpellCacheEntry *) */
+static GHashTable  *word_cache = NULL;
+/* Most recently checked first */
+static GQueue       word_cache_lru = G_QUEUE_INIT;
 
 static void
 spell_iso_codes_parse_start_tag (GMarkupParseContext  *ctx,
@@ -160,6 +175,95 @@ spell_iso_code_names_init (void)
 	}
 }
 
+static void
+spell_cache_entry_free (SpellCacheEntry *entry)
+{
+	g_free (entry->word);
+	g_slice_free (SpellCacheEntry, entry);
+}
+
+static void
+spell_cache_remove (const gchar *word)
+{
+	SpellCacheEntry *entry;
+
+	if (word_cache == NULL) {
+		return;
+	}
+
+	entry = g_hash_table_lookup (word_cache, word);
+	if (entry == NULL) {
+		return;
+	}
+
+	g_queue_unlink (&word_cache_lru, &entry->link);
+
+	/* Frees the entry */
+	g_hash_table_remove (word_cache, entry->word);
+}
+
+static void
+spell_cache_clear (void)
+{
+	if (word_cache == NULL) {
+		return;
+	}
+
+	/* The links are in the entries */
+	g_hash_table_remove_all (word_cache);
+	g_queue_init (&word_cache_lru);
+}
+
+static gboolean
+spell_cache_lookup (const gchar *word,
+		    gboolean    *correct)
+{
+	SpellCacheEntry *entry;
+
+	if (word_cache == NULL) {
+		return FALSE;
+	}
+
+	entry = g_hash_table_lookup (word_cache, word);
+	if (entry == NULL) {
+		return FALSE;
+	}
+
+	g_queue_unlink (&word_cache_lru, &entry->link);
+	g_queue_push_head_link (&word_cache_lru, &entry->link);
+
+	*correct = entry->correct;
+
+	return TRUE;
+}
+
+static void
+spell_cache_insert (const gchar *word,
+		    gboolean     correct)
+{
+	SpellCacheEntry *entry;
+
+	if (word_cache == NULL) {
+		word_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+				NULL, (GDestroyNotify) spell_cache_entry_free);
+	}
+
+	spell_cache_remove (word);
+
+	if (g_hash_table_size (word_cache) >= WORD_CACHE_SIZE) {
+		entry = g_queue_peek_tail (&word_cache_lru);
+		spell_cache_remove (entry->word);
+	}
+
+	entry = g_slice_new0 (SpellCacheEntry);
+	entry->word = g_strdup (word);
+	entry->correct = correct;
+	entry->link.data = entry;
+
+	g_hash_table_insert (word_cache, entry->word, entry);
+	g_queue_push_head_link (&word_cache_lru, &entry->link);
+}
+
 static void
 spell_notify_languages_cb (GSettings   *gsettings,
 			   const gchar *key,
@@ -172,6 +276,9 @@ spell_notify_languages_cb (GSettings   *gsettings,
 		g_hash_table_unref (languages);
 		languages = NULL;
 	}
+
+	/* The results were for the old languages */
+	spell_cache_clear ();
 }
 
 static void
@@ -320,6 +427,7 @@ empathy_spell_check (const gchar *word)
 	gint         enchant_result = 1;
 	const gchar *p;
 	gboolean     digit;
+	gboolean     correct;
 	gunichar     c;
 	gint         len;
 	GHashTableIter iter;
@@ -345,6 +453,10 @@ empathy_spell_check (const gchar *word)
 		return TRUE;
 	}
 
+	if (spell_cache_lookup (word, &correct)) {
+		return correct;
+	}
+
 	len = strlen (word);
 	g_hash_table_iter_init (&iter, languages);
 	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &lang)) {
@@ -355,7 +467,10 @@ empathy_spell_check (const gchar *word)
 		}
 	}
 
-	return (enchant_result == 0);
+	correct = (enchant_result == 0);
+	spell_cache_insert (word, correct);
+
+	return correct;
 }
 
 GList *
@@ -428,6 +543,10 @@ empathy_spell_add_to_dictionary (const gchar *code,
 		return;
 
 	enchant_dict_add_to_pwl (lang->speller, word, strlen (word));
+
+	/* The personal word list also accepts other cases of the word, which
+	 * may have been misspelled in all the languages until now */
+	spell_cache_clear ();
 }
 
 #else /* not HAVE_ENCHANT */
@@ -125,13 +125,15 @@ empathy_string_match_smiley (const gchar *text,
 {
 	guint last = 0;
 	EmpathySmileyManager *smiley_manager;
-	GSList *hits, *l;
+	GArray *hits;
+	guint i;
 
 	smiley_manager = empathy_smiley_manager_dup_singleton ();
-	hits = empathy_smiley_manager_parse_len (smiley_manager, text, len);
+	hits = g_array_new (FALSE, FALSE, sizeof (EmpathySmileyHit));
+	empathy_smiley_manager_parse_len (smiley_manager, text, len, hits);
 
-	for (l = hits; l; l = l->next) {
-		EmpathySmileyHit *hit = l->data;
+	for (i = 0; i < hits->len; i++) {
+		EmpathySmileyHit *hit = &g_array_index (hits, EmpathySmileyHit, i);
 
 		if (hit->start > last) {
 			/* Append the text between last smiley (or the
@@ -145,10 +147,8 @@ empathy_string_match_smiley (const gchar *text,
 			      hit, user_data);
 
 		last = hit->end;
-
-		empathy_smiley_hit_free (hit);
 	}
-	g_slist_free (hits);
+	g_array_unref (hits);
 	g_object_unref (smiley_manager);
 
 	empathy_string_parser_substr (text + last, len - last,
@@ -221,20 +221,489 @@ empathy_string_replace_escaped (const gchar *text,
 	g_free (escaped);
 }
 
+/* Single pass parser
+ *
+ * The functions below find links, smileys and characters to escape in one
+ * left-to-right pass over the text and write everything into the same
+ * GString. The output must be the same as the one of the link, smiley and
+ * escape parsers chained with empathy_string_parser_substr(), so the link
+ * matcher follows URI_REGEX step by step, including the order in which the
+ * regex engine would backtrack. */
+
+enum {
+	LINK_CHAR_INVALID      = 1 << 0, /* INVALID_CHARS */
+	LINK_CHAR_INVALID_EXT  = 1 << 1, /* INVALID_CHARS_EXT */
+	LINK_CHAR_INVALID_FULL = 1 << 2, /* INVALID_CHARS_FULL */
+	LINK_CHAR_SCHEME       = 1 << 3, /* SCHEMES */
+};
+
+typedef struct {
+	const gchar *text;
+	gsize        len;
+
+	/* Scheme run starting at or before the current position, and where
+	 * a link starting in that run ends, or -1 */
+	gsize        scheme_start;
+	gsize        scheme_end;
+	gssize       scheme_match;
+
+	/* Position of the next '@', or len */
+	gsize        next_at;
+
+	/* Emails can't start anywhere in ]email_fail_from, email_fail_until[ */
+	gsize        email_fail_from;
+	gsize        email_fail_until;
+} LinkMatcher;
+
+static guint8 link_char_classes[128];
+
+static guint
+link_char_class (gunichar c)
+{
+	static gboolean initialized = FALSE;
+
+	if (G_UNLIKELY (!initialized)) {
+		const gchar *chars;
+		guint i;
+
+		for (i = 0; i < G_N_ELEMENTS (link_char_classes); i++) {
+			/* \s of the regex, including vertical tab */
+			if (g_unichar_isspace (i) || i == '\v') {
+				link_char_classes[i] |= LINK_CHAR_INVALID |
+					LINK_CHAR_INVALID_EXT |
+					LINK_CHAR_INVALID_FULL;
+			}
+			if (g_ascii_isalpha (i) || i == '+') {
+				link_char_classes[i] |= LINK_CHAR_SCHEME;
+			}
+		}
+
+		for (chars = "\"<>"; *chars != '\0'; chars++) {
+			link_char_classes[(guchar) *chars] |= LINK_CHAR_INVALID |
+				LINK_CHAR_INVALID_EXT | LINK_CHAR_INVALID_FULL;
+		}
+		for (chars = "[](){},;:"; *chars != '\0'; chars++) {
+			link_char_classes[(guchar) *chars] |=
+				LINK_CHAR_INVALID_EXT | LINK_CHAR_INVALID_FULL;
+		}
+		for (chars = "?'"; *chars != '\0'; chars++) {
+			link_char_classes[(guchar) *chars] |=
+				LINK_CHAR_INVALID_FULL;
+		}
+
+		initialized = TRUE;
+	}
+
+	if (c < G_N_ELEMENTS (link_char_classes)) {
+		return link_char_classes[c];
+	}
+
+	if (g_unichar_isspace (c)) {
+		return LINK_CHAR_INVALID | LINK_CHAR_INVALID_EXT |
+			LINK_CHAR_INVALID_FULL;
+	}
+
+	return 0;
+}
+
+#define LINK_NEXT(m, pos) \
+	((pos) + g_utf8_skip[(guchar) (m)->text[(pos)]])
+#define LINK_CLASS(m, pos) \
+	link_char_class (g_utf8_get_char ((m)->text + (pos)))
+
+/* BODY_END: returns the end of the match starting at pos, or -1 */
+static gssize
+link_match_body_end (LinkMatcher *m,
+		     gsize        pos)
+{
+	gssize end = -1;
+
+	while (pos < m->len) {
+		guint cls = LINK_CLASS (m, pos);
+		gsize next = LINK_NEXT (m, pos);
+
+		if (cls & LINK_CHAR_INVALID) {
+			break;
+		}
+
+		if (!(cls & LINK_CHAR_INVALID_FULL) && m->text[pos] != '.') {
+			end = next;
+		}
+
+		pos = next;
+	}
+
+	return end;
+}
+
+/* First position at or after pos where BODY's second part stops */
+static gsize
+link_body_run_end (LinkMatcher *m,
+		   gsize        pos)
+{
+	while (pos < m->len && !(LINK_CLASS (m, pos) & LINK_CHAR_INVALID_EXT)) {
+		pos = LINK_NEXT (m, pos);
+	}
+
+	return pos;
+}
+
+/* SCHEMES"://"BODY_END */
+static gssize
+link_match_scheme (LinkMatcher *m,
+		   gsize        pos)
+{
+	const gchar *text = m->text;
+	gsize        end;
+
+	if (!(link_char_class ((guchar) text[pos]) & LINK_CHAR_SCHEME)) {
+		return -1;
+	}
+
+	/* Every position of a scheme run gives the same result */
+	if (pos >= m->scheme_start && pos < m->scheme_end) {
+		return m->scheme_match;
+	}
+
+	for (end = pos; end < m->len &&
+	     (link_char_class ((guchar) text[end]) & LINK_CHAR_SCHEME);
+	     end++);
+
+	m->scheme_start = pos;
+	m->scheme_end = end;
+	m->scheme_match = -1;
+	if (end + 3 <= m->len && strncmp (text + end, "://", 3) == 0) {
+		m->scheme_match = link_match_body_end (m, end + 3);
+	}
+
+	return m->scheme_match;
+}
+
+/* (www|ftp)\.BODY_END */
+static gssize
+link_match_www (LinkMatcher *m,
+		gsize        pos)
+{
+	if (pos + 4 > m->len ||
+	    (strncmp (m->text + pos, "www.", 4) != 0 &&
+	     strncmp (m->text + pos, "ftp.", 4) != 0)) {
+		return -1;
+	}
+
+	return link_match_body_end (m, pos + 4);
+}
+
+/* BODY"@"BODY"\."BODY_END */
+static gssize
+link_match_email_body (LinkMatcher *m,
+		       gsize        pos)
+{
+	const gchar *text = m->text;
+	gsize        body_start, body_end;
+	gsize        at;
+
+	if (pos >= m->len ||
+	    (LINK_CLASS (m, pos) & LINK_CHAR_INVALID_FULL)) {
+		return -1;
+	}
+
+	if (pos > m->email_fail_from && pos < m->email_fail_until) {
+		return -1;
+	}
+
+	if (m->next_at < pos && m->next_at < m->len) {
+		const gchar *found;
+
+		found = memchr (text + pos, '@', m->len - pos);
+		m->next_at = found != NULL ? (gsize) (found - text) : m->len;
+	}
+	if (m->next_at == m->len) {
+		return -1;
+	}
+
+	body_start = LINK_NEXT (m, pos);
+	body_end = link_body_run_end (m, body_start);
+
+	/* '@' and '.' are ASCII, they can't be part of a multibyte
+	 * character so we can look for them backward. The regex is greedy,
+	 * so the last '@' and '.' are tried first. */
+	for (at = body_end; at > body_start; at--) {
+		gsize domain_start, domain_end;
+		gsize dot;
+
+		if (text[at - 1] != '@') {
+			continue;
+		}
+
+		/* BODY after the '@' */
+		domain_start = at;
+		if (domain_start >= m->len ||
+		    (LINK_CLASS (m, domain_start) & LINK_CHAR_INVALID_FULL)) {
+			continue;
+		}
+		domain_start = LINK_NEXT (m, domain_start);
+		domain_end = link_body_run_end (m, domain_start);
+
+		for (dot = domain_end; dot > domain_start; dot--) {
+			gssize end;
+
+			if (text[dot - 1] != '.') {
+				continue;
+			}
+
+			end = link_match_body_end (m, dot);
+			if (end >= 0) {
+				return end;
+			}
+		}
+	}
+
+	/* Any later position of this body would give the same result */
+	m->email_fail_from = pos;
+	m->email_fail_until = body_end;
+
+	return -1;
+}
+
+/* (mailto:)?BODY"@"BODY"\."BODY_END */
+static gssize
+link_match_email (LinkMatcher *m,
+		  gsize        pos)
+{
+	if (pos + 7 <= m->len && strncmp (m->text + pos, "mailto:", 7) == 0) {
+		gssize end;
+
+		end = link_match_email_body (m, pos + 7);
+		if (end >= 0) {
+			return end;
+		}
+	}
+
+	return link_match_email_body (m, pos);
+}
+
+/* Finds the first link at or after pos, like g_regex_match_full() with
+ * URI_REGEX would */
+static gboolean
+link_matcher_find (LinkMatcher *m,
+		   gsize        pos,
+		   gsize       *start,
+		   gsize       *end)
+{
+	for (; pos < m->len; pos = LINK_NEXT (m, pos)) {
+		gssize match_end;
+
+		match_end = link_match_scheme (m, pos);
+		if (match_end < 0) {
+			match_end = link_match_www (m, pos);
+		}
+		if (match_end < 0) {
+			match_end = link_match_email (m, pos);
+		}
+
+		if (match_end >= 0) {
+			*start = pos;
+			*end = match_end;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Same as empathy_string_replace_escaped(), replacing '\n' by newline if
+ * not NULL */
+static void
+string_parser_append_escaped (GString     *string,
+			      const gchar *text,
+			      gsize        len,
+			      const gchar *newline,
+			      gboolean     valid_utf8)
+{
+	static gchar *escaped_chars[128] = { NULL, };
+	const gchar *plain = text;
+	const gchar *end = text + len;
+	const gchar *p;
+
+	/* Only valid UTF-8 is escaped inline, g_markup_escape_text() is the
+	 * reference for the rest */
+	if (!valid_utf8) {
+		if (newline == NULL) {
+			empathy_string_replace_escaped (text, len, NULL, string);
+			return;
+		}
+
+		for (p = text; p < end; p++) {
+			if (*p == '\n') {
+				empathy_string_replace_escaped (plain, p - plain,
+					NULL, string);
+				g_string_append (string, newline);
+				plain = p + 1;
+			}
+		}
+		empathy_string_replace_escaped (plain, end - plain, NULL,
+			string);
+		return;
+	}
+
+	for (p = text; p < end; p++) {
+		guchar c = *p;
+		gsize  char_len = 1;
+
+		if (c >= 0x20 && c < 0x7f && c != '&' && c != '<' &&
+		    c != '>' && c != '\'' && c != '"') {
+			continue;
+		}
+
+		/* Multibyte characters are kept as they are, but the C1
+		 * control characters U+0080 to U+009F */
+		if (c >= 0x80 &&
+		    (c != 0xc2 || (guchar) p[1] < 0x80 || (guchar) p[1] > 0x9f)) {
+			continue;
+		}
+
+		g_string_append_len (string, plain, p - plain);
+
+		if (c == '\r') {
+			/* Stripped */
+		} else if (c == '\n' && newline != NULL) {
+			g_string_append (string, newline);
+		} else if (c == '\n' || c == '\t') {
+			g_string_append_c (string, c);
+		} else if (c < G_N_ELEMENTS (escaped_chars)) {
+			/* Ask GLib once how it escapes this character */
+			if (escaped_chars[c] == NULL) {
+				escaped_chars[c] = g_markup_escape_text (p, 1);
+			}
+			g_string_append (string, escaped_chars[c]);
+		} else {
+			char_len = 2;
+			empathy_string_replace_escaped (p, char_len, NULL,
+				string);
+		}
+
+		p += char_len - 1;
+		plain = p + 1;
+	}
+
+	g_string_append_len (string, plain, end - plain);
+}
+
+static void
+string_parser_append_smileys (GString             *string,
+			      const gchar         *text,
+			      gsize                len,
+			      EmpathyStringReplace replace_smiley,
+			      const gchar         *newline,
+			      gboolean             valid_utf8,
+			      GArray             **hits)
+{
+	EmpathySmileyManager *smiley_manager;
+	guint last = 0;
+	guint i;
+
+	if (replace_smiley == NULL) {
+		string_parser_append_escaped (string, text, len, newline,
+			valid_utf8);
+		return;
+	}
+
+	if (*hits == NULL) {
+		*hits = g_array_new (FALSE, FALSE, sizeof (EmpathySmileyHit));
+	}
+	g_array_set_size (*hits, 0);
+
+	smiley_manager = empathy_smiley_manager_dup_singleton ();
+	empathy_smiley_manager_parse_len (smiley_manager, text, len, *hits);
+	g_object_unref (smiley_manager);
+
+	for (i = 0; i < (*hits)->len; i++) {
+		EmpathySmileyHit *hit;
+
+		hit = &g_array_index (*hits, EmpathySmileyHit, i);
+		string_parser_append_escaped (string, text + last,
+			hit->start - last, newline, valid_utf8);
+		replace_smiley (text + hit->start, hit->end - hit->start,
+			hit, string);
+		last = hit->end;
+	}
+
+	string_parser_append_escaped (string, text + last, len - last,
+		newline, valid_utf8);
+}
+
+/* Appends text to string, replacing links with replace_link, smileys with
+ * replace_smiley and '\n' with newline, and escaping everything else. Links,
+ * smileys or newlines are left alone if their replacement is NULL.
+ *
+ * The result is the same as chaining empathy_string_match_link(),
+ * empathy_string_match_smiley(), a newline parser and
+ * empathy_string_replace_escaped(), but in a single pass. */
+void
+empathy_string_parser_fused (const gchar *text,
+			     gssize len,
+			     EmpathyStringReplace replace_link,
+			     EmpathyStringReplace replace_smiley,
+			     const gchar *newline,
+			     GString *string)
+{
+	LinkMatcher m = { 0, };
+	GArray *hits = NULL;
+	const gchar *at;
+	gboolean valid_utf8;
+	gsize last = 0;
+	gsize old_len;
+
+	g_return_if_fail (text != NULL);
+	g_return_if_fail (string != NULL);
+
+	if (len < 0) {
+		len = strlen (text);
+	}
+
+	/* Make room for the text and a few replacements */
+	old_len = string->len;
+	g_string_set_size (string, old_len + len + len / 4);
+	g_string_truncate (string, old_len);
+
+	/* GRegex doesn't match anything on invalid UTF-8 */
+	valid_utf8 = g_utf8_validate (text, len, NULL);
+
+	m.text = text;
+	m.len = len;
+	at = len > 0 ? memchr (text, '@', len) : NULL;
+	m.next_at = at != NULL ? (gsize) (at - text) : (gsize) len;
+
+	if (replace_link != NULL && valid_utf8) {
+		gsize start, end;
+
+		while (link_matcher_find (&m, last, &start, &end)) {
+			string_parser_append_smileys (string, text + last,
+				start - last, replace_smiley, newline,
+				valid_utf8, &hits);
+			replace_link (text + start, end - start, NULL, string);
+			last = end;
+		}
+	}
+
+	string_parser_append_smileys (string, text + last, len - last,
+		replace_smiley, newline, valid_utf8, &hits);
+
+	if (hits != NULL) {
+		g_array_unref (hits);
+	}
+}
+
 gchar *
 empathy_add_link_markup (const gchar *text)
 {
-	EmpathyStringParser parsers[] = {
-		{empathy_string_match_link, empathy_string_replace_link},
-		{empathy_string_match_all, empathy_string_replace_escaped},
-		{NULL, NULL}
-	};
 	GString *string;
 
 	g_return_val_if_fail (text != NULL, NULL);
 
 	string = g_string_sized_new (strlen (text));
-	empathy_string_parser_substr (text, -1, parsers, string);
+	empathy_string_parser_fused (text, -1, empathy_string_replace_link,
+				     NULL, NULL, string);
 
 	return g_string_free (string, FALSE);
 }
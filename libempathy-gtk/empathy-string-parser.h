@@ -82,6 +82,16 @@ empathy_string_replace_escaped (const gchar *text,
 				gpointer match_data,
 				gpointer user_data);
 
+/* Same as chaining the link, smiley, newline and escape parsers, in a single
+ * pass. NULL replace functions or newline disable that part. */
+void
+empathy_string_parser_fused (const gchar *text,
+			     gssize len,
+			     EmpathyStringReplace replace_link,
+			     EmpathyStringReplace replace_smiley,
+			     const gchar *newline,
+			     GString *string);
+
 /* Returns a new string with <a> html tag around links, and escape the rest.
  * To be used with gtk_label_set_markup() for example */
 gchar *
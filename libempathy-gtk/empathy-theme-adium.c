@@ -52,6 +52,9 @@
 /* "Join" consecutive messages with timestamps within five minutes */
 #define MESSAGE_JOIN_PERIOD 5*60
 
+/* Messages appended within a frame are sent to webkit in one script */
+#define APPEND_FRAME_INTERVAL 16
+
 typedef struct {
 	EmpathyAdiumData     *data;
 	EmpathySmileyManager *smiley_manager;
@@ -74,8 +77,49 @@ typedef struct {
 	gboolean              allow_scrolling;
 	gchar                *variant;
 	gboolean              in_construction;
+	/* Javascript appending messages not sent to webkit yet, each call
+	 * uses the shouldScroll variable defined when flushing */
+	GString              *pending_script;
+	guint                 pending_script_id;
+	guint                 batch_depth;
 } EmpathyThemeAdiumPriv;
 
+/* Keywords we know how to replace in message templates. Keywords we
+ * recognise but don't support yet are dropped when compiling the template. */
+typedef enum {
+	ADIUM_KEYWORD_NONE,
+	ADIUM_KEYWORD_LITERAL,
+	ADIUM_KEYWORD_USER_ICON_PATH,
+	ADIUM_KEYWORD_SENDER_SCREEN_NAME,
+	ADIUM_KEYWORD_SENDER,
+	ADIUM_KEYWORD_SENDER_COLOR,
+	ADIUM_KEYWORD_MESSAGE,
+	ADIUM_KEYWORD_TIME,
+	ADIUM_KEYWORD_SHORT_TIME,
+	ADIUM_KEYWORD_SERVICE,
+	ADIUM_KEYWORD_USER_ICONS,
+	ADIUM_KEYWORD_MESSAGE_CLASSES,
+} AdiumKeyword;
+
+typedef struct {
+	AdiumKeyword keyword;
+	/* ADIUM_KEYWORD_LITERAL: position of the already escaped text in
+	 * AdiumTemplate->literals */
+	gsize offset;
+	gsize len;
+	/* ADIUM_KEYWORD_TIME: strftime format, or NULL for the default one.
+	 * Owned by EmpathyAdiumData->date_format_cache */
+	const gchar *format;
+} AdiumToken;
+
+typedef struct {
+	/* All literal segments, escaped for use in a javascript string */
+	gchar *literals;
+	gsize literals_len;
+	/* Array of AdiumToken */
+	GArray *tokens;
+} AdiumTemplate;
+
 struct _EmpathyAdiumData {
 	gint  ref_count;
 	gchar *path;
@@ -106,6 +150,22 @@ struct _EmpathyAdiumData {
 	 * We do this because of fallbacks, some htmls could be pointing the
 	 * same string. */
 	GPtrArray *strings_to_free;
+
+	/* Message templates compiled from the html bits, so appending a
+	 * message does not have to scan for keywords */
+	const AdiumTemplate *in_content_tmpl;
+	const AdiumTemplate *in_context_tmpl;
+	const AdiumTemplate *in_nextcontent_tmpl;
+	const AdiumTemplate *in_nextcontext_tmpl;
+	const AdiumTemplate *out_content_tmpl;
+	const AdiumTemplate *out_context_tmpl;
+	const AdiumTemplate *out_nextcontent_tmpl;
+	const AdiumTemplate *out_nextcontext_tmpl;
+	const AdiumTemplate *status_tmpl;
+
+	/* Same as strings_to_free, htmls sharing the same string share the
+	 * same compiled template. */
+	GPtrArray *templates_to_free;
 };
 
 static void theme_adium_iface_init (EmpathyChatViewIface *iface);
@@ -269,18 +329,14 @@ theme_adium_parse_body (EmpathyThemeAdium *self,
 	const gchar *token)
 {
 	EmpathyThemeAdiumPriv *priv = GET_PRIV (self);
-	EmpathyStringParser *parsers;
 	GString *string;
 
-	/* Check if we have to parse smileys */
-	parsers = empathy_webkit_get_string_parser (
-		g_settings_get_boolean (priv->gsettings_chat,
-			EMPATHY_PREFS_CHAT_SHOW_SMILEYS));
+	string = g_string_sized_new (strlen (text) + 128);
 
-	/* Parse text and construct string with links and smileys replaced
-	 * by html tags. Also escape text to make sure html code is
-	 * displayed verbatim. */
-	string = g_string_sized_new (strlen (text));
+	/* Wrap body in order to make tabs and multiple spaces displayed
+	 * properly. See bug #625745. */
+	g_string_append (string, "<div style=\"display: inline; "
+					       "white-space: pre-wrap\"'>");
 
 	/* wrap this in HTML that allows us to find the message for later
 	 * editing */
@@ -289,15 +345,17 @@ theme_adium_parse_body (EmpathyThemeAdium *self,
 			"<span id=\"message-token-%s\">",
 			token);
 
-	empathy_string_parser_substr (text, -1, parsers, string);
+	/* Parse text and construct string with links and smileys replaced
+	 * by html tags. Also escape text to make sure html code is
+	 * displayed verbatim. */
+	empathy_webkit_parse_text (text, -1,
+		g_settings_get_boolean (priv->gsettings_chat,
+			EMPATHY_PREFS_CHAT_SHOW_SMILEYS),
+		string);
 
 	if (!tp_str_empty (token))
 		g_string_append (string, "</span>");
 
-	/* Wrap body in order to make tabs and multiple spaces displayed
-	 * properly. See bug #625745. */
-	g_string_prepend (string, "<div style=\"display: inline; "
-					       "white-space: pre-wrap\"'>");
 	g_string_append (string, "</div>");
 
 	return g_string_free (string, FALSE);
@@ -531,56 +589,116 @@ nsdate_to_strftime (EmpathyAdiumData *data, const gchar *nsdate)
 
 
 static void
-theme_adium_append_html (EmpathyThemeAdium *theme,
-			 const gchar       *func,
-			 const gchar       *html,
-		         const gchar       *message,
-		         const gchar       *avatar_filename,
-		         const gchar       *name,
-		         const gchar       *contact_id,
-		         const gchar       *service_name,
-		         const gchar       *message_classes,
-		         gint64             timestamp,
-		         gboolean           is_backlog,
-		         gboolean           outgoing)
+theme_adium_flush_pending_script (EmpathyThemeAdium *theme)
 {
 	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
-	GString     *string;
-	const gchar *cur = NULL;
-	gchar       *script;
+	GString               *string;
+	gchar                 *script;
 
-	/* Make some search-and-replace in the html code */
-	string = g_string_sized_new (strlen (html) + strlen (message));
-	g_string_append_printf (string, "%s(\"", func);
-	for (cur = html; *cur != '\0'; cur++) {
-		const gchar *replace = NULL;
-		gchar       *dup_replace = NULL;
-		gchar       *format = NULL;
+	if (priv->pending_script_id != 0) {
+		g_source_remove (priv->pending_script_id);
+		priv->pending_script_id = 0;
+	}
+
+	if (priv->pending_script == NULL) {
+		return;
+	}
+
+	/* Decide once whether to scroll, append everything and only then
+	 * align the chat, so webkit has a single layout to do. */
+	string = priv->pending_script;
+	priv->pending_script = NULL;
+	g_string_prepend (string, priv->allow_scrolling ?
+		"(function () { var shouldScroll = nearBottom();" :
+		"(function () { var shouldScroll = false;");
+	g_string_append (string, "alignChat(shouldScroll); })();");
+
+	script = g_string_free (string, FALSE);
+	webkit_web_view_execute_script (WEBKIT_WEB_VIEW (theme), script);
+	g_free (script);
+}
+
+static gboolean
+theme_adium_flush_pending_script_cb (gpointer user_data)
+{
+	EmpathyThemeAdium     *theme = user_data;
+	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
+
+	priv->pending_script_id = 0;
+	theme_adium_flush_pending_script (theme);
+
+	return FALSE;
+}
+
+static void
+theme_adium_discard_pending_script (EmpathyThemeAdium *theme)
+{
+	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
+
+	if (priv->pending_script_id != 0) {
+		g_source_remove (priv->pending_script_id);
+		priv->pending_script_id = 0;
+	}
+
+	if (priv->pending_script != NULL) {
+		g_string_free (priv->pending_script, TRUE);
+		priv->pending_script = NULL;
+	}
+}
+
+static void
+adium_template_add_literal (AdiumTemplate *tmpl,
+			    GString       *literals,
+			    gsize         *literal_start)
+{
+	AdiumToken token = { ADIUM_KEYWORD_LITERAL, 0, 0, NULL };
+
+	if (literals->len == *literal_start) {
+		return;
+	}
+
+	token.offset = *literal_start;
+	token.len = literals->len - *literal_start;
+	g_array_append_val (tmpl->tokens, token);
+
+	*literal_start = literals->len;
+}
+
+/* Split html into escaped literal segments and keyword slots, so that
+ * appending a message only has to copy literals and fill in the slots. */
+static AdiumTemplate *
+adium_template_compile (EmpathyAdiumData *data,
+			const gchar      *html)
+{
+	AdiumTemplate *tmpl;
+	GString       *literals;
+	gsize          literal_start = 0;
+	const gchar   *cur;
+
+	tmpl = g_slice_new0 (AdiumTemplate);
+	tmpl->tokens = g_array_new (FALSE, FALSE, sizeof (AdiumToken));
+	literals = g_string_sized_new (html != NULL ? strlen (html) : 0);
+
+	for (cur = html; cur != NULL && *cur != '\0'; cur++) {
+		AdiumToken token = { ADIUM_KEYWORD_NONE, 0, 0, NULL };
+		gchar     *format = NULL;
 
 		/* Those are all well known keywords that needs replacement in
 		 * html files. Please keep them in the same order than the adium
 		 * spec. See http://trac.adium.im/wiki/CreatingMessageStyles */
 		if (theme_adium_match (&cur, "%userIconPath%")) {
-			replace = avatar_filename;
+			token.keyword = ADIUM_KEYWORD_USER_ICON_PATH;
 		} else if (theme_adium_match (&cur, "%senderScreenName%")) {
-			replace = contact_id;
+			token.keyword = ADIUM_KEYWORD_SENDER_SCREEN_NAME;
 		} else if (theme_adium_match (&cur, "%sender%")) {
-			replace = name;
+			token.keyword = ADIUM_KEYWORD_SENDER;
 		} else if (theme_adium_match (&cur, "%senderColor%")) {
 			/* A color derived from the user's name.
 			 * FIXME: If a colon separated list of HTML colors is at
 			 * Incoming/SenderColors.txt it will be used instead of
 			 * the default colors.
 			 */
-
-			/* Ensure we always use the same color when sending messages
-			 * (bgo #658821) */
-			if (outgoing) {
-				replace = "inherit";
-			} else if (contact_id != NULL) {
-				guint hash = g_str_hash (contact_id);
-				replace = colors[hash % G_N_ELEMENTS (colors)];
-			}
+			token.keyword = ADIUM_KEYWORD_SENDER_COLOR;
 		} else if (theme_adium_match (&cur, "%senderStatusIcon%")) {
 			/* FIXME: The path to the status icon of the sender
 			 * (available, away, etc...)
@@ -596,7 +714,7 @@ theme_adium_append_html (EmpathyThemeAdium *theme,
 			 *  We don't have access to that yet so we use
 			 * local alias instead.
 			 */
-			replace = name;
+			token.keyword = ADIUM_KEYWORD_SENDER;
 		} else if (theme_adium_match_with_format (&cur, "%textbackgroundcolor{", &format)) {
 			/* FIXME: This keyword is used to represent the
 			 * highlight background color. "X" is the opacity of the
@@ -604,28 +722,15 @@ theme_adium_append_html (EmpathyThemeAdium *theme,
 			 * between.
 			 */
 		} else if (theme_adium_match (&cur, "%message%")) {
-			replace = message;
+			token.keyword = ADIUM_KEYWORD_MESSAGE;
 		} else if (theme_adium_match (&cur, "%time%") ||
 			   theme_adium_match_with_format (&cur, "%time{", &format)) {
-			const gchar *strftime_format;
-
-			strftime_format = nsdate_to_strftime (priv->data, format);
-			if (is_backlog) {
-				dup_replace = empathy_time_to_string_local (timestamp,
-					strftime_format ? strftime_format :
-					EMPATHY_TIME_DATE_FORMAT_DISPLAY_SHORT);
-			} else {
-				dup_replace = empathy_time_to_string_local (timestamp,
-					strftime_format ? strftime_format :
-					EMPATHY_TIME_FORMAT_DISPLAY_SHORT);
-			}
-			replace = dup_replace;
+			token.keyword = ADIUM_KEYWORD_TIME;
+			token.format = nsdate_to_strftime (data, format);
 		} else if (theme_adium_match (&cur, "%shortTime%")) {
-			dup_replace = empathy_time_to_string_local (timestamp,
-				EMPATHY_TIME_FORMAT_DISPLAY_SHORT);
-			replace = dup_replace;
+			token.keyword = ADIUM_KEYWORD_SHORT_TIME;
 		} else if (theme_adium_match (&cur, "%service%")) {
-			replace = service_name;
+			token.keyword = ADIUM_KEYWORD_SERVICE;
 		} else if (theme_adium_match (&cur, "%variant%")) {
 			/* FIXME: The name of the active message style variant,
 			 * with all spaces replaced with an underscore.
@@ -633,11 +738,9 @@ theme_adium_append_html (EmpathyThemeAdium *theme,
 			 * will become "Alternating_Messages_-_Blue_Red".
 			 */
 		} else if (theme_adium_match (&cur, "%userIcons%")) {
-			/* FIXME: mus t be "hideIcons" if use preference is set
-			 * to hide avatars */
-			replace = "showIcons";
+			token.keyword = ADIUM_KEYWORD_USER_ICONS;
 		} else if (theme_adium_match (&cur, "%messageClasses%")) {
-			replace = message_classes;
+			token.keyword = ADIUM_KEYWORD_MESSAGE_CLASSES;
 		} else if (theme_adium_match (&cur, "%status%")) {
 			/* FIXME: A description of the status event. This is
 			 * neither in the user's local language nor expected to
@@ -666,21 +769,138 @@ theme_adium_append_html (EmpathyThemeAdium *theme,
 			 *	fileTransferCompleted
 			 */
 		} else {
-			escape_and_append_len (string, cur, 1);
+			escape_and_append_len (literals, cur, 1);
 			continue;
 		}
 
-		/* Here we have a replacement to make */
-		escape_and_append_len (string, replace, -1);
+		/* Here we have a keyword, close the pending literal */
+		adium_template_add_literal (tmpl, literals, &literal_start);
+		if (token.keyword != ADIUM_KEYWORD_NONE) {
+			g_array_append_val (tmpl->tokens, token);
+		}
 
-		g_free (dup_replace);
 		g_free (format);
 	}
-	g_string_append (string, "\")");
+	adium_template_add_literal (tmpl, literals, &literal_start);
 
-	script = g_string_free (string, FALSE);
-	webkit_web_view_execute_script (WEBKIT_WEB_VIEW (theme), script);
-	g_free (script);
+	tmpl->literals_len = literals->len;
+	tmpl->literals = g_string_free (literals, FALSE);
+
+	return tmpl;
+}
+
+static void
+adium_template_free (AdiumTemplate *tmpl)
+{
+	g_free (tmpl->literals);
+	g_array_unref (tmpl->tokens);
+
+	g_slice_free (AdiumTemplate, tmpl);
+}
+
+static void
+theme_adium_append_html (EmpathyThemeAdium   *theme,
+			 const gchar         *func,
+			 const AdiumTemplate *tmpl,
+		         const gchar         *message,
+		         const gchar         *avatar_filename,
+		         const gchar         *name,
+		         const gchar         *contact_id,
+		         const gchar         *service_name,
+		         const gchar         *message_classes,
+		         gint64               timestamp,
+		         gboolean             is_backlog,
+		         gboolean             outgoing)
+{
+	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
+	GString     *string;
+	guint        i;
+
+	/* Fill the template's keyword slots. The call is queued and sent to
+	 * webkit along with other messages of the same frame or batch. */
+	if (priv->pending_script == NULL) {
+		priv->pending_script = g_string_sized_new (
+			tmpl->literals_len + strlen (message) + 128);
+	}
+	string = priv->pending_script;
+	g_string_append_printf (string, "%s(\"", func);
+	for (i = 0; i < tmpl->tokens->len; i++) {
+		const AdiumToken *token;
+		const gchar      *replace = NULL;
+		gchar            *dup_replace = NULL;
+
+		token = &g_array_index (tmpl->tokens, AdiumToken, i);
+
+		switch (token->keyword) {
+		case ADIUM_KEYWORD_LITERAL:
+			/* Literals are escaped at compile time */
+			g_string_append_len (string,
+				tmpl->literals + token->offset, token->len);
+			continue;
+		case ADIUM_KEYWORD_USER_ICON_PATH:
+			replace = avatar_filename;
+			break;
+		case ADIUM_KEYWORD_SENDER_SCREEN_NAME:
+			replace = contact_id;
+			break;
+		case ADIUM_KEYWORD_SENDER:
+			replace = name;
+			break;
+		case ADIUM_KEYWORD_SENDER_COLOR:
+			/* Ensure we always use the same color when sending messages
+			 * (bgo #658821) */
+			if (outgoing) {
+				replace = "inherit";
+			} else if (contact_id != NULL) {
+				guint hash = g_str_hash (contact_id);
+				replace = colors[hash % G_N_ELEMENTS (colors)];
+			}
+			break;
+		case ADIUM_KEYWORD_MESSAGE:
+			replace = message;
+			break;
+		case ADIUM_KEYWORD_TIME:
+			if (is_backlog) {
+				dup_replace = empathy_time_to_string_local (timestamp,
+					token->format ? token->format :
+					EMPATHY_TIME_DATE_FORMAT_DISPLAY_SHORT);
+			} else {
+				dup_replace = empathy_time_to_string_local (timestamp,
+					token->format ? token->format :
+					EMPATHY_TIME_FORMAT_DISPLAY_SHORT);
+			}
+			replace = dup_replace;
+			break;
+		case ADIUM_KEYWORD_SHORT_TIME:
+			dup_replace = empathy_time_to_string_local (timestamp,
+				EMPATHY_TIME_FORMAT_DISPLAY_SHORT);
+			replace = dup_replace;
+			break;
+		case ADIUM_KEYWORD_SERVICE:
+			replace = service_name;
+			break;
+		case ADIUM_KEYWORD_USER_ICONS:
+			/* FIXME: mus t be "hideIcons" if use preference is set
+			 * to hide avatars */
+			replace = "showIcons";
+			break;
+		case ADIUM_KEYWORD_MESSAGE_CLASSES:
+			replace = message_classes;
+			break;
+		case ADIUM_KEYWORD_NONE:
+		default:
+			break;
+		}
+
+		escape_and_append_len (string, replace, -1);
+		g_free (dup_replace);
+	}
+	g_string_append (string, "\", shouldScroll);");
+
+	if (priv->batch_depth == 0 && priv->pending_script_id == 0) {
+		priv->pending_script_id = g_timeout_add (APPEND_FRAME_INTERVAL,
+			theme_adium_flush_pending_script_cb, theme);
+	}
 }
 
 static void
@@ -690,8 +910,8 @@ theme_adium_append_event_escaped (EmpathyChatView *view,
 	EmpathyThemeAdium     *theme = EMPATHY_THEME_ADIUM (view);
 	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
 
-	theme_adium_append_html (theme, "appendMessage",
-				 priv->data->status_html, escaped, NULL, NULL, NULL,
+	theme_adium_append_html (theme, "appendMessageNoScroll",
+				 priv->data->status_tmpl, escaped, NULL, NULL, NULL,
 				 NULL, "event",
 				 empathy_time_get_current (), FALSE, FALSE);
 
@@ -756,6 +976,9 @@ theme_adium_remove_all_focus_marks (EmpathyThemeAdium *theme)
 
 	priv->has_unread_message = FALSE;
 
+	/* Marked messages could still be waiting to be added to the DOM */
+	theme_adium_flush_pending_script (theme);
+
 	dom = webkit_web_view_get_dom_document (WEBKIT_WEB_VIEW (theme));
 	if (dom == NULL) {
 		return;
@@ -788,7 +1011,7 @@ theme_adium_append_message (EmpathyChatView *view,
 	EmpathyAvatar         *avatar;
 	const gchar           *avatar_filename = NULL;
 	gint64                 timestamp;
-	const gchar           *html = NULL;
+	const AdiumTemplate   *tmpl = NULL;
 	const gchar           *func;
 	const gchar           *service_name;
 	GString               *message_classes = NULL;
@@ -919,21 +1142,22 @@ theme_adium_append_message (EmpathyChatView *view,
 		}
 	}
 
-	/* Define javascript function to use */
+	/* Define javascript function to use, scrolling is done once the
+	 * pending script is flushed */
 	if (consecutive) {
-		func = priv->allow_scrolling ? "appendNextMessage" : "appendNextMessageNoScroll";
+		func = "appendNextMessageNoScroll";
 	} else {
-		func = priv->allow_scrolling ? "appendMessage" : "appendMessageNoScroll";
+		func = "appendMessageNoScroll";
 	}
 
 	if (empathy_contact_is_user (sender)) {
 		/* out */
 		if (is_backlog) {
 			/* context */
-			html = consecutive ? priv->data->out_nextcontext_html : priv->data->out_context_html;
+			tmpl = consecutive ? priv->data->out_nextcontext_tmpl : priv->data->out_context_tmpl;
 		} else {
 			/* content */
-			html = consecutive ? priv->data->out_nextcontent_html : priv->data->out_content_html;
+			tmpl = consecutive ? priv->data->out_nextcontent_tmpl : priv->data->out_content_tmpl;
 		}
 
 		/* remove all the unread marks when we are sending a message */
@@ -942,14 +1166,14 @@ theme_adium_append_message (EmpathyChatView *view,
 		/* in */
 		if (is_backlog) {
 			/* context */
-			html = consecutive ? priv->data->in_nextcontext_html : priv->data->in_context_html;
+			tmpl = consecutive ? priv->data->in_nextcontext_tmpl : priv->data->in_context_tmpl;
 		} else {
 			/* content */
-			html = consecutive ? priv->data->in_nextcontent_html : priv->data->in_content_html;
+			tmpl = consecutive ? priv->data->in_nextcontent_tmpl : priv->data->in_content_tmpl;
 		}
 	}
 
-	theme_adium_append_html (theme, func, html, body_escaped,
+	theme_adium_append_html (theme, func, tmpl, body_escaped,
 				 avatar_filename, name_escaped, contact_id,
 				 service_name, message_classes->str,
 				 timestamp, is_backlog, empathy_contact_is_user (sender));
@@ -1009,6 +1233,9 @@ theme_adium_edit_message (EmpathyChatView *view,
 		return;
 	}
 
+	/* The edited message could still be waiting to be added to the DOM */
+	theme_adium_flush_pending_script (EMPATHY_THEME_ADIUM (view));
+
 	id = g_strdup_printf ("message-token-%s",
 		empathy_message_get_supersedes (message));
 	/* we don't pass a token here, because doing so will return another
@@ -1105,6 +1332,7 @@ theme_adium_scroll (EmpathyChatView *view,
 static void
 theme_adium_scroll_down (EmpathyChatView *view)
 {
+	theme_adium_flush_pending_script (EMPATHY_THEME_ADIUM (view));
 	webkit_web_view_execute_script (WEBKIT_WEB_VIEW (view), "alignChat(true);");
 }
 
@@ -1119,6 +1347,7 @@ theme_adium_clear (EmpathyChatView *view)
 {
 	EmpathyThemeAdiumPriv *priv = GET_PRIV (view);
 
+	theme_adium_discard_pending_script (EMPATHY_THEME_ADIUM (view));
 	theme_adium_load_template (EMPATHY_THEME_ADIUM (view));
 
 	/* Clear last contact to avoid trying to add a 'joined'
@@ -1135,6 +1364,8 @@ theme_adium_find_previous (EmpathyChatView *view,
 			   gboolean         new_search,
 			   gboolean         match_case)
 {
+	theme_adium_flush_pending_script (EMPATHY_THEME_ADIUM (view));
+
 	/* FIXME: Doesn't respect new_search */
 	return webkit_web_view_search_text (WEBKIT_WEB_VIEW (view),
 					    search_criteria, match_case,
@@ -1147,6 +1378,8 @@ theme_adium_find_next (EmpathyChatView *view,
 		       gboolean         new_search,
 		       gboolean         match_case)
 {
+	theme_adium_flush_pending_script (EMPATHY_THEME_ADIUM (view));
+
 	/* FIXME: Doesn't respect new_search */
 	return webkit_web_view_search_text (WEBKIT_WEB_VIEW (view),
 					    search_criteria, match_case,
@@ -1173,6 +1406,8 @@ theme_adium_highlight (EmpathyChatView *view,
 		       const gchar     *text,
 		       gboolean         match_case)
 {
+	theme_adium_flush_pending_script (EMPATHY_THEME_ADIUM (view));
+
 	webkit_web_view_unmark_text_matches (WEBKIT_WEB_VIEW (view));
 	webkit_web_view_mark_text_matches (WEBKIT_WEB_VIEW (view),
 					   text, match_case, 0);
@@ -1200,6 +1435,8 @@ theme_adium_remove_mark_from_message (EmpathyThemeAdium *self,
 		return;
 	}
 
+	theme_adium_flush_pending_script (self);
+
 	class = g_strdup_printf (".x-empathy-message-id-%u", id);
 
 	/* Get all nodes with focus class */
@@ -1280,6 +1517,27 @@ theme_adium_message_acknowledged (EmpathyChatView *view,
 	theme_adium_remove_mark_from_message (self, id);
 }
 
+static void
+theme_adium_begin_batch (EmpathyChatView *view)
+{
+	EmpathyThemeAdiumPriv *priv = GET_PRIV (view);
+
+	priv->batch_depth++;
+}
+
+static void
+theme_adium_end_batch (EmpathyChatView *view)
+{
+	EmpathyThemeAdiumPriv *priv = GET_PRIV (view);
+
+	g_return_if_fail (priv->batch_depth > 0);
+
+	priv->batch_depth--;
+	if (priv->batch_depth == 0) {
+		theme_adium_flush_pending_script (EMPATHY_THEME_ADIUM (view));
+	}
+}
+
 static gboolean
 theme_adium_button_press_event (GtkWidget *widget, GdkEventButton *event)
 {
@@ -1321,6 +1579,8 @@ theme_adium_iface_init (EmpathyChatViewIface *iface)
 	iface->copy_clipboard = theme_adium_copy_clipboard;
 	iface->focus_toggled = theme_adium_focus_toggled;
 	iface->message_acknowledged = theme_adium_message_acknowledged;
+	iface->begin_batch = theme_adium_begin_batch;
+	iface->end_batch = theme_adium_end_batch;
 }
 
 static void
@@ -1339,6 +1599,7 @@ theme_adium_load_finished_cb (WebKitWebView  *view,
 		return;
 
 	/* Display queued messages */
+	theme_adium_begin_batch (chat_view);
 	for (l = priv->message_queue.head; l != NULL; l = l->next) {
 		QueuedItem *item = l->data;
 
@@ -1359,6 +1620,7 @@ theme_adium_load_finished_cb (WebKitWebView  *view,
 
 		free_queued_item (item);
 	}
+	theme_adium_end_batch (chat_view);
 
 	g_queue_clear (&priv->message_queue);
 }
@@ -1400,6 +1662,8 @@ theme_adium_dispose (GObject *object)
 		g_queue_clear (&priv->acked_messages);
 	}
 
+	theme_adium_discard_pending_script (EMPATHY_THEME_ADIUM (object));
+
 	G_OBJECT_CLASS (empathy_theme_adium_parent_class)->dispose (object);
 }
 
@@ -1864,6 +2128,7 @@ empathy_adium_data_new_with_info (const gchar *path, GHashTable *info)
 	gchar            *template_html = NULL;
 	gchar            *footer_html = NULL;
 	gchar            *tmp;
+	GHashTable       *compiled;
 
 	g_return_val_if_fail (empathy_adium_path_is_valid (path), NULL);
 
@@ -1875,6 +2140,8 @@ empathy_adium_data_new_with_info (const gchar *path, GHashTable *info)
 	data->info = g_hash_table_ref (info);
 	data->version = adium_info_get_version (info);
 	data->strings_to_free = g_ptr_array_new_with_free_func (g_free);
+	data->templates_to_free = g_ptr_array_new_with_free_func (
+		(GDestroyNotify) adium_template_free);
 	data->date_format_cache = g_hash_table_new_full (g_str_hash,
 		g_str_equal, g_free, g_free);
 
@@ -1941,6 +2208,38 @@ empathy_adium_data_new_with_info (const gchar *path, GHashTable *info)
 
 #undef FALLBACK
 
+	/* Compile message templates, htmls sharing a string share the
+	 * compiled template too */
+	compiled = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+#define COMPILE(html, tmpl) \
+	{ \
+		AdiumTemplate *compiled_tmpl; \
+		compiled_tmpl = g_hash_table_lookup (compiled, html); \
+		if (compiled_tmpl == NULL) { \
+			compiled_tmpl = adium_template_compile (data, html); \
+			g_hash_table_insert (compiled, (gpointer) html, \
+				compiled_tmpl); \
+			g_ptr_array_add (data->templates_to_free, \
+				compiled_tmpl); \
+		} \
+		tmpl = compiled_tmpl; \
+	}
+
+	COMPILE (data->in_content_html,      data->in_content_tmpl);
+	COMPILE (data->in_nextcontent_html,  data->in_nextcontent_tmpl);
+	COMPILE (data->in_context_html,      data->in_context_tmpl);
+	COMPILE (data->in_nextcontext_html,  data->in_nextcontext_tmpl);
+	COMPILE (data->out_content_html,     data->out_content_tmpl);
+	COMPILE (data->out_nextcontent_html, data->out_nextcontent_tmpl);
+	COMPILE (data->out_context_html,     data->out_context_tmpl);
+	COMPILE (data->out_nextcontext_html, data->out_nextcontext_tmpl);
+	COMPILE (data->status_html,          data->status_tmpl);
+
+#undef COMPILE
+
+	g_hash_table_unref (compiled);
+
 	/* template -> empathy's template */
 	data->custom_template = (template_html != NULL);
 	if (template_html == NULL) {
@@ -2034,6 +2333,7 @@ empathy_adium_data_unref (EmpathyAdiumData *data)
 		g_free (data->default_outgoing_avatar_filename);
 		g_hash_table_unref (data->info);
 		g_ptr_array_unref (data->strings_to_free);
+		g_ptr_array_unref (data->templates_to_free);
 		tp_clear_pointer (&data->date_format_cache, g_hash_table_unref);
 
 		g_slice_free (EmpathyAdiumData, data);
@@ -45,6 +45,7 @@
 #include "empathy-ui-utils.h"
 #include "empathy-images.h"
 #include "empathy-live-search.h"
+#include "empathy-pixbuf-cache.h"
 #include "empathy-smiley-manager.h"
 
 #define DEBUG_FLAG EMPATHY_DEBUG_OTHER
@@ -481,6 +482,16 @@ empathy_pixbuf_from_avatar_scaled (EmpathyAvatar *avatar,
 		return NULL;
 	}
 
+	/* Avatar files are named after their token */
+	if (avatar->filename != NULL) {
+		pixbuf = empathy_pixbuf_cache_lookup (
+			empathy_pixbuf_cache_get_avatars (),
+			avatar->filename, width, height);
+		if (pixbuf != NULL) {
+			return pixbuf;
+		}
+	}
+
 	data.width = width;
 	data.height = height;
 	data.preserve_aspect_ratio = TRUE;
@@ -507,6 +518,11 @@ empathy_pixbuf_from_avatar_scaled (EmpathyAvatar *avatar,
 
 	g_object_unref (loader);
 
+	if (avatar->filename != NULL) {
+		empathy_pixbuf_cache_insert (empathy_pixbuf_cache_get_avatars (),
+			avatar->filename, width, height, pixbuf);
+	}
+
 	return pixbuf;
 }
 
@@ -532,6 +548,9 @@ typedef struct {
 	struct SizeData size_data;
 	GdkPixbufLoader *loader;
 	GCancellable *cancellable;
+	GLoadableIcon *icon;
+	/* Key of the avatar in the pixbuf cache, or NULL */
+	gchar *cache_id;
 	guint8 data[512];
 } PixbufAvatarFromIndividualClosure;
 
@@ -540,6 +559,7 @@ pixbuf_avatar_from_individual_closure_new (FolksIndividual    *individual,
 					   GSimpleAsyncResult *result,
 					   gint                width,
 					   gint                height,
+					   GLoadableIcon      *icon,
 					   GCancellable       *cancellable)
 {
 	PixbufAvatarFromIndividualClosure *closure;
@@ -552,6 +572,7 @@ pixbuf_avatar_from_individual_closure_new (FolksIndividual    *individual,
 	closure->result = g_object_ref (result);
 	closure->width = width;
 	closure->height = height;
+	closure->icon = g_object_ref (icon);
 	if (cancellable != NULL)
 		closure->cancellable = g_object_ref (cancellable);
 
@@ -564,8 +585,10 @@ pixbuf_avatar_from_individual_closure_free (
 {
 	g_clear_object (&closure->cancellable);
 	tp_clear_object (&closure->loader);
+	g_object_unref (closure->icon);
 	g_object_unref (closure->individual);
 	g_object_unref (closure->result);
+	g_free (closure->cache_id);
 	g_free (closure);
 }
 
@@ -591,6 +614,7 @@ avatar_icon_load_read_cb (GObject      *object,
 {
 	GInputStream *stream = G_INPUT_STREAM (object);
 	PixbufAvatarFromIndividualClosure *closure = user_data;
+	GdkPixbuf *pixbuf;
 	gssize n_read;
 	GError *error = NULL;
 
@@ -622,9 +646,16 @@ avatar_icon_load_read_cb (GObject      *object,
 		}
 
 		/* We're done. */
+		pixbuf = avatar_pixbuf_from_loader (closure->loader);
 		g_simple_async_result_set_op_res_gpointer (closure->result,
-			avatar_pixbuf_from_loader (closure->loader),
-			g_object_unref);
+			pixbuf, g_object_unref);
+
+		if (closure->cache_id != NULL) {
+			empathy_pixbuf_cache_insert (
+				empathy_pixbuf_cache_get_avatars (),
+				closure->cache_id, closure->width,
+				closure->height, pixbuf);
+		}
 
 		goto out;
 	} else {
@@ -699,6 +730,49 @@ out:
 	pixbuf_avatar_from_individual_closure_free (closure);
 }
 
+static void
+avatar_icon_query_info_cb (GObject      *object,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+	GFile *file = G_FILE (object);
+	PixbufAvatarFromIndividualClosure *closure = user_data;
+	GFileInfo *info;
+	GdkPixbuf *pixbuf;
+	GError *error = NULL;
+
+	info = g_file_query_info_finish (file, result, &error);
+	if (info == NULL) {
+		/* Still load it, it just won't be cached */
+		DEBUG ("Failed to query avatar file: %s", error->message);
+		g_error_free (error);
+	} else if (g_file_info_get_etag (info) != NULL) {
+		gchar *uri = g_file_get_uri (file);
+
+		closure->cache_id = g_strdup_printf ("%s#%s", uri,
+			g_file_info_get_etag (info));
+		g_free (uri);
+
+		pixbuf = empathy_pixbuf_cache_lookup (
+			empathy_pixbuf_cache_get_avatars (),
+			closure->cache_id, closure->width, closure->height);
+		if (pixbuf != NULL) {
+			g_simple_async_result_set_op_res_gpointer (
+				closure->result, pixbuf, g_object_unref);
+			g_simple_async_result_complete (closure->result);
+
+			g_object_unref (info);
+			pixbuf_avatar_from_individual_closure_free (closure);
+			return;
+		}
+	}
+
+	tp_clear_object (&info);
+
+	g_loadable_icon_load_async (closure->icon, closure->width,
+			closure->cancellable, avatar_icon_load_cb, closure);
+}
+
 void
 empathy_pixbuf_avatar_from_individual_scaled_async (
 		FolksIndividual     *individual,
@@ -729,12 +803,25 @@ empathy_pixbuf_avatar_from_individual_scaled_async (
 
 	closure = pixbuf_avatar_from_individual_closure_new (individual, result,
 							     width, height,
+							     avatar_icon,
 							     cancellable);
 
 	g_return_if_fail (closure != NULL);
 
-	g_loadable_icon_load_async (avatar_icon, width, cancellable,
-			avatar_icon_load_cb, closure);
+	/* Avatar files aren't named after their token: folks names them after
+	 * the persona and EDS overwrites contact photos in place. The file's
+	 * etag is part of the cache key so changed avatars aren't served
+	 * from the cache. */
+	if (G_IS_FILE_ICON (avatar_icon)) {
+		g_file_query_info_async (
+			g_file_icon_get_file (G_FILE_ICON (avatar_icon)),
+			G_FILE_ATTRIBUTE_ETAG_VALUE, G_FILE_QUERY_INFO_NONE,
+			G_PRIORITY_DEFAULT, cancellable,
+			avatar_icon_query_info_cb, closure);
+	} else {
+		g_loadable_icon_load_async (avatar_icon, width, cancellable,
+				avatar_icon_load_cb, closure);
+	}
 
 	g_object_unref (result);
 }
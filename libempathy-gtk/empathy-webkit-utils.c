@@ -97,6 +97,18 @@ empathy_webkit_get_string_parser (gboolean smileys)
     return string_parsers;
 }
 
+/* Same result as parsing text with empathy_webkit_get_string_parser(), but
+ * in a single pass over the text */
+void
+empathy_webkit_parse_text (const gchar *text,
+    gssize len,
+    gboolean smileys,
+    GString *string)
+{
+  empathy_string_parser_fused (text, len, empathy_string_replace_link,
+      smileys ? empathy_webkit_replace_smiley : NULL, "<br/>", string);
+}
+
 static gboolean
 webkit_get_font_family (GValue *value,
     GVariant *variant,
@@ -32,6 +32,8 @@ typedef enum {
 } EmpathyWebKitMenuFlags;
 
 EmpathyStringParser *empathy_webkit_get_string_parser (gboolean smileys);
+void empathy_webkit_parse_text (const gchar *text, gssize len,
+    gboolean smileys, GString *string);
 void empathy_webkit_bind_font_setting (WebKitWebView *webview,
     GSettings *gsettings, const char *key);
 void empathy_webkit_context_menu_for_event (WebKitWebView *view,
@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <gio/gio.h>
+
+#include "empathy-avatar-loader.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_CONTACT
+#include "empathy-debug.h"
+
+/* Reading thousands of avatars at once would only make them queue in GIO's
+ * thread pool and delay the other I/O of the process */
+#define MAX_READS 8
+
+struct _EmpathyAvatarLoaderPrivate
+{
+  /* filename -> owned Request */
+  GHashTable *requests;
+  /* Requests waiting for a read slot */
+  GQueue *queued;
+  /* Requests read, waiting to be delivered */
+  GQueue *done;
+  guint n_reads;
+  guint flush_id;
+};
+
+typedef struct
+{
+  /* weak */
+  GObject *object;
+  EmpathyAvatarLoaderFunc callback;
+  gpointer user_data;
+} Waiter;
+
+typedef struct
+{
+  /* Keeps the loader alive until the request is delivered */
+  EmpathyAvatarLoader *self;
+  gchar *filename;
+  gchar *format;
+  /* reversed list of owned Waiter */
+  GSList *waiters;
+  EmpathyAvatar *avatar;
+} Request;
+
+G_DEFINE_TYPE (EmpathyAvatarLoader, empathy_avatar_loader, G_TYPE_OBJECT);
+
+static EmpathyAvatarLoader *loader_singleton = NULL;
+
+static void
+waiter_object_gone_cb (gpointer data,
+    GObject *where_the_object_was)
+{
+  Waiter *waiter = data;
+
+  waiter->object = NULL;
+}
+
+static void
+request_free (Request *request)
+{
+  GSList *l;
+
+  for (l = request->waiters; l != NULL; l = l->next)
+    {
+      Waiter *waiter = l->data;
+
+      if (waiter->object != NULL)
+        g_object_weak_unref (waiter->object, waiter_object_gone_cb, waiter);
+
+      g_slice_free (Waiter, waiter);
+    }
+
+  g_slist_free (request->waiters);
+
+  if (request->avatar != NULL)
+    empathy_avatar_unref (request->avatar);
+
+  g_free (request->filename);
+  g_free (request->format);
+  g_object_unref (request->self);
+  g_slice_free (Request, request);
+}
+
+static void
+request_deliver (Request *request)
+{
+  GSList *l;
+
+  request->waiters = g_slist_reverse (request->waiters);
+
+  for (l = request->waiters; l != NULL; l = l->next)
+    {
+      Waiter *waiter = l->data;
+      GObject *object = waiter->object;
+
+      if (object == NULL)
+        continue;
+
+      g_object_weak_unref (object, waiter_object_gone_cb, waiter);
+      waiter->object = NULL;
+
+      waiter->callback (object, request->filename, request->avatar,
+          waiter->user_data);
+    }
+}
+
+static gboolean
+avatar_loader_flush_cb (gpointer user_data)
+{
+  EmpathyAvatarLoader *self = user_data;
+  Request *request;
+
+  /* Freeing the last request could finalize us */
+  g_object_ref (self);
+
+  self->priv->flush_id = 0;
+
+  while ((request = g_queue_pop_head (self->priv->done)) != NULL)
+    {
+      /* Waiters can ask for the same file again, that is a new request */
+      g_hash_table_remove (self->priv->requests, request->filename);
+
+      request_deliver (request);
+      request_free (request);
+    }
+
+  g_object_unref (self);
+
+  return FALSE;
+}
+
+static void avatar_loader_start_reads (EmpathyAvatarLoader *self);
+
+static void
+avatar_loader_read_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  Request *request = user_data;
+  EmpathyAvatarLoader *self = request->self;
+  gchar *data;
+  gsize len;
+  GError *error = NULL;
+
+  if (g_file_load_contents_finish (G_FILE (source), result, &data, &len,
+          NULL, &error))
+    {
+      DEBUG ("Avatar loaded from %s", request->filename);
+      request->avatar = empathy_avatar_new ((guchar *) data, len,
+          request->format, request->filename);
+      g_free (data);
+    }
+  else
+    {
+      DEBUG ("Failed to load avatar from %s: %s", request->filename,
+          error->message);
+      g_error_free (error);
+    }
+
+  self->priv->n_reads--;
+
+  /* Contacts get the avatars once the main loop is idle, so all the reads
+   * finished meanwhile are delivered together */
+  g_queue_push_tail (self->priv->done, request);
+  if (self->priv->flush_id == 0)
+    self->priv->flush_id = g_idle_add (avatar_loader_flush_cb, self);
+
+  avatar_loader_start_reads (self);
+}
+
+static void
+avatar_loader_start_reads (EmpathyAvatarLoader *self)
+{
+  while (self->priv->n_reads < MAX_READS &&
+      !g_queue_is_empty (self->priv->queued))
+    {
+      Request *request = g_queue_pop_head (self->priv->queued);
+      GFile *file;
+
+      file = g_file_new_for_path (request->filename);
+      g_file_load_contents_async (file, NULL, avatar_loader_read_cb,
+          request);
+      g_object_unref (file);
+
+      self->priv->n_reads++;
+    }
+}
+
+static void
+avatar_loader_finalize (GObject *object)
+{
+  EmpathyAvatarLoader *self = EMPATHY_AVATAR_LOADER (object);
+
+  /* Each request keeps us alive, so there are none left here */
+  g_hash_table_unref (self->priv->requests);
+  g_queue_free (self->priv->queued);
+  g_queue_free (self->priv->done);
+
+  G_OBJECT_CLASS (empathy_avatar_loader_parent_class)->finalize (object);
+}
+
+static void
+empathy_avatar_loader_class_init (EmpathyAvatarLoaderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = avatar_loader_finalize;
+
+  g_type_class_add_private (object_class,
+      sizeof (EmpathyAvatarLoaderPrivate));
+}
+
+static void
+empathy_avatar_loader_init (EmpathyAvatarLoader *self)
+{
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+      EMPATHY_TYPE_AVATAR_LOADER, EmpathyAvatarLoaderPrivate);
+
+  self->priv->requests = g_hash_table_new (g_str_hash, g_str_equal);
+  self->priv->queued = g_queue_new ();
+  self->priv->done = g_queue_new ();
+}
+
+EmpathyAvatarLoader *
+empathy_avatar_loader_dup_singleton (void)
+{
+  GObject *retval;
+
+  if (loader_singleton)
+    {
+      retval = g_object_ref (loader_singleton);
+    }
+  else
+    {
+      retval = g_object_new (EMPATHY_TYPE_AVATAR_LOADER, NULL);
+
+      loader_singleton = EMPATHY_AVATAR_LOADER (retval);
+      g_object_add_weak_pointer (retval, (gpointer) &loader_singleton);
+    }
+
+  return EMPATHY_AVATAR_LOADER (retval);
+}
+
+/**
+ * empathy_avatar_loader_load:
+ * @self: an #EmpathyAvatarLoader
+ * @filename: the file containing the avatar
+ * @format: the mime type of the avatar, or %NULL
+ * @object: the object the avatar is for
+ * @callback: called with the avatar, from the main loop
+ * @user_data: data passed to @callback
+ *
+ * Reads @filename without blocking. Objects asking for a file which is
+ * already being read share the same #EmpathyAvatar. @callback is not called
+ * if @object is finalized before the file is read.
+ */
+void
+empathy_avatar_loader_load (EmpathyAvatarLoader *self,
+    const gchar *filename,
+    const gchar *format,
+    GObject *object,
+    EmpathyAvatarLoaderFunc callback,
+    gpointer user_data)
+{
+  Request *request;
+  Waiter *waiter;
+
+  g_return_if_fail (EMPATHY_IS_AVATAR_LOADER (self));
+  g_return_if_fail (filename != NULL);
+  g_return_if_fail (G_IS_OBJECT (object));
+  g_return_if_fail (callback != NULL);
+
+  request = g_hash_table_lookup (self->priv->requests, filename);
+  if (request == NULL)
+    {
+      request = g_slice_new0 (Request);
+      request->self = g_object_ref (self);
+      request->filename = g_strdup (filename);
+      request->format = g_strdup (format);
+
+      g_hash_table_insert (self->priv->requests, request->filename, request);
+      g_queue_push_tail (self->priv->queued, request);
+
+      avatar_loader_start_reads (self);
+    }
+
+  waiter = g_slice_new (Waiter);
+  waiter->object = object;
+  waiter->callback = callback;
+  waiter->user_data = user_data;
+  g_object_weak_ref (object, waiter_object_gone_cb, waiter);
+
+  request->waiters = g_slist_prepend (request->waiters, waiter);
+}
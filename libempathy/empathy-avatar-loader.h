@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_AVATAR_LOADER_H__
+#define __EMPATHY_AVATAR_LOADER_H__
+
+#include <glib-object.h>
+
+#include "empathy-contact.h"
+
+G_BEGIN_DECLS
+#define EMPATHY_TYPE_AVATAR_LOADER         (empathy_avatar_loader_get_type ())
+#define EMPATHY_AVATAR_LOADER(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), EMPATHY_TYPE_AVATAR_LOADER, EmpathyAvatarLoader))
+#define EMPATHY_AVATAR_LOADER_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), EMPATHY_TYPE_AVATAR_LOADER, EmpathyAvatarLoaderClass))
+#define EMPATHY_IS_AVATAR_LOADER(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), EMPATHY_TYPE_AVATAR_LOADER))
+#define EMPATHY_IS_AVATAR_LOADER_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), EMPATHY_TYPE_AVATAR_LOADER))
+#define EMPATHY_AVATAR_LOADER_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), EMPATHY_TYPE_AVATAR_LOADER, EmpathyAvatarLoaderClass))
+
+typedef struct _EmpathyAvatarLoader EmpathyAvatarLoader;
+typedef struct _EmpathyAvatarLoaderClass EmpathyAvatarLoaderClass;
+typedef struct _EmpathyAvatarLoaderPrivate EmpathyAvatarLoaderPrivate;
+
+struct _EmpathyAvatarLoader
+{
+  GObject parent;
+  EmpathyAvatarLoaderPrivate *priv;
+};
+
+struct _EmpathyAvatarLoaderClass
+{
+  GObjectClass parent_class;
+};
+
+/* @avatar is NULL if @filename couldn't be read */
+typedef void (*EmpathyAvatarLoaderFunc) (GObject *object,
+    const gchar *filename,
+    EmpathyAvatar *avatar,
+    gpointer user_data);
+
+GType empathy_avatar_loader_get_type (void) G_GNUC_CONST;
+
+EmpathyAvatarLoader *empathy_avatar_loader_dup_singleton (void);
+
+void empathy_avatar_loader_load (EmpathyAvatarLoader *self,
+    const gchar *filename,
+    const gchar *format,
+    GObject *object,
+    EmpathyAvatarLoaderFunc callback,
+    gpointer user_data);
+
+G_END_DECLS
+#endif /* __EMPATHY_AVATAR_LOADER_H__ */
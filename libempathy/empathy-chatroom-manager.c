@@ -30,6 +30,9 @@
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
 #include <telepathy-glib/account-manager.h>
 #include <telepathy-glib/interfaces.h>
 #include <telepathy-glib/simple-observer.h>
@@ -38,6 +41,7 @@
 #include "empathy-client-factory.h"
 #include "empathy-tp-chat.h"
 #include "empathy-chatroom-manager.h"
+#include "empathy-file-store.h"
 #include "empathy-utils.h"
 
 #define DEBUG_FLAG EMPATHY_DEBUG_OTHER
@@ -62,14 +66,23 @@ static void observe_channels_cb (TpSimpleObserver *observer,
 typedef struct
 {
   GList *chatrooms;
+  /* EmpathyChatroom * -> owned ChatroomEntry */
+  GHashTable *entries;
+  /* owned "<account path> <room>" -> owned GList of borrowed ChatroomEntry,
+   * most recently added first */
+  GHashTable *index;
+  /* serial of the last entry added */
+  guint last_serial;
   gchar *file;
   TpAccountManager *account_manager;
 
-  /* source id of the autosave timer */
-  gint save_timer_id;
   gboolean ready;
   GFileMonitor *monitor;
-  gboolean writing;
+  /* Size and SHA-1 of what we last saved, so we don't reload the file when
+   * we write it. The file is only read if its size matches; if the write
+   * failed the checksums differ and the file is reloaded, as it should. */
+  gsize last_saved_size;
+  gchar *last_saved_checksum;
 
   TpBaseClient *observer;
 } EmpathyChatroomManagerPriv;
@@ -92,77 +105,157 @@ enum
 
 G_DEFINE_TYPE (EmpathyChatroomManager, empathy_chatroom_manager, G_TYPE_OBJECT);
 
+typedef struct
+{
+  EmpathyChatroom *chatroom;
+  /* NULL if the chatroom has no account or room yet */
+  gchar *key;
+  /* in priv->chatrooms */
+  GList *link;
+  /* entries added later have a greater serial */
+  guint serial;
+} ChatroomEntry;
+
+static gchar *
+chatroom_manager_make_key (TpAccount *account,
+    const gchar *room)
+{
+  if (account == NULL || room == NULL)
+    return NULL;
+
+  /* Object paths can't contain spaces */
+  return g_strconcat (tp_proxy_get_object_path (account), " ", room, NULL);
+}
+
+static void
+chatroom_entry_free (ChatroomEntry *entry)
+{
+  g_free (entry->key);
+  g_slice_free (ChatroomEntry, entry);
+}
+
+static gint
+chatroom_entry_compare_serial (gconstpointer a,
+    gconstpointer b)
+{
+  const ChatroomEntry *entry_a = a, *entry_b = b;
+
+  if (entry_a->serial == entry_b->serial)
+    return 0;
+
+  return entry_a->serial > entry_b->serial ? -1 : 1;
+}
+
+static void
+chatroom_manager_index_entry (EmpathyChatroomManager *self,
+    ChatroomEntry *entry)
+{
+  EmpathyChatroomManagerPriv *priv = GET_PRIV (self);
+  gpointer key;
+  GList *entries = NULL;
+
+  entry->key = chatroom_manager_make_key (
+      empathy_chatroom_get_account (entry->chatroom),
+      empathy_chatroom_get_room (entry->chatroom));
+
+  if (entry->key == NULL)
+    return;
+
+  /* Several chatrooms can end up with the same room. find() used to scan
+   * priv->chatrooms, which is prepended to, and so gave the most recently
+   * added one; keep them in that order. */
+  if (!g_hash_table_lookup_extended (priv->index, entry->key, &key,
+        (gpointer *) &entries))
+    key = g_strdup (entry->key);
+  else
+    g_hash_table_steal (priv->index, key);
+
+  entries = g_list_insert_sorted (entries, entry,
+      chatroom_entry_compare_serial);
+  g_hash_table_insert (priv->index, key, entries);
+}
+
+static void
+chatroom_manager_unindex_entry (EmpathyChatroomManager *self,
+    ChatroomEntry *entry)
+{
+  EmpathyChatroomManagerPriv *priv = GET_PRIV (self);
+  gpointer key;
+  GList *entries;
+
+  if (entry->key != NULL &&
+      g_hash_table_lookup_extended (priv->index, entry->key, &key,
+        (gpointer *) &entries))
+    {
+      g_hash_table_steal (priv->index, key);
+      entries = g_list_remove (entries, entry);
+
+      if (entries != NULL)
+        g_hash_table_insert (priv->index, key, entries);
+      else
+        g_free (key);
+    }
+
+  tp_clear_pointer (&entry->key, g_free);
+}
+
 /*
  * API to save/load and parse the chatrooms file.
  */
 
-static gboolean
-chatroom_manager_file_save (EmpathyChatroomManager *manager)
+static void
+append_text_child (GString *xml,
+    const gchar *tag,
+    const gchar *text)
 {
-  EmpathyChatroomManagerPriv *priv;
-  xmlDocPtr doc;
-  xmlNodePtr root;
-  GList *l;
+  gchar *escaped;
 
-  priv = GET_PRIV (manager);
+  escaped = g_markup_escape_text (text != NULL ? text : "", -1);
+  g_string_append_printf (xml, "    <%s>%s</%s>\n", tag, escaped, tag);
+  g_free (escaped);
+}
 
-  priv->writing = TRUE;
+static gchar *
+chatroom_manager_serialize (gsize *length,
+    gpointer user_data)
+{
+  EmpathyChatroomManager *manager = user_data;
+  EmpathyChatroomManagerPriv *priv = GET_PRIV (manager);
+  GString *xml;
+  GList *l;
 
-  doc = xmlNewDoc ((const xmlChar *) "1.0");
-  root = xmlNewNode (NULL, (const xmlChar *) "chatrooms");
-  xmlDocSetRootElement (doc, root);
+  xml = g_string_new ("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+      "<chatrooms>\n");
 
   for (l = priv->chatrooms; l; l = l->next)
     {
-      EmpathyChatroom *chatroom;
-      xmlNodePtr       node;
-      const gchar     *account_id;
-
-      chatroom = l->data;
+      EmpathyChatroom *chatroom = l->data;
 
       if (!empathy_chatroom_is_favorite (chatroom))
         continue;
 
-      account_id = tp_proxy_get_object_path (empathy_chatroom_get_account (
-            chatroom));
-
-      node = xmlNewChild (root, NULL, (const xmlChar *) "chatroom", NULL);
-      xmlNewTextChild (node, NULL, (const xmlChar *) "name",
-        (const xmlChar *) empathy_chatroom_get_name (chatroom));
-      xmlNewTextChild (node, NULL, (const xmlChar *) "room",
-        (const xmlChar *) empathy_chatroom_get_room (chatroom));
-      xmlNewTextChild (node, NULL, (const xmlChar *) "account",
-        (const xmlChar *) account_id);
-      xmlNewTextChild (node, NULL, (const xmlChar *) "auto_connect",
-        empathy_chatroom_get_auto_connect (chatroom) ?
-        (const xmlChar *) "yes" : (const xmlChar *) "no");
-      xmlNewTextChild (node, NULL, (const xmlChar *) "always_urgent",
-        empathy_chatroom_is_always_urgent (chatroom) ?
-        (const xmlChar *) "yes" : (const xmlChar *) "no");
+      g_string_append (xml, "  <chatroom>\n");
+      append_text_child (xml, "name", empathy_chatroom_get_name (chatroom));
+      append_text_child (xml, "room", empathy_chatroom_get_room (chatroom));
+      append_text_child (xml, "account", tp_proxy_get_object_path (
+            empathy_chatroom_get_account (chatroom)));
+      append_text_child (xml, "auto_connect",
+          empathy_chatroom_get_auto_connect (chatroom) ? "yes" : "no");
+      append_text_child (xml, "always_urgent",
+          empathy_chatroom_is_always_urgent (chatroom) ? "yes" : "no");
+      g_string_append (xml, "  </chatroom>\n");
     }
 
-  /* Make sure the XML is indented properly */
-  xmlIndentTreeOutput = 1;
+  g_string_append (xml, "</chatrooms>\n");
 
-  DEBUG ("Saving file:'%s'", priv->file);
-  xmlSaveFormatFileEnc (priv->file, doc, "utf-8", 1);
-  xmlFreeDoc (doc);
+  g_free (priv->last_saved_checksum);
+  priv->last_saved_checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1,
+      xml->str, xml->len);
+  priv->last_saved_size = xml->len;
 
-  xmlMemoryDump ();
+  *length = xml->len;
 
-  priv->writing = FALSE;
-  return TRUE;
-}
-
-static gboolean
-save_timeout (EmpathyChatroomManager *self)
-{
-  EmpathyChatroomManagerPriv *priv = GET_PRIV (self);
-
-  priv->save_timer_id = 0;
-  chatroom_manager_file_save (self);
-
-  return FALSE;
+  return g_string_free (xml, FALSE);
 }
 
 static void
@@ -170,11 +263,8 @@ reset_save_timeout (EmpathyChatroomManager *self)
 {
   EmpathyChatroomManagerPriv *priv = GET_PRIV (self);
 
-  if (priv->save_timer_id > 0)
-    g_source_remove (priv->save_timer_id);
-
-  priv->save_timer_id = g_timeout_add_seconds (SAVE_TIMER,
-      (GSourceFunc) save_timeout, self);
+  empathy_file_store_schedule (priv->file, SAVE_TIMER,
+      chatroom_manager_serialize, self);
 }
 
 static void
@@ -185,14 +275,42 @@ chatroom_changed_cb (EmpathyChatroom *chatroom,
   reset_save_timeout (self);
 }
 
+static void
+chatroom_key_changed_cb (EmpathyChatroom *chatroom,
+    GParamSpec *spec,
+    EmpathyChatroomManager *self)
+{
+  EmpathyChatroomManagerPriv *priv = GET_PRIV (self);
+  ChatroomEntry *entry;
+
+  entry = g_hash_table_lookup (priv->entries, chatroom);
+  g_return_if_fail (entry != NULL);
+
+  chatroom_manager_unindex_entry (self, entry);
+  chatroom_manager_index_entry (self, entry);
+}
+
 static void
 add_chatroom (EmpathyChatroomManager *self,
     EmpathyChatroom *chatroom)
 {
   EmpathyChatroomManagerPriv *priv = GET_PRIV (self);
+  ChatroomEntry *entry;
 
   priv->chatrooms = g_list_prepend (priv->chatrooms, g_object_ref (chatroom));
 
+  entry = g_slice_new0 (ChatroomEntry);
+  entry->chatroom = chatroom;
+  entry->link = priv->chatrooms;
+  entry->serial = ++priv->last_serial;
+  g_hash_table_insert (priv->entries, chatroom, entry);
+  chatroom_manager_index_entry (self, entry);
+
+  g_signal_connect (chatroom, "notify::room",
+      G_CALLBACK (chatroom_key_changed_cb), self);
+  g_signal_connect (chatroom, "notify::account",
+      G_CALLBACK (chatroom_key_changed_cb), self);
+
   /* Watch only those properties which are exported in the save file */
   g_signal_connect (chatroom, "notify::name",
       G_CALLBACK (chatroom_changed_cb), self);
@@ -445,6 +563,8 @@ clear_chatrooms (EmpathyChatroomManager *self)
    * re-call this function. We already set priv->chatrooms to NULL so we won't
    * try to destroy twice the same objects. */
   priv->chatrooms = NULL;
+  g_hash_table_remove_all (priv->index);
+  g_hash_table_remove_all (priv->entries);
 
   for (l = tmp; l != NULL; l = g_list_next (l))
     {
@@ -452,6 +572,8 @@ clear_chatrooms (EmpathyChatroomManager *self)
 
       g_signal_handlers_disconnect_by_func (chatroom, chatroom_changed_cb,
           self);
+      g_signal_handlers_disconnect_by_func (chatroom, chatroom_key_changed_cb,
+          self);
       g_signal_emit (self, signals[CHATROOM_REMOVED], 0, chatroom);
 
       g_object_unref (chatroom);
@@ -470,17 +592,15 @@ chatroom_manager_finalize (GObject *object)
 
   g_object_unref (priv->account_manager);
 
-  if (priv->save_timer_id > 0)
-    {
-      /* have to save before destroy the object */
-      g_source_remove (priv->save_timer_id);
-      priv->save_timer_id = 0;
-      chatroom_manager_file_save (self);
-    }
+  /* have to save before destroy the object */
+  empathy_file_store_flush (priv->file);
 
   clear_chatrooms (self);
+  g_hash_table_unref (priv->index);
+  g_hash_table_unref (priv->entries);
 
   g_free (priv->file);
+  g_free (priv->last_saved_checksum);
 
   (G_OBJECT_CLASS (empathy_chatroom_manager_parent_class)->finalize) (object);
 }
@@ -494,12 +614,29 @@ file_changed_cb (GFileMonitor *monitor,
 {
   EmpathyChatroomManager *self = user_data;
   EmpathyChatroomManagerPriv *priv = GET_PRIV (self);
+  GStatBuf buf;
+  gchar *contents, *checksum;
+  gsize length;
+  gboolean ours;
 
   if (event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
     return;
 
-  if (priv->writing)
-    return;
+  /* Don't reload what we just wrote */
+  if (priv->last_saved_checksum != NULL &&
+      g_stat (priv->file, &buf) == 0 &&
+      (gsize) buf.st_size == priv->last_saved_size &&
+      g_file_get_contents (priv->file, &contents, &length, NULL))
+    {
+      checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, contents,
+          length);
+      ours = !tp_strdiff (checksum, priv->last_saved_checksum);
+      g_free (checksum);
+      g_free (contents);
+
+      if (ours)
+        return;
+    }
 
   DEBUG ("chatrooms file changed; reloading list");
 
@@ -670,6 +807,11 @@ empathy_chatroom_manager_init (EmpathyChatroomManager *manager)
       EMPATHY_TYPE_CHATROOM_MANAGER, EmpathyChatroomManagerPriv);
 
   manager->priv = priv;
+
+  priv->entries = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) chatroom_entry_free);
+  priv->index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) g_list_free);
 }
 
 EmpathyChatroomManager *
@@ -704,23 +846,27 @@ empathy_chatroom_manager_add (EmpathyChatroomManager *manager,
 }
 
 static void
-chatroom_manager_remove_link (EmpathyChatroomManager *manager,
-    GList *l)
+chatroom_manager_remove_entry (EmpathyChatroomManager *manager,
+    ChatroomEntry *entry)
 {
   EmpathyChatroomManagerPriv *priv;
   EmpathyChatroom *chatroom;
 
   priv = GET_PRIV (manager);
 
-  chatroom = l->data;
+  chatroom = entry->chatroom;
 
   if (empathy_chatroom_is_favorite (chatroom))
     reset_save_timeout (manager);
 
-  priv->chatrooms = g_list_delete_link (priv->chatrooms, l);
+  priv->chatrooms = g_list_delete_link (priv->chatrooms, entry->link);
+  chatroom_manager_unindex_entry (manager, entry);
+  g_hash_table_remove (priv->entries, chatroom);
 
   g_signal_emit (manager, signals[CHATROOM_REMOVED], 0, chatroom);
   g_signal_handlers_disconnect_by_func (chatroom, chatroom_changed_cb, manager);
+  g_signal_handlers_disconnect_by_func (chatroom, chatroom_key_changed_cb,
+      manager);
 
   g_object_unref (chatroom);
 }
@@ -730,26 +876,28 @@ empathy_chatroom_manager_remove (EmpathyChatroomManager *manager,
     EmpathyChatroom        *chatroom)
 {
   EmpathyChatroomManagerPriv *priv;
-  GList *l;
+  ChatroomEntry *entry;
 
   g_return_if_fail (EMPATHY_IS_CHATROOM_MANAGER (manager));
   g_return_if_fail (EMPATHY_IS_CHATROOM (chatroom));
 
   priv = GET_PRIV (manager);
 
-  for (l = priv->chatrooms; l; l = l->next)
+  entry = g_hash_table_lookup (priv->entries, chatroom);
+  if (entry == NULL)
     {
-      EmpathyChatroom *this_chatroom;
-
-      this_chatroom = l->data;
-
-      if (this_chatroom == chatroom ||
-          empathy_chatroom_equal (chatroom, this_chatroom))
-        {
-          chatroom_manager_remove_link (manager, l);
-          break;
-        }
+      EmpathyChatroom *equal;
+
+      /* An other object for the same room */
+      equal = empathy_chatroom_manager_find (manager,
+          empathy_chatroom_get_account (chatroom),
+          empathy_chatroom_get_room (chatroom));
+      if (equal != NULL)
+        entry = g_hash_table_lookup (priv->entries, equal);
     }
+
+  if (entry != NULL)
+    chatroom_manager_remove_entry (manager, entry);
 }
 
 EmpathyChatroom *
@@ -758,29 +906,25 @@ empathy_chatroom_manager_find (EmpathyChatroomManager *manager,
     const gchar *room)
 {
   EmpathyChatroomManagerPriv *priv;
-  GList *l;
+  GList *entries;
+  gchar *key;
 
   g_return_val_if_fail (EMPATHY_IS_CHATROOM_MANAGER (manager), NULL);
   g_return_val_if_fail (room != NULL, NULL);
 
   priv = GET_PRIV (manager);
 
-  for (l = priv->chatrooms; l; l = l->next)
-    {
-      EmpathyChatroom *chatroom;
-      TpAccount *this_account;
-      const gchar    *this_room;
+  key = chatroom_manager_make_key (account, room);
+  if (key == NULL)
+    return NULL;
 
-      chatroom = l->data;
-      this_account = empathy_chatroom_get_account (chatroom);
-      this_room = empathy_chatroom_get_room (chatroom);
+  entries = g_hash_table_lookup (priv->index, key);
+  g_free (key);
 
-      if (this_account && this_room && account == this_account
-          && strcmp (this_room, room) == 0)
-        return chatroom;
-    }
+  if (entries == NULL)
+    return NULL;
 
-  return NULL;
+  return ((ChatroomEntry *) entries->data)->chatroom;
 }
 
 EmpathyChatroom *
@@ -860,7 +1004,8 @@ chatroom_manager_chat_invalidated_cb (EmpathyTpChat *chat,
           /* Remove the chatroom from the list, unless it's in the list of
            * favourites..
            * FIXME this policy should probably not be in libempathy */
-          chatroom_manager_remove_link (manager, l);
+          chatroom_manager_remove_entry (manager,
+              g_hash_table_lookup (priv->entries, chatroom));
         }
 
       break;
@@ -32,6 +32,7 @@
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 
+#include "empathy-file-store.h"
 #include "empathy-utils.h"
 #include "empathy-contact-groups.h"
 
@@ -180,20 +181,17 @@ contact_group_free (ContactGroup *group)
 	g_free (group);
 }
 
-static gboolean
-contact_groups_file_save (void)
+static gchar *
+contact_groups_serialize (gsize    *length,
+			  gpointer  user_data)
 {
 	xmlDocPtr   doc;
 	xmlNodePtr  root;
 	xmlNodePtr  node;
 	GList      *l;
-	gchar      *dir;
-	gchar      *file;
-
-	dir = g_build_filename (g_get_user_config_dir (), PACKAGE_NAME, NULL);
-	g_mkdir_with_parents (dir, S_IRUSR | S_IWUSR | S_IXUSR);
-	file = g_build_filename (dir, CONTACT_GROUPS_XML_FILENAME, NULL);
-	g_free (dir);
+	xmlChar    *buffer;
+	gint        size;
+	gchar      *content;
 
 	doc = xmlNewDoc ((const xmlChar *) "1.0");
 	root = xmlNewNode (NULL, (const xmlChar *) "contacts");
@@ -217,11 +215,27 @@ contact_groups_file_save (void)
 	/* Make sure the XML is indented properly */
 	xmlIndentTreeOutput = 1;
 
-	DEBUG ("Saving file:'%s'", file);
-	xmlSaveFormatFileEnc (file, doc, "utf-8", 1);
+	xmlDocDumpFormatMemoryEnc (doc, &buffer, &size, "utf-8", 1);
 	xmlFreeDoc (doc);
 
-	xmlMemoryDump ();
+	content = g_strndup ((const gchar *) buffer, size);
+	*length = size;
+	xmlFree (buffer);
+
+	return content;
+}
+
+static gboolean
+contact_groups_file_save (void)
+{
+	gchar *file;
+
+	file = g_build_filename (g_get_user_config_dir (), PACKAGE_NAME,
+				 CONTACT_GROUPS_XML_FILENAME, NULL);
+
+	/* Groups being expanded and collapsed are only saved once the user is
+	 * done with them */
+	empathy_file_store_schedule (file, 1, contact_groups_serialize, NULL);
 
 	g_free (file);
 
@@ -40,6 +40,7 @@
 #endif
 
 #include "empathy-contact.h"
+#include "empathy-avatar-loader.h"
 #include "empathy-camera-monitor.h"
 #include "empathy-individual-manager.h"
 #include "empathy-utils.h"
@@ -58,6 +59,8 @@ typedef struct {
   gchar *alias;
   gchar *logged_alias;
   EmpathyAvatar *avatar;
+  /* The file of the last avatar asked to the loader, until it's loaded */
+  gchar *avatar_loading;
   TpConnectionPresenceType presence;
   guint handle;
   EmpathyCapabilities capabilities;
@@ -97,7 +100,7 @@ static void set_capabilities_from_tp_caps (EmpathyContact *self,
 static void contact_set_avatar (EmpathyContact *contact,
     EmpathyAvatar *avatar);
 static void contact_set_avatar_from_tp_contact (EmpathyContact *contact);
-static gboolean contact_load_avatar_cache (EmpathyContact *contact,
+static void contact_load_avatar_cache (EmpathyContact *contact,
     const gchar *token);
 
 G_DEFINE_TYPE (EmpathyContact, empathy_contact, G_TYPE_OBJECT);
@@ -217,6 +220,8 @@ contact_dispose (GObject *object)
       priv->avatar = NULL;
     }
 
+  tp_clear_pointer (&priv->avatar_loading, g_free);
+
   if (priv->location != NULL)
     {
       g_hash_table_unref (priv->location);
@@ -1334,74 +1339,113 @@ empathy_contact_can_do_action (EmpathyContact *self,
   return (sensitivity ? TRUE : FALSE);
 }
 
+/* Only depends on the account, and is needed for each avatar token */
+static const gchar *
+contact_get_avatar_dir (TpAccount *account)
+{
+  static GQuark quark = 0;
+  gchar *avatar_dir;
+
+  if (G_UNLIKELY (quark == 0))
+    quark = g_quark_from_static_string ("empathy-contact-avatar-dir");
+
+  avatar_dir = g_object_get_qdata (G_OBJECT (account), quark);
+  if (avatar_dir != NULL)
+    return avatar_dir;
+
+  avatar_dir = g_build_filename (g_get_user_cache_dir (),
+      "telepathy",
+      "avatars",
+      tp_account_get_connection_manager (account),
+      tp_account_get_protocol (account),
+      NULL);
+  g_object_set_qdata_full (G_OBJECT (account), quark, avatar_dir, g_free);
+
+  return avatar_dir;
+}
+
 static gchar *
 contact_get_avatar_filename (EmpathyContact *contact,
                              const gchar *token)
 {
   TpAccount *account;
-  gchar *avatar_path;
   gchar *avatar_file;
   gchar *token_escaped;
 
   if (EMP_STR_EMPTY (empathy_contact_get_id (contact)))
     return NULL;
 
-  token_escaped = tp_escape_as_identifier (token);
   account = empathy_contact_get_account (contact);
+  if (account == NULL)
+    return NULL;
 
-  avatar_path = g_build_filename (g_get_user_cache_dir (),
-      "telepathy",
-      "avatars",
-      tp_account_get_connection_manager (account),
-      tp_account_get_protocol (account),
-      NULL);
-  g_mkdir_with_parents (avatar_path, 0700);
-
-  avatar_file = g_build_filename (avatar_path, token_escaped, NULL);
-
+  token_escaped = tp_escape_as_identifier (token);
+  avatar_file = g_build_filename (contact_get_avatar_dir (account),
+      token_escaped, NULL);
   g_free (token_escaped);
-  g_free (avatar_path);
 
   return avatar_file;
 }
 
-static gboolean
+static void
+contact_avatar_loaded_cb (GObject *object,
+    const gchar *filename,
+    EmpathyAvatar *avatar,
+    gpointer user_data)
+{
+  EmpathyContact *contact = EMPATHY_CONTACT (object);
+  EmpathyContactPriv *priv = GET_PRIV (contact);
+
+  /* Another avatar was asked for meanwhile */
+  if (tp_strdiff (priv->avatar_loading, filename))
+    return;
+
+  tp_clear_pointer (&priv->avatar_loading, g_free);
+  contact_set_avatar (contact, avatar);
+}
+
+static void
+contact_load_avatar (EmpathyContact *contact,
+    const gchar *filename,
+    const gchar *format)
+{
+  EmpathyContactPriv *priv = GET_PRIV (contact);
+  EmpathyAvatarLoader *loader;
+
+  /* Avatar files are named after their token, so they never change */
+  if (priv->avatar != NULL && !tp_strdiff (priv->avatar->filename, filename))
+    {
+      tp_clear_pointer (&priv->avatar_loading, g_free);
+      return;
+    }
+
+  if (!tp_strdiff (priv->avatar_loading, filename))
+    return;
+
+  g_free (priv->avatar_loading);
+  priv->avatar_loading = g_strdup (filename);
+
+  loader = empathy_avatar_loader_dup_singleton ();
+  empathy_avatar_loader_load (loader, filename, format, G_OBJECT (contact),
+      contact_avatar_loaded_cb, NULL);
+  g_object_unref (loader);
+}
+
+static void
 contact_load_avatar_cache (EmpathyContact *contact,
                            const gchar *token)
 {
-  EmpathyAvatar *avatar = NULL;
   gchar *filename;
-  gchar *data = NULL;
-  gsize len;
-  GError *error = NULL;
 
-  g_return_val_if_fail (EMPATHY_IS_CONTACT (contact), FALSE);
-  g_return_val_if_fail (!EMP_STR_EMPTY (token), FALSE);
+  g_return_if_fail (EMPATHY_IS_CONTACT (contact));
+  g_return_if_fail (!EMP_STR_EMPTY (token));
 
   /* Load the avatar from file if it exists */
   filename = contact_get_avatar_filename (contact, token);
-  if (filename && g_file_test (filename, G_FILE_TEST_EXISTS))
-    {
-      if (!g_file_get_contents (filename, &data, &len, &error))
-        {
-          DEBUG ("Failed to load avatar from cache: %s",
-            error ? error->message : "No error given");
-          g_clear_error (&error);
-        }
-    }
+  if (filename != NULL)
+    contact_load_avatar (contact, filename, NULL);
 
-  if (data != NULL)
-    {
-      DEBUG ("Avatar loaded from %s", filename);
-      avatar = empathy_avatar_new ((guchar *) data, len, NULL, filename);
-      contact_set_avatar (contact, avatar);
-      empathy_avatar_unref (avatar);
-    }
-
-  g_free (data);
   g_free (filename);
-
-  return data != NULL;
 }
 
 GType
@@ -1814,40 +1858,22 @@ static void
 contact_set_avatar_from_tp_contact (EmpathyContact *contact)
 {
   EmpathyContactPriv *priv = GET_PRIV (contact);
-  const gchar *mime;
   GFile *file;
+  gchar *path = NULL;
 
-  mime = tp_contact_get_avatar_mime_type (priv->tp_contact);
   file = tp_contact_get_avatar_file (priv->tp_contact);
-
   if (file != NULL)
-    {
-      EmpathyAvatar *avatar;
-      gchar *data;
-      gsize len;
-      gchar *path;
-      GError *error = NULL;
-
-      if (!g_file_load_contents (file, NULL, &data, &len, NULL, &error))
-        {
-          DEBUG ("Failed to load avatar: %s", error->message);
-
-          g_error_free (error);
-          contact_set_avatar (contact, NULL);
-          return;
-        }
-
-      path = g_file_get_path (file);
+    path = g_file_get_path (file);
 
-      avatar = empathy_avatar_new ((guchar *) data, len, mime, path);
-
-      contact_set_avatar (contact, avatar);
-      empathy_avatar_unref (avatar);
+  if (path != NULL)
+    {
+      contact_load_avatar (contact, path,
+          tp_contact_get_avatar_mime_type (priv->tp_contact));
       g_free (path);
-      g_free (data);
     }
   else
     {
+      tp_clear_pointer (&priv->avatar_loading, g_free);
       contact_set_avatar (contact, NULL);
     }
 }
@@ -31,6 +31,7 @@
 
 #include <telepathy-glib/debug.h>
 #include <telepathy-glib/debug-sender.h>
+#include <telepathy-glib/util.h>
 
 #include "empathy-debug.h"
 
@@ -54,6 +55,7 @@ static GDebugKey keys[] = {
   { "Voip", EMPATHY_DEBUG_VOIP },
   { "Tls", EMPATHY_DEBUG_TLS },
   { "Sasl", EMPATHY_DEBUG_SASL },
+  { "Trace", EMPATHY_DEBUG_TRACE },
   { 0, }
 };
 
@@ -82,57 +84,103 @@ empathy_debug_flag_is_set (EmpathyDebugFlags flag)
   return (flag & flags) != 0;
 }
 
-GHashTable *flag_to_keys = NULL;
+/* "empathy/<key>" domain of each flag, indexed by the flag's bit */
+static gchar *flag_to_domain[32] = { NULL, };
+static gboolean flag_to_domain_initialized = FALSE;
+
+/* Kept around so we don't have to dup it, and so we can cheaply know
+ * whether a debugger is listening */
+static TpDebugSender *debug_sender = NULL;
+static gboolean debug_sender_enabled = FALSE;
 
 static const gchar *
-debug_flag_to_key (EmpathyDebugFlags flag)
+debug_flag_to_domain (EmpathyDebugFlags flag)
 {
-  if (flag_to_keys == NULL)
+  gint bit;
+
+  if (!flag_to_domain_initialized)
     {
       guint i;
 
-      flag_to_keys = g_hash_table_new_full (g_direct_hash, g_direct_equal,
-          NULL, g_free);
-
+      /* Some flags share the same bit, last key wins */
       for (i = 0; keys[i].value; i++)
         {
-          GDebugKey key = (GDebugKey) keys[i];
-          g_hash_table_insert (flag_to_keys, GUINT_TO_POINTER (key.value),
-              g_strdup (key.key));
+          bit = g_bit_nth_lsf (keys[i].value, -1);
+
+          g_free (flag_to_domain[bit]);
+          flag_to_domain[bit] = g_strdup_printf ("%s/%s", G_LOG_DOMAIN,
+              keys[i].key);
         }
+
+      flag_to_domain_initialized = TRUE;
     }
 
-  return g_hash_table_lookup (flag_to_keys, GUINT_TO_POINTER (flag));
+  bit = g_bit_nth_lsf (flag, -1);
+  if (bit < 0 || flag_to_domain[bit] == NULL)
+    return G_LOG_DOMAIN;
+
+  return flag_to_domain[bit];
+}
+
+static void
+debug_sender_notify_enabled_cb (GObject *sender,
+    GParamSpec *pspec,
+    gpointer user_data)
+{
+  g_object_get (sender, "enabled", &debug_sender_enabled, NULL);
+}
+
+static void
+ensure_debug_sender (void)
+{
+  if (debug_sender != NULL)
+    return;
+
+  debug_sender = tp_debug_sender_dup ();
+
+  g_signal_connect (debug_sender, "notify::enabled",
+      G_CALLBACK (debug_sender_notify_enabled_cb), NULL);
+  debug_sender_notify_enabled_cb (G_OBJECT (debug_sender), NULL, NULL);
 }
 
 void
 empathy_debug_free (void)
 {
-  if (flag_to_keys == NULL)
-    return;
+  guint i;
 
-  g_hash_table_unref (flag_to_keys);
-  flag_to_keys = NULL;
+  for (i = 0; i < G_N_ELEMENTS (flag_to_domain); i++)
+    tp_clear_pointer (&flag_to_domain[i], g_free);
+  flag_to_domain_initialized = FALSE;
+
+  if (debug_sender != NULL)
+    {
+      g_signal_handlers_disconnect_by_func (debug_sender,
+          debug_sender_notify_enabled_cb, NULL);
+      tp_clear_object (&debug_sender);
+      debug_sender_enabled = FALSE;
+    }
+}
+
+/* Whether a message for flag would be displayed or sent to a debugger.
+ * DEBUG() checks this before evaluating its arguments. */
+gboolean
+empathy_debug_is_active (EmpathyDebugFlags flag)
+{
+  ensure_debug_sender ();
+
+  return (flag & flags) != 0 || debug_sender_enabled;
 }
 
 static void
 log_to_debug_sender (EmpathyDebugFlags flag,
     const gchar *message)
 {
-  TpDebugSender *sender;
-  gchar *domain;
   GTimeVal now;
 
-  sender = tp_debug_sender_dup ();
-
   g_get_current_time (&now);
 
-  domain = g_strdup_printf ("%s/%s", G_LOG_DOMAIN, debug_flag_to_key (flag));
-
-  tp_debug_sender_add_message (sender, &now, domain, G_LOG_LEVEL_DEBUG, message);
-
-  g_free (domain);
-  g_object_unref (sender);
+  tp_debug_sender_add_message (debug_sender, &now,
+      debug_flag_to_domain (flag), G_LOG_LEVEL_DEBUG, message);
 }
 
 void
@@ -143,11 +191,16 @@ empathy_debug (EmpathyDebugFlags flag,
   gchar *message;
   va_list args;
 
+  /* Nobody would see this message, don't bother formatting it */
+  if (!empathy_debug_is_active (flag))
+    return;
+
   va_start (args, format);
   message = g_strdup_vprintf (format, args);
   va_end (args);
 
-  log_to_debug_sender (flag, message);
+  if (debug_sender_enabled)
+    log_to_debug_sender (flag, message);
 
   if (flag & flags)
     g_log (G_LOG_DOMAIN, G_LOG_LEVEL_DEBUG, "%s", message);
@@ -163,6 +216,12 @@ empathy_debug_flag_is_set (EmpathyDebugFlags flag)
   return FALSE;
 }
 
+gboolean
+empathy_debug_is_active (EmpathyDebugFlags flag)
+{
+  return FALSE;
+}
+
 void
 empathy_debug (EmpathyDebugFlags flag, const gchar *format, ...)
 {
@@ -48,9 +48,11 @@ typedef enum
   EMPATHY_DEBUG_VOIP = 1 << 13,
   EMPATHY_DEBUG_TLS = 1 << 14,
   EMPATHY_DEBUG_SASL = 1 << 15,
+  EMPATHY_DEBUG_TRACE = 1 << 16,
 } EmpathyDebugFlags;
 
 gboolean empathy_debug_flag_is_set (EmpathyDebugFlags flag);
+gboolean empathy_debug_is_active (EmpathyDebugFlags flag);
 void empathy_debug (EmpathyDebugFlags flag, const gchar *format, ...)
     G_GNUC_PRINTF (2, 3);
 void empathy_debug_free (void);
@@ -80,12 +82,16 @@ G_END_DECLS
 #ifdef DEBUG_FLAG
 #ifdef ENABLE_DEBUG
 
+/* Arguments are only evaluated if the message would go somewhere */
 #undef DEBUG
 #define DEBUG(format, ...) \
-  empathy_debug (DEBUG_FLAG, "%s: " format, G_STRFUNC, ##__VA_ARGS__)
+  G_STMT_START { \
+    if (empathy_debug_is_active (DEBUG_FLAG)) \
+      empathy_debug (DEBUG_FLAG, "%s: " format, G_STRFUNC, ##__VA_ARGS__); \
+  } G_STMT_END
 
 #undef DEBUGGING
-#define DEBUGGING empathy_debug_flag_is_set (DEBUG_FLAG)
+#define DEBUGGING empathy_debug_is_active (DEBUG_FLAG)
 
 #else /* !defined (ENABLE_DEBUG) */
 
@@ -0,0 +1,538 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include "empathy-file-store.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_OTHER
+#include "empathy-debug.h"
+
+/* Small files which are rewritten as a whole, such as the geometry of the
+ * windows or the favourite chatrooms, are saved through here.
+ *
+ * Changes are debounced per file, and the file's content is only serialized
+ * once the delay is over, in the main thread. It's then written by a single
+ * writer thread to a temporary file which is renamed over the old one, so
+ * the file is never left half written. Files queued together are written in
+ * one batch, so they're all synced before any of them is renamed, and each
+ * directory is synced once. Content queued for a file while the previous one
+ * is waiting for the writer replaces it.
+ *
+ * Programs write whatever is pending with empathy_file_store_flush_all()
+ * once their main loop is done; an exit hook does it as a last resort for
+ * those which exit some other way. */
+
+/* Files changing all the time are still written this often, in seconds */
+#define MAX_DELAY 10
+
+#define DIR_CREATE_MODE (S_IRUSR | S_IWUSR | S_IXUSR)
+/* New files are created like g_file_set_contents() does, and the umask
+ * applies; files being replaced keep their mode */
+#define FILE_CREATE_MODE (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | \
+    S_IWOTH)
+#define FILE_MODE_MASK (S_IRWXU | S_IRWXG | S_IRWXO)
+
+typedef struct
+{
+  gchar *filename;
+  EmpathyFileStoreFunc func;
+  gpointer user_data;
+  guint timeout_id;
+  /* Monotonic time of the first change which isn't queued yet */
+  gint64 first_change;
+} PendingFile;
+
+typedef struct
+{
+  gchar *filename;
+  gchar *contents;
+  gsize length;
+
+  /* Only used by the writer */
+  gchar *tmp_filename;
+  gint fd;
+} WriteJob;
+
+/* filename -> owned PendingFile; only used in the main thread */
+static GHashTable *pending = NULL;
+
+/* NULL if the thread couldn't be created, files are then written by the main
+ * thread */
+static GThread *writer = NULL;
+
+/* Everything below is protected by lock */
+static GMutex *lock = NULL;
+/* Signalled when a job is queued */
+static GCond *jobs_cond = NULL;
+/* Broadcast when the writer is done with a batch */
+static GCond *idle_cond = NULL;
+/* filename -> owned WriteJob */
+static GHashTable *jobs = NULL;
+static gboolean writing = FALSE;
+
+static void
+pending_file_free (PendingFile *file)
+{
+  if (file->timeout_id != 0)
+    g_source_remove (file->timeout_id);
+
+  g_free (file->filename);
+  g_slice_free (PendingFile, file);
+}
+
+static void
+write_job_free (WriteJob *job)
+{
+  g_free (job->filename);
+  g_free (job->contents);
+  g_free (job->tmp_filename);
+  g_slice_free (WriteJob, job);
+}
+
+static GHashTable *
+file_store_jobs_new (void)
+{
+  /* Keys are owned by the jobs */
+  return g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) write_job_free);
+}
+
+static gboolean
+file_store_write_all (gint fd,
+    const gchar *data,
+    gsize length)
+{
+  while (length > 0)
+    {
+      gssize written = write (fd, data, length);
+
+      if (written < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          return FALSE;
+        }
+
+      data += written;
+      length -= written;
+    }
+
+  return TRUE;
+}
+
+static gchar *
+file_store_strerror (const gchar *action,
+    const gchar *filename,
+    gint errsv)
+{
+  return g_strdup_printf ("Failed to %s %s: %s", action, filename,
+      g_strerror (errsv));
+}
+
+static void
+file_store_sync_dir (const gchar *dir,
+    GSList **errors)
+{
+  gint fd;
+
+  fd = g_open (dir, O_RDONLY, 0);
+  if (fd < 0)
+    {
+      *errors = g_slist_prepend (*errors,
+          file_store_strerror ("open", dir, errno));
+      return;
+    }
+
+  if (fsync (fd) != 0)
+    *errors = g_slist_prepend (*errors,
+        file_store_strerror ("sync", dir, errno));
+
+  close (fd);
+}
+
+/* Doesn't use anything but the jobs, so it can run in the writer thread.
+ *
+ * Returns: the messages of the errors which happened */
+static GSList *
+file_store_write_batch (GHashTable *batch)
+{
+  GHashTableIter iter;
+  gpointer value;
+  GHashTable *dirs;
+  GSList *errors = NULL;
+
+  dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  /* Write everything, then sync everything, so the data of all the files
+   * can go to the disk together */
+  g_hash_table_iter_init (&iter, batch);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      WriteJob *job = value;
+      GStatBuf buf;
+      gchar *dir;
+
+      dir = g_path_get_dirname (job->filename);
+      g_mkdir_with_parents (dir, DIR_CREATE_MODE);
+      g_hash_table_insert (dirs, dir, NULL);
+
+      job->tmp_filename = g_strdup_printf ("%s.XXXXXX", job->filename);
+      job->fd = g_mkstemp_full (job->tmp_filename, O_RDWR, FILE_CREATE_MODE);
+      if (job->fd < 0)
+        {
+          errors = g_slist_prepend (errors,
+              file_store_strerror ("create", job->tmp_filename, errno));
+          continue;
+        }
+
+      if (g_stat (job->filename, &buf) == 0 &&
+          fchmod (job->fd, buf.st_mode & FILE_MODE_MASK) != 0)
+        errors = g_slist_prepend (errors,
+            file_store_strerror ("change the mode of", job->tmp_filename,
+              errno));
+
+      if (!file_store_write_all (job->fd, job->contents, job->length))
+        {
+          errors = g_slist_prepend (errors,
+              file_store_strerror ("write", job->tmp_filename, errno));
+          close (job->fd);
+          g_unlink (job->tmp_filename);
+          job->fd = -1;
+        }
+    }
+
+  g_hash_table_iter_init (&iter, batch);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      WriteJob *job = value;
+      gboolean ok;
+
+      if (job->fd < 0)
+        continue;
+
+      ok = (fsync (job->fd) == 0);
+      if (!ok)
+        errors = g_slist_prepend (errors,
+            file_store_strerror ("sync", job->tmp_filename, errno));
+
+      close (job->fd);
+      job->fd = -1;
+
+      /* Keep the old file rather than risk replacing it with an empty one */
+      if (!ok)
+        {
+          g_unlink (job->tmp_filename);
+          continue;
+        }
+
+      if (g_rename (job->tmp_filename, job->filename) != 0)
+        {
+          errors = g_slist_prepend (errors,
+              file_store_strerror ("rename", job->tmp_filename, errno));
+          g_unlink (job->tmp_filename);
+        }
+    }
+
+  /* So the renames are on the disk too */
+  g_hash_table_iter_init (&iter, dirs);
+  while (g_hash_table_iter_next (&iter, &value, NULL))
+    file_store_sync_dir (value, &errors);
+
+  g_hash_table_unref (dirs);
+
+  return errors;
+}
+
+static gboolean
+file_store_report_errors_cb (gpointer user_data)
+{
+  GSList *errors = user_data, *l;
+
+  for (l = errors; l != NULL; l = g_slist_next (l))
+    DEBUG ("%s", (const gchar *) l->data);
+
+  g_slist_foreach (errors, (GFunc) g_free, NULL);
+  g_slist_free (errors);
+
+  return FALSE;
+}
+
+static gpointer
+file_store_thread (gpointer data)
+{
+  g_mutex_lock (lock);
+
+  while (TRUE)
+    {
+      GHashTable *batch;
+      GSList *errors;
+
+      while (g_hash_table_size (jobs) == 0)
+        g_cond_wait (jobs_cond, lock);
+
+      batch = jobs;
+      jobs = file_store_jobs_new ();
+      writing = TRUE;
+
+      g_mutex_unlock (lock);
+
+      errors = file_store_write_batch (batch);
+      g_hash_table_unref (batch);
+
+      /* Debug messages are sent from the main thread */
+      if (errors != NULL)
+        g_idle_add (file_store_report_errors_cb, errors);
+
+      g_mutex_lock (lock);
+
+      writing = FALSE;
+      g_cond_broadcast (idle_cond);
+    }
+
+  return NULL;
+}
+
+static void
+file_store_flush_at_exit (void)
+{
+  empathy_file_store_flush_all ();
+}
+
+static void
+file_store_ensure (void)
+{
+  GError *error = NULL;
+
+  if (pending != NULL)
+    return;
+
+  pending = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) pending_file_free);
+
+  lock = g_mutex_new ();
+  jobs_cond = g_cond_new ();
+  idle_cond = g_cond_new ();
+  jobs = file_store_jobs_new ();
+
+  writer = g_thread_create (file_store_thread, NULL, FALSE, &error);
+  if (writer == NULL)
+    {
+      DEBUG ("Failed to create the writer thread, writing files in the "
+          "main thread: %s", error->message);
+      g_error_free (error);
+    }
+
+  atexit (file_store_flush_at_exit);
+}
+
+static void
+file_store_push (gchar *filename,
+    gchar *contents,
+    gsize length)
+{
+  WriteJob *job;
+
+  job = g_slice_new0 (WriteJob);
+  job->filename = filename;
+  job->contents = contents;
+  job->length = length;
+  job->fd = -1;
+
+  if (writer == NULL)
+    {
+      GHashTable *batch = file_store_jobs_new ();
+
+      g_hash_table_insert (batch, job->filename, job);
+      file_store_report_errors_cb (file_store_write_batch (batch));
+      g_hash_table_unref (batch);
+      return;
+    }
+
+  g_mutex_lock (lock);
+
+  /* Replaces, and frees, the content the writer didn't get to yet. The old
+   * key is owned by the old job, so it has to be replaced as well. */
+  g_hash_table_replace (jobs, job->filename, job);
+  g_cond_signal (jobs_cond);
+
+  g_mutex_unlock (lock);
+}
+
+/* Serializes the file now and hands it over to the writer */
+static void
+file_store_queue (PendingFile *file)
+{
+  gchar *contents;
+  gsize length = 0;
+
+  /* The callback could schedule the file again */
+  g_hash_table_steal (pending, file->filename);
+
+  DEBUG ("Saving %s", file->filename);
+
+  contents = file->func (&length, file->user_data);
+  if (contents != NULL)
+    {
+      file_store_push (file->filename, contents, length);
+      file->filename = NULL;
+    }
+
+  pending_file_free (file);
+}
+
+static gboolean
+file_store_timeout_cb (gpointer user_data)
+{
+  PendingFile *file = user_data;
+
+  file->timeout_id = 0;
+  file_store_queue (file);
+
+  return FALSE;
+}
+
+/* Waits until the writer is done with everything queued */
+static void
+file_store_wait (void)
+{
+  if (writer == NULL)
+    return;
+
+  g_mutex_lock (lock);
+
+  while (writing || g_hash_table_size (jobs) > 0)
+    g_cond_wait (idle_cond, lock);
+
+  g_mutex_unlock (lock);
+}
+
+/**
+ * empathy_file_store_schedule:
+ * @filename: the file to write
+ * @delay: the number of seconds to wait for other changes
+ * @func: the function returning the content of @filename
+ * @user_data: user data passed to @func
+ *
+ * Saves @filename once it hasn't been scheduled again for @delay seconds, or
+ * after a while if it keeps on being scheduled. Only the last @func and
+ * @user_data are used; @user_data has to stay valid until the file is saved,
+ * which is why owners of a file flush it when going away.
+ *
+ * Must be called from the main thread.
+ */
+void
+empathy_file_store_schedule (const gchar *filename,
+    guint delay,
+    EmpathyFileStoreFunc func,
+    gpointer user_data)
+{
+  PendingFile *file;
+  gint64 now;
+
+  g_return_if_fail (filename != NULL);
+  g_return_if_fail (func != NULL);
+
+  file_store_ensure ();
+
+  now = g_get_monotonic_time ();
+  file = g_hash_table_lookup (pending, filename);
+
+  if (file == NULL)
+    {
+      file = g_slice_new0 (PendingFile);
+      file->filename = g_strdup (filename);
+      file->first_change = now;
+      g_hash_table_insert (pending, file->filename, file);
+    }
+  else if (now - file->first_change >= MAX_DELAY * G_USEC_PER_SEC)
+    {
+      /* Don't put it off any longer, the current timeout will do */
+      file->func = func;
+      file->user_data = user_data;
+      return;
+    }
+  else
+    {
+      g_source_remove (file->timeout_id);
+    }
+
+  file->func = func;
+  file->user_data = user_data;
+  file->timeout_id = g_timeout_add_seconds (delay, file_store_timeout_cb,
+      file);
+}
+
+/**
+ * empathy_file_store_flush:
+ * @filename: a file
+ *
+ * Saves @filename now if it was scheduled, and waits until it's written.
+ */
+void
+empathy_file_store_flush (const gchar *filename)
+{
+  PendingFile *file;
+
+  g_return_if_fail (filename != NULL);
+
+  if (pending == NULL)
+    return;
+
+  file = g_hash_table_lookup (pending, filename);
+  if (file != NULL)
+    file_store_queue (file);
+
+  file_store_wait ();
+}
+
+/**
+ * empathy_file_store_flush_all:
+ *
+ * Saves all the files which were scheduled, and waits until they're written.
+ * Programs call this once their main loop returns, or earlier if the data of
+ * some of the files is going away before that. It's also done when the
+ * process exits, as a last resort.
+ */
+void
+empathy_file_store_flush_all (void)
+{
+  if (pending == NULL)
+    return;
+
+  while (g_hash_table_size (pending) > 0)
+    {
+      GHashTableIter iter;
+      gpointer value;
+
+      g_hash_table_iter_init (&iter, pending);
+      g_hash_table_iter_next (&iter, NULL, &value);
+      file_store_queue (value);
+    }
+
+  file_store_wait ();
+}
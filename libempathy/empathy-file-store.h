@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_FILE_STORE_H__
+#define __EMPATHY_FILE_STORE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * EmpathyFileStoreFunc:
+ * @length: (out): where to store the length of the returned contents
+ * @user_data: the data passed to empathy_file_store_schedule()
+ *
+ * Called in the main thread when the file is about to be written.
+ *
+ * Returns: the newly allocated contents of the file, or %NULL to leave the
+ * file alone
+ */
+typedef gchar * (*EmpathyFileStoreFunc) (gsize *length,
+    gpointer user_data);
+
+void empathy_file_store_schedule (const gchar *filename,
+    guint delay,
+    EmpathyFileStoreFunc func,
+    gpointer user_data);
+void empathy_file_store_flush (const gchar *filename);
+void empathy_file_store_flush_all (void);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_FILE_STORE_H__ */
@@ -29,6 +29,7 @@
 #include <telepathy-glib/interfaces.h>
 
 #include "empathy-ft-handler.h"
+#include "empathy-ft-handler-internal.h"
 #include "empathy-tp-contact-factory.h"
 #include "empathy-time.h"
 #include "empathy-utils.h"
@@ -73,7 +74,11 @@ G_DEFINE_TYPE (EmpathyFTHandler, empathy_ft_handler, G_TYPE_OBJECT)
 
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyFTHandler)
 
-#define BUFFER_SIZE 4096
+/* Files are hashed by chunks of that size, read into a single buffer */
+#define HASH_BUFFER_SIZE (1024 * 1024)
+
+/* Minimum time between two ::hashing-progress, in microseconds */
+#define HASH_PROGRESS_INTERVAL (G_USEC_PER_SEC / 10)
 
 enum {
   PROP_CHANNEL = 1,
@@ -104,11 +109,19 @@ typedef struct {
   GError *error /* comment to make the style checker happy */;
   guchar *buffer;
   GChecksum *checksum;
-  gssize total_read;
+  guint64 total_read;
   guint64 total_bytes;
+  /* Of the file being read, if known */
+  guint64 inode;
   EmpathyFTHandler *handler;
 } HashingData;
 
+typedef struct {
+  EmpathyFTHandler *handler;
+  guint64 current_bytes;
+  guint64 total_bytes;
+} HashingProgress;
+
 typedef struct {
   EmpathyFTHandlerReadyCallback callback;
   gpointer user_data;
@@ -146,12 +159,25 @@ typedef struct {
   gint64 last_update_time;
 
   gboolean is_completed;
+
+  /* incoming: the destination is hashed while it's being written, so only
+   * its end has to be read once the transfer is completed. */
+  HashingData *stream_hash;
+  gboolean stream_hash_running;
+  gboolean stream_hash_failed;
+  /* the transfer completed while a chunk was being hashed */
+  gboolean stream_hash_completed;
 } EmpathyFTHandlerPriv;
 
 static guint signals[LAST_SIGNAL] = { 0 };
 
 static gboolean do_hash_job_incoming (GIOSchedulerJob *job,
     GCancellable *cancellable, gpointer user_data);
+static gboolean do_hash_job_streamed (GIOSchedulerJob *job,
+    GCancellable *cancellable, gpointer user_data);
+static gboolean do_hash_job_streaming (GIOSchedulerJob *job,
+    GCancellable *cancellable, gpointer user_data);
+static void hash_data_free (HashingData *data);
 
 /* GObject implementations */
 static void
@@ -281,6 +307,13 @@ do_dispose (GObject *object)
       priv->request = NULL;
     }
 
+  /* a running job frees it when it's done */
+  if (priv->stream_hash != NULL && !priv->stream_hash_running)
+    {
+      hash_data_free (priv->stream_hash);
+      priv->stream_hash = NULL;
+    }
+
   G_OBJECT_CLASS (empathy_ft_handler_parent_class)->dispose (object);
 }
 
@@ -599,24 +632,78 @@ tp_file_hash_to_g_checksum (TpFileHashType type)
   return retval;
 }
 
+static HashingData *
+hash_data_new_incoming (EmpathyFTHandler *handler)
+{
+  HashingData *hash_data;
+  EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
+
+  hash_data = g_slice_new0 (HashingData);
+  hash_data->total_bytes = priv->total_bytes;
+  hash_data->checksum = g_checksum_new
+    (tp_file_hash_to_g_checksum (priv->content_hash_type));
+
+  return hash_data;
+}
+
 static void
-check_hash_incoming (EmpathyFTHandler *handler)
+hash_incoming_finish (EmpathyFTHandler *handler)
 {
   HashingData *hash_data;
   EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
 
-  if (!EMP_STR_EMPTY (priv->content_hash))
+  if (priv->stream_hash != NULL)
     {
-      hash_data = g_slice_new0 (HashingData);
-      hash_data->total_bytes = priv->total_bytes;
+      /* only what was written since the last chunk is left to read */
+      hash_data = priv->stream_hash;
+      priv->stream_hash = NULL;
       hash_data->handler = g_object_ref (handler);
-      hash_data->checksum = g_checksum_new
-        (tp_file_hash_to_g_checksum (priv->content_hash_type));
 
+      g_io_scheduler_push_job (do_hash_job_streamed, hash_data, NULL,
+                               G_PRIORITY_DEFAULT, priv->cancellable);
+      return;
+    }
+
+  hash_data = hash_data_new_incoming (handler);
+  hash_data->handler = g_object_ref (handler);
+
+  g_io_scheduler_push_job (do_hash_job_incoming, hash_data, NULL,
+                           G_PRIORITY_DEFAULT, priv->cancellable);
+}
+
+static void
+hash_incoming_continue (EmpathyFTHandler *handler)
+{
+  EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
+
+  if (priv->stream_hash_failed || priv->stream_hash_running ||
+      priv->is_completed || EMP_STR_EMPTY (priv->content_hash))
+    return;
+
+  if (priv->stream_hash == NULL)
+    priv->stream_hash = hash_data_new_incoming (handler);
+
+  /* the data only refs the handler while a job is running */
+  priv->stream_hash->handler = g_object_ref (handler);
+  priv->stream_hash_running = TRUE;
+
+  g_io_scheduler_push_job (do_hash_job_streaming, priv->stream_hash, NULL,
+                           G_PRIORITY_DEFAULT, priv->cancellable);
+}
+
+static void
+check_hash_incoming (EmpathyFTHandler *handler)
+{
+  EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
+
+  if (!EMP_STR_EMPTY (priv->content_hash))
+    {
       g_signal_emit (handler, signals[HASHING_STARTED], 0);
 
-      g_io_scheduler_push_job (do_hash_job_incoming, hash_data, NULL,
-                               G_PRIORITY_DEFAULT, priv->cancellable);
+      if (priv->stream_hash_running)
+        priv->stream_hash_completed = TRUE;
+      else
+        hash_incoming_finish (handler);
     }
 }
 
@@ -687,6 +774,9 @@ ft_transfer_transferred_bytes_cb (TpFileTransferChannel *channel,
       g_signal_emit (handler, signals[TRANSFER_PROGRESS], 0,
           bytes, priv->total_bytes, priv->remaining_time,
           priv->speed);
+
+      if (priv->use_hash && empathy_ft_handler_is_incoming (handler))
+        hash_incoming_continue (handler);
     }
 }
 
@@ -958,52 +1048,96 @@ cleanup:
 static gboolean
 emit_hashing_progress (gpointer user_data)
 {
-  HashingData *hash_data = user_data;
+  HashingProgress *progress = user_data;
 
-  g_signal_emit (hash_data->handler, signals[HASHING_PROGRESS], 0,
-      (guint64) hash_data->total_read, (guint64) hash_data->total_bytes);
+  g_signal_emit (progress->handler, signals[HASHING_PROGRESS], 0,
+      progress->current_bytes, progress->total_bytes);
 
   return FALSE;
 }
 
+static void
+hashing_progress_free (gpointer user_data)
+{
+  HashingProgress *progress = user_data;
+
+  g_object_unref (progress->handler);
+  g_slice_free (HashingProgress, progress);
+}
+
+static void
+send_hashing_progress (GIOSchedulerJob *job,
+    HashingData *hash_data)
+{
+  HashingProgress *progress;
+
+  /* total_read keeps changing in the job's thread, send a copy */
+  progress = g_slice_new (HashingProgress);
+  progress->handler = g_object_ref (hash_data->handler);
+  progress->current_bytes = hash_data->total_read;
+  progress->total_bytes = hash_data->total_bytes;
+
+  g_io_scheduler_job_send_to_mainloop_async (job, emit_hashing_progress,
+      progress, hashing_progress_free);
+}
+
+/* Hashes the stream until its current end */
 static gboolean
-do_hash_job (GIOSchedulerJob *job,
+hash_stream_read (GIOSchedulerJob *job,
+    HashingData *hash_data,
+    gboolean report_progress,
     GCancellable *cancellable,
-    gpointer user_data)
+    GError **error)
 {
-  HashingData *hash_data = user_data;
   gssize bytes_read;
-  GError *error = NULL;
+  gint64 last_progress = 0;
+  guint64 last_progress_bytes = hash_data->total_read;
 
-again:
   if (hash_data->buffer == NULL)
-    hash_data->buffer = g_malloc0 (BUFFER_SIZE);
+    hash_data->buffer = g_malloc (HASH_BUFFER_SIZE);
 
-  bytes_read = g_input_stream_read (hash_data->stream, hash_data->buffer,
-                                    BUFFER_SIZE, cancellable, &error);
-  if (error != NULL)
-    goto out;
-
-  hash_data->total_read += bytes_read;
-
-  /* we now have the chunk */
-  if (bytes_read > 0)
+  while ((bytes_read = g_input_stream_read (hash_data->stream,
+              hash_data->buffer, HASH_BUFFER_SIZE, cancellable, error)) > 0)
     {
+      gint64 now;
+
+      hash_data->total_read += bytes_read;
       g_checksum_update (hash_data->checksum, hash_data->buffer, bytes_read);
-      g_io_scheduler_job_send_to_mainloop_async (job, emit_hashing_progress,
-          hash_data, NULL);
 
-      g_free (hash_data->buffer);
-      hash_data->buffer = NULL;
+      if (!report_progress)
+        continue;
 
-      goto again;
+      /* Don't flood the main loop, the UI can't show more anyway */
+      now = g_get_monotonic_time ();
+      if (now - last_progress >= HASH_PROGRESS_INTERVAL)
+        {
+          send_hashing_progress (job, hash_data);
+          last_progress = now;
+          last_progress_bytes = hash_data->total_read;
+        }
     }
-  else
-  {
+
+  if (bytes_read < 0)
+    return FALSE;
+
+  /* Always report the end of the file */
+  if (report_progress && last_progress_bytes != hash_data->total_read)
+    send_hashing_progress (job, hash_data);
+
+  return TRUE;
+}
+
+static gboolean
+do_hash_job (GIOSchedulerJob *job,
+    GCancellable *cancellable,
+    gpointer user_data)
+{
+  HashingData *hash_data = user_data;
+  GError *error = NULL;
+
+  if (hash_stream_read (job, hash_data, TRUE, cancellable, &error))
     g_input_stream_close (hash_data->stream, cancellable, &error);
-  }
 
-out:
   if (error != NULL)
     hash_data->error = error;
 
@@ -1040,6 +1174,136 @@ do_hash_job_incoming (GIOSchedulerJob *job,
   return do_hash_job (job, cancellable, user_data);
 }
 
+static gboolean
+hash_chunk_done (gpointer user_data)
+{
+  HashingData *hash_data = user_data;
+  EmpathyFTHandler *handler = hash_data->handler;
+  EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
+
+  /* we keep the job's ref until the end of this function */
+  hash_data->handler = NULL;
+  priv->stream_hash_running = FALSE;
+
+  if (hash_data->error != NULL)
+    {
+      /* the destination may not have been created yet, try again later */
+      if (!g_error_matches (hash_data->error, G_IO_ERROR,
+              G_IO_ERROR_NOT_FOUND))
+        {
+          DEBUG ("Can't hash the file while it's transferred, it will be "
+              "read again once completed: %s", hash_data->error->message);
+
+          priv->stream_hash_failed = TRUE;
+          priv->stream_hash = NULL;
+          hash_data_free (hash_data);
+        }
+      else
+        {
+          g_clear_error (&hash_data->error);
+        }
+    }
+
+  if (priv->dispose_run)
+    {
+      if (priv->stream_hash != NULL)
+        hash_data_free (priv->stream_hash);
+      priv->stream_hash = NULL;
+    }
+  else if (priv->stream_hash_completed)
+    {
+      hash_incoming_finish (handler);
+    }
+
+  g_object_unref (handler);
+
+  return FALSE;
+}
+
+static gboolean
+hash_stream_open (HashingData *hash_data,
+    GCancellable *cancellable,
+    GError **error)
+{
+  EmpathyFTHandlerPriv *priv = GET_PRIV (hash_data->handler);
+  GFileInputStream *stream;
+  GFileInfo *info;
+
+  stream = g_file_read (priv->gfile, cancellable, error);
+  if (stream == NULL)
+    return FALSE;
+
+  info = g_file_input_stream_query_info (stream, G_FILE_ATTRIBUTE_UNIX_INODE,
+      cancellable, NULL);
+  if (info != NULL)
+    {
+      hash_data->inode = g_file_info_get_attribute_uint64 (info,
+          G_FILE_ATTRIBUTE_UNIX_INODE);
+      g_object_unref (info);
+    }
+
+  hash_data->stream = G_INPUT_STREAM (stream);
+
+  return TRUE;
+}
+
+static gboolean
+do_hash_job_streaming (GIOSchedulerJob *job,
+    GCancellable *cancellable,
+    gpointer user_data)
+{
+  HashingData *hash_data = user_data;
+  GError *error = NULL;
+
+  if (hash_data->stream != NULL ||
+      hash_stream_open (hash_data, cancellable, &error))
+    hash_stream_read (job, hash_data, FALSE, cancellable, &error);
+
+  if (error != NULL)
+    hash_data->error = error;
+
+  g_io_scheduler_job_send_to_mainloop_async (job, hash_chunk_done,
+      hash_data, NULL);
+
+  return FALSE;
+}
+
+static gboolean
+do_hash_job_streamed (GIOSchedulerJob *job,
+    GCancellable *cancellable,
+    gpointer user_data)
+{
+  HashingData *hash_data = user_data;
+  EmpathyFTHandlerPriv *priv = GET_PRIV (hash_data->handler);
+  GFileInfo *info;
+  guint64 inode = 0;
+
+  info = g_file_query_info (priv->gfile, G_FILE_ATTRIBUTE_UNIX_INODE,
+      G_FILE_QUERY_INFO_NONE, cancellable, NULL);
+  if (info != NULL)
+    {
+      inode = g_file_info_get_attribute_uint64 (info,
+          G_FILE_ATTRIBUTE_UNIX_INODE);
+      g_object_unref (info);
+    }
+
+  if (inode == 0 || inode != hash_data->inode)
+    {
+      /* We weren't reading the destination, for instance it was written to
+       * a temporary file which then replaced it. Start over. */
+      DEBUG ("Destination changed while it was hashed, reading it again");
+
+      g_clear_object (&hash_data->stream);
+      g_checksum_reset (hash_data->checksum);
+      hash_data->total_read = 0;
+      hash_data->inode = 0;
+
+      return do_hash_job_incoming (job, cancellable, user_data);
+    }
+
+  return do_hash_job (job, cancellable, user_data);
+}
+
 static void
 ft_handler_read_async_cb (GObject *source,
     GAsyncResult *res,
@@ -1066,12 +1330,12 @@ ft_handler_read_async_cb (GObject *source,
   hash_data->stream = G_INPUT_STREAM (stream);
   hash_data->total_bytes = priv->total_bytes;
   hash_data->handler = g_object_ref (handler);
-  /* FIXME: MD5 is the only ContentHashType supported right now */
-  hash_data->checksum = g_checksum_new (G_CHECKSUM_MD5);
+  hash_data->checksum = g_checksum_new (
+      tp_file_hash_to_g_checksum (priv->content_hash_type));
 
   tp_asv_set_uint32 (priv->request,
       TP_PROP_CHANNEL_TYPE_FILE_TRANSFER_CONTENT_HASH_TYPE,
-      TP_FILE_HASH_TYPE_MD5);
+      priv->content_hash_type);
 
   g_signal_emit (handler, signals[HASHING_STARTED], 0);
 
@@ -1090,6 +1354,65 @@ callbacks_data_free (gpointer user_data)
   g_slice_free (CallbacksData, data);
 }
 
+/* How expensive hashing a file is with each TpFileHashType, relatively to
+ * each other; see /ft-hash/benchmark. 0 if we can't compute it. */
+static guint
+hash_type_get_cost (TpFileHashType type)
+{
+  switch (type)
+    {
+      case TP_FILE_HASH_TYPE_MD5:
+        return 1;
+      case TP_FILE_HASH_TYPE_SHA1:
+        return 2;
+      case TP_FILE_HASH_TYPE_SHA256:
+        return 3;
+      case TP_FILE_HASH_TYPE_NONE:
+      default:
+        return 0;
+    }
+}
+
+/* Whether the protocol already makes sure files arrive intact, making
+ * hashing them only a waste of time */
+static gboolean
+ft_handler_needs_hash (const gchar *protocol)
+{
+  /* link-local XMPP: a direct TCP connection on the local network */
+  return tp_strdiff (protocol, "local-xmpp");
+}
+
+/* Returns: the cheapest of the @offered hash types which we can compute, or
+ * %TP_FILE_HASH_TYPE_NONE if there are none or if @protocol doesn't need
+ * one */
+TpFileHashType
+_empathy_ft_handler_choose_hash_type (const gchar *protocol,
+    GArray *offered)
+{
+  TpFileHashType chosen = TP_FILE_HASH_TYPE_NONE;
+  guint i, cost = 0;
+
+  for (i = 0; i < offered->len; i++)
+    {
+      TpFileHashType type = g_array_index (offered, guint, i);
+      guint type_cost = hash_type_get_cost (type);
+
+      if (type_cost != 0 && (cost == 0 || type_cost < cost))
+        {
+          chosen = type;
+          cost = type_cost;
+        }
+    }
+
+  if (chosen != TP_FILE_HASH_TYPE_NONE && !ft_handler_needs_hash (protocol))
+    {
+      DEBUG ("Not hashing the file, the protocol doesn't need it");
+      chosen = TP_FILE_HASH_TYPE_NONE;
+    }
+
+  return chosen;
+}
+
 static gboolean
 set_content_hash_type_from_classes (EmpathyFTHandler *handler,
     GPtrArray *classes)
@@ -1099,6 +1422,7 @@ set_content_hash_type_from_classes (EmpathyFTHandler *handler,
   gboolean valid;
   EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
   gboolean support_ft = FALSE;
+  TpAccount *account;
   guint i;
 
   possible_values = g_array_new (TRUE, TRUE, sizeof (guint));
@@ -1137,35 +1461,14 @@ set_content_hash_type_from_classes (EmpathyFTHandler *handler,
       return FALSE;
     }
 
-  if (possible_values->len == 0)
-    {
-      /* there are no channel classes with hash support, disable it. */
-      priv->use_hash = FALSE;
-      priv->content_hash_type = TP_FILE_HASH_TYPE_NONE;
-
-      goto out;
-    }
-
-  priv->use_hash = TRUE;
-
-  if (possible_values->len == 1)
-    {
-      priv->content_hash_type = g_array_index (possible_values, guint, 0);
-    }
-  else
-    {
-      /* order the array and pick the first non zero, so that MD5
-       * is the preferred value.
-       */
-      g_array_sort (possible_values, empathy_uint_compare);
+  /* pick the cheapest hash type we know, or disable it if there are no
+   * channel classes with hash support we can use, or if it isn't worth it */
+  account = empathy_contact_get_account (priv->contact);
+  priv->content_hash_type = _empathy_ft_handler_choose_hash_type (
+      tp_account_get_protocol (account), possible_values);
 
-      if (g_array_index (possible_values, guint, 0) == 0)
-        priv->content_hash_type = g_array_index (possible_values, guint, 1);
-      else
-        priv->content_hash_type = g_array_index (possible_values, guint, 0);
-    }
+  priv->use_hash = (priv->content_hash_type != TP_FILE_HASH_TYPE_NONE);
 
-out:
   g_array_unref (possible_values);
 
   DEBUG ("Hash enabled %s; setting content hash type as %u",
@@ -1544,7 +1847,7 @@ empathy_ft_handler_incoming_set_destination (EmpathyFTHandler *handler,
    * anyway, so that clients won't be expecting us to checksum.
    */
   if (EMP_STR_EMPTY (priv->content_hash) ||
-      priv->content_hash_type == TP_FILE_HASH_TYPE_NONE)
+      hash_type_get_cost (priv->content_hash_type) == 0)
     priv->use_hash = FALSE;
   else
     priv->use_hash = TRUE;
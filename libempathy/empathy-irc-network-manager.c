@@ -25,6 +25,11 @@
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 
+#include <glib/gstdio.h>
+
+#include <telepathy-glib/util.h>
+
+#include "empathy-file-store.h"
 #include "empathy-utils.h"
 #include "empathy-irc-network-manager.h"
 
@@ -35,20 +40,26 @@
 #define IRC_NETWORKS_FILENAME "irc-networks.xml"
 #define SAVE_TIMER 4
 
+/* Parsed global file: (version, path, mtime, size,
+ * [(id, name, charset, [(address, port, ssl)])]) */
+#define GLOBAL_CACHE_VERSION 1
+#define GLOBAL_CACHE_TYPE "(usxta(sssa(sqb)))"
+
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyIrcNetworkManager)
 typedef struct {
   GHashTable *networks;
+  /* server address -> borrowed EmpathyIrcNetwork, built on demand */
+  GHashTable *address_index;
+  gboolean address_index_valid;
 
   gchar *global_file;
   gchar *user_file;
   guint last_id;
 
-  /* Do we have to save modifications to the user file ? */
-  gboolean have_to_save;
   /* Are we loading networks from XML files ? */
   gboolean loading;
-  /* source id of the autosave timer */
-  gint save_timer_id;
+  /* Files are only loaded when the networks are first needed */
+  gboolean loaded;
 } EmpathyIrcNetworkManagerPriv;
 
 /* properties */
@@ -62,13 +73,13 @@ enum
 G_DEFINE_TYPE (EmpathyIrcNetworkManager, empathy_irc_network_manager,
     G_TYPE_OBJECT);
 
-static void irc_network_manager_load_servers (
+static void irc_network_manager_ensure_loaded (
     EmpathyIrcNetworkManager *manager);
 static gboolean irc_network_manager_file_parse (
     EmpathyIrcNetworkManager *manager, const gchar *filename,
     gboolean user_defined);
-static gboolean irc_network_manager_file_save (
-    EmpathyIrcNetworkManager *manager);
+static gchar *irc_network_manager_serialize (gsize *length,
+    gpointer user_data);
 
 static void
 empathy_irc_network_manager_get_property (GObject *object,
@@ -118,44 +129,21 @@ empathy_irc_network_manager_set_property (GObject *object,
     }
 }
 
-static GObject *
-empathy_irc_network_manager_constructor (GType type,
-                                         guint n_props,
-                                         GObjectConstructParam *props)
-{
-  GObject *obj;
-  EmpathyIrcNetworkManager *self;
-
-  /* Parent constructor chain */
-  obj = G_OBJECT_CLASS (empathy_irc_network_manager_parent_class)->
-        constructor (type, n_props, props);
-
-  self = EMPATHY_IRC_NETWORK_MANAGER (obj);
-  irc_network_manager_load_servers (self);
-
-  return obj;
-}
-
 static void
 empathy_irc_network_manager_finalize (GObject *object)
 {
   EmpathyIrcNetworkManager *self = EMPATHY_IRC_NETWORK_MANAGER (object);
   EmpathyIrcNetworkManagerPriv *priv = GET_PRIV (self);
 
-  if (priv->save_timer_id > 0)
-    {
-      g_source_remove (priv->save_timer_id);
-    }
-
-  if (priv->have_to_save)
-    {
-      irc_network_manager_file_save (self);
-    }
+  /* Modifications are saved while the networks are still around */
+  if (priv->user_file != NULL)
+    empathy_file_store_flush (priv->user_file);
 
   g_free (priv->global_file);
   g_free (priv->user_file);
 
   g_hash_table_unref (priv->networks);
+  g_hash_table_unref (priv->address_index);
 
   G_OBJECT_CLASS (empathy_irc_network_manager_parent_class)->finalize (object);
 }
@@ -170,12 +158,12 @@ empathy_irc_network_manager_init (EmpathyIrcNetworkManager *self)
 
   priv->networks = g_hash_table_new_full (g_str_hash, g_str_equal,
       (GDestroyNotify) g_free, (GDestroyNotify) g_object_unref);
+  priv->address_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
 
   priv->last_id = 0;
 
-  priv->have_to_save = FALSE;
   priv->loading = FALSE;
-  priv->save_timer_id = 0;
 }
 
 static void
@@ -184,7 +172,6 @@ empathy_irc_network_manager_class_init (EmpathyIrcNetworkManagerClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   GParamSpec *param_spec;
 
-  object_class->constructor = empathy_irc_network_manager_constructor;
   object_class->get_property = empathy_irc_network_manager_get_property;
   object_class->set_property = empathy_irc_network_manager_set_property;
 
@@ -242,29 +229,19 @@ empathy_irc_network_manager_new (const gchar *global_file,
   return manager;
 }
 
-static gboolean
-save_timeout (EmpathyIrcNetworkManager *self)
-{
-  EmpathyIrcNetworkManagerPriv *priv = GET_PRIV (self);
-
-  priv->save_timer_id = 0;
-  irc_network_manager_file_save (self);
-
-  return FALSE;
-}
-
 static void
-reset_save_timeout (EmpathyIrcNetworkManager *self)
+irc_network_manager_schedule_save (EmpathyIrcNetworkManager *self)
 {
   EmpathyIrcNetworkManagerPriv *priv = GET_PRIV (self);
 
-  if (priv->save_timer_id > 0)
+  if (priv->user_file == NULL)
     {
-      g_source_remove (priv->save_timer_id);
+      DEBUG ("can't save: no user file defined");
+      return;
     }
 
-  priv->save_timer_id = g_timeout_add_seconds (SAVE_TIMER,
-      (GSourceFunc) save_timeout, self);
+  empathy_file_store_schedule (priv->user_file, SAVE_TIMER,
+      irc_network_manager_serialize, self);
 }
 
 static void
@@ -274,12 +251,10 @@ network_modified (EmpathyIrcNetwork *network,
   EmpathyIrcNetworkManagerPriv *priv = GET_PRIV (self);
 
   network->user_defined = TRUE;
+  priv->address_index_valid = FALSE;
 
   if (!priv->loading)
-    {
-      priv->have_to_save = TRUE;
-      reset_save_timeout (self);
-    }
+    irc_network_manager_schedule_save (self);
 }
 
 static void
@@ -290,6 +265,7 @@ add_network (EmpathyIrcNetworkManager *self,
   EmpathyIrcNetworkManagerPriv *priv = GET_PRIV (self);
 
   g_hash_table_insert (priv->networks, g_strdup (id), g_object_ref (network));
+  priv->address_index_valid = FALSE;
 
   g_signal_connect (network, "modified", G_CALLBACK (network_modified), self);
 }
@@ -314,6 +290,8 @@ empathy_irc_network_manager_add (EmpathyIrcNetworkManager *self,
 
   priv = GET_PRIV (self);
 
+  irc_network_manager_ensure_loaded (self);
+
   /* generate an id for this network */
   do
     {
@@ -333,8 +311,7 @@ empathy_irc_network_manager_add (EmpathyIrcNetworkManager *self,
   network->user_defined = TRUE;
   add_network (self, network, id);
 
-  priv->have_to_save = TRUE;
-  reset_save_timeout (self);
+  irc_network_manager_schedule_save (self);
 
   g_free (id);
 }
@@ -358,11 +335,13 @@ empathy_irc_network_manager_remove (EmpathyIrcNetworkManager *self,
 
   priv = GET_PRIV (self);
 
+  irc_network_manager_ensure_loaded (self);
+
   network->user_defined = TRUE;
   network->dropped = TRUE;
+  priv->address_index_valid = FALSE;
 
-  priv->have_to_save = TRUE;
-  reset_save_timeout (self);
+  irc_network_manager_schedule_save (self);
 }
 
 static void
@@ -398,6 +377,8 @@ get_network_list (EmpathyIrcNetworkManager *self,
 
   priv = GET_PRIV (self);
 
+  irc_network_manager_ensure_loaded (self);
+
   if (get_active)
     {
       g_hash_table_foreach (priv->networks,
@@ -446,21 +427,208 @@ empathy_irc_network_manager_get_dropped_networks (EmpathyIrcNetworkManager *self
  * API to save/load and parse the irc_networks file.
  */
 
+static gchar *
+global_cache_get_filename (const gchar *global_file)
+{
+  gchar *checksum, *basename, *filename;
+
+  /* Tests use other global files than the installed one */
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, global_file, -1);
+  basename = g_strdup_printf ("irc-networks-%s.cache", checksum);
+  filename = g_build_filename (g_get_user_cache_dir (), PACKAGE_NAME,
+      basename, NULL);
+
+  g_free (checksum);
+  g_free (basename);
+
+  return filename;
+}
+
+static gboolean
+load_global_cache (EmpathyIrcNetworkManager *self,
+    const gchar *cache_file,
+    GStatBuf *global_stat)
+{
+  EmpathyIrcNetworkManagerPriv *priv = GET_PRIV (self);
+  GMappedFile *mapped;
+  GVariant *cache, *networks;
+  GVariantIter iter;
+  const gchar *path, *id, *name, *charset;
+  GVariant *servers;
+  guint32 version;
+  gint64 mtime;
+  guint64 size;
+
+  mapped = g_mapped_file_new (cache_file, FALSE, NULL);
+  if (mapped == NULL)
+    return FALSE;
+
+  /* Not trusted: a corrupted cache gives default values, not a crash */
+  cache = g_variant_new_from_data (G_VARIANT_TYPE (GLOBAL_CACHE_TYPE),
+      g_mapped_file_get_contents (mapped), g_mapped_file_get_length (mapped),
+      FALSE, (GDestroyNotify) g_mapped_file_unref, mapped);
+  g_variant_ref_sink (cache);
+
+  g_variant_get (cache, "(u&sxt@a(sssa(sqb)))", &version, &path, &mtime,
+      &size, &networks);
+
+  if (version != GLOBAL_CACHE_VERSION ||
+      tp_strdiff (path, priv->global_file) ||
+      mtime != (gint64) global_stat->st_mtime ||
+      size != (guint64) global_stat->st_size)
+    {
+      DEBUG ("Cache %s is out of date", cache_file);
+      g_variant_unref (networks);
+      g_variant_unref (cache);
+      return FALSE;
+    }
+
+  DEBUG ("Loading global networks from %s", cache_file);
+
+  g_variant_iter_init (&iter, networks);
+  while (g_variant_iter_loop (&iter, "(&s&s&s@a(sqb))", &id, &name,
+        &charset, &servers))
+    {
+      EmpathyIrcNetwork *network;
+      GVariantIter servers_iter;
+      const gchar *address;
+      guint16 port;
+      gboolean ssl;
+
+      network = empathy_irc_network_new (name);
+      if (charset[0] != '\0')
+        g_object_set (network, "charset", charset, NULL);
+
+      add_network (self, network, id);
+
+      g_variant_iter_init (&servers_iter, servers);
+      while (g_variant_iter_next (&servers_iter, "(&sqb)", &address, &port,
+            &ssl))
+        {
+          EmpathyIrcServer *server;
+
+          server = empathy_irc_server_new (address, port, ssl);
+          empathy_irc_network_append_server (network, server);
+          g_object_unref (server);
+        }
+
+      network->user_defined = FALSE;
+      g_object_unref (network);
+    }
+
+  g_variant_unref (networks);
+  g_variant_unref (cache);
+
+  return TRUE;
+}
+
+static void
+add_network_to_cache (const gchar *id,
+    EmpathyIrcNetwork *network,
+    GVariantBuilder *builder)
+{
+  GSList *servers, *l;
+  gchar *name, *charset;
+
+  g_object_get (network,
+      "name", &name,
+      "charset", &charset,
+      NULL);
+
+  g_variant_builder_open (builder, G_VARIANT_TYPE ("(sssa(sqb))"));
+  g_variant_builder_add (builder, "s", id);
+  g_variant_builder_add (builder, "s", name != NULL ? name : "");
+  g_variant_builder_add (builder, "s", charset != NULL ? charset : "");
+
+  g_variant_builder_open (builder, G_VARIANT_TYPE ("a(sqb)"));
+
+  servers = empathy_irc_network_get_servers (network);
+  for (l = servers; l != NULL; l = g_slist_next (l))
+    {
+      gchar *address;
+      guint port;
+      gboolean ssl;
+
+      g_object_get (l->data,
+          "address", &address,
+          "port", &port,
+          "ssl", &ssl,
+          NULL);
+
+      g_variant_builder_add (builder, "(sqb)", address != NULL ? address : "",
+          (guint16) port, ssl);
+      g_free (address);
+    }
+
+  g_variant_builder_close (builder);
+  g_variant_builder_close (builder);
+
+  g_slist_foreach (servers, (GFunc) g_object_unref, NULL);
+  g_slist_free (servers);
+  g_free (name);
+  g_free (charset);
+}
+
+/* Called right after parsing the global file, so all the networks come
+ * from it */
+static void
+save_global_cache (EmpathyIrcNetworkManager *self,
+    const gchar *cache_file,
+    GStatBuf *global_stat)
+{
+  EmpathyIrcNetworkManagerPriv *priv = GET_PRIV (self);
+  GVariantBuilder builder;
+  GVariant *cache;
+  gchar *dir;
+  GError *error = NULL;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sssa(sqb))"));
+  g_hash_table_foreach (priv->networks, (GHFunc) add_network_to_cache,
+      &builder);
+
+  cache = g_variant_new ("(usxt@a(sssa(sqb)))", GLOBAL_CACHE_VERSION,
+      priv->global_file, (gint64) global_stat->st_mtime,
+      (guint64) global_stat->st_size, g_variant_builder_end (&builder));
+  g_variant_ref_sink (cache);
+
+  dir = g_path_get_dirname (cache_file);
+  g_mkdir_with_parents (dir, S_IRUSR | S_IWUSR | S_IXUSR);
+  g_free (dir);
+
+  if (!g_file_set_contents (cache_file, g_variant_get_data (cache),
+          g_variant_get_size (cache), &error))
+    {
+      DEBUG ("Failed to save %s: %s", cache_file, error->message);
+      g_error_free (error);
+    }
+
+  g_variant_unref (cache);
+}
+
 static void
 load_global_file (EmpathyIrcNetworkManager *self)
 {
   EmpathyIrcNetworkManagerPriv *priv = GET_PRIV (self);
+  GStatBuf global_stat;
+  gchar *cache_file;
 
   if (priv->global_file == NULL)
     return;
 
-  if (!g_file_test (priv->global_file, G_FILE_TEST_EXISTS))
+  if (g_stat (priv->global_file, &global_stat) != 0)
     {
       DEBUG ("Global networks file %s doesn't exist", priv->global_file);
       return;
     }
 
-  irc_network_manager_file_parse (self, priv->global_file, FALSE);
+  /* The global file is big and only changes when Empathy is upgraded */
+  cache_file = global_cache_get_filename (priv->global_file);
+
+  if (!load_global_cache (self, cache_file, &global_stat) &&
+      irc_network_manager_file_parse (self, priv->global_file, FALSE))
+    save_global_cache (self, cache_file, &global_stat);
+
+  g_free (cache_file);
 }
 
 static void
@@ -481,17 +649,20 @@ load_user_file (EmpathyIrcNetworkManager *self)
 }
 
 static void
-irc_network_manager_load_servers (EmpathyIrcNetworkManager *self)
+irc_network_manager_ensure_loaded (EmpathyIrcNetworkManager *self)
 {
   EmpathyIrcNetworkManagerPriv *priv = GET_PRIV (self);
 
+  if (priv->loaded)
+    return;
+
+  priv->loaded = TRUE;
   priv->loading = TRUE;
 
   load_global_file (self);
   load_user_file (self);
 
   priv->loading = FALSE;
-  priv->have_to_save = FALSE;
 }
 
 static void
@@ -731,18 +902,17 @@ write_network_to_xml (const gchar *id,
   g_slist_free (servers);
 }
 
-static gboolean
-irc_network_manager_file_save (EmpathyIrcNetworkManager *self)
+static gchar *
+irc_network_manager_serialize (gsize *length,
+    gpointer user_data)
 {
+  EmpathyIrcNetworkManager *self = user_data;
   EmpathyIrcNetworkManagerPriv *priv = GET_PRIV (self);
   xmlDocPtr doc;
   xmlNodePtr root;
-
-  if (priv->user_file == NULL)
-    {
-      DEBUG ("can't save: no user file defined");
-      return FALSE;
-    }
+  xmlChar *buffer;
+  gint size;
+  gchar *content;
 
   DEBUG ("Saving IRC networks");
 
@@ -755,44 +925,43 @@ irc_network_manager_file_save (EmpathyIrcNetworkManager *self)
   /* Make sure the XML is indented properly */
   xmlIndentTreeOutput = 1;
 
-  xmlSaveFormatFileEnc (priv->user_file, doc, "utf-8", 1);
+  xmlDocDumpFormatMemoryEnc (doc, &buffer, &size, "utf-8", 1);
   xmlFreeDoc (doc);
 
-  xmlMemoryDump ();
+  content = g_strndup ((const gchar *) buffer, size);
+  *length = size;
+  xmlFree (buffer);
 
-  priv->have_to_save = FALSE;
-
-  return TRUE;
+  return content;
 }
 
-static gboolean
-find_network_by_address (const gchar *id,
-                         EmpathyIrcNetwork *network,
-                         const gchar *address)
+static void
+index_network_addresses (const gchar *id,
+    EmpathyIrcNetwork *network,
+    GHashTable *address_index)
 {
   GSList *servers, *l;
-  gboolean found = FALSE;
 
   if (network->dropped)
-    return FALSE;
+    return;
 
   servers = empathy_irc_network_get_servers (network);
 
-  for (l = servers; l != NULL && !found; l = g_slist_next (l))
+  for (l = servers; l != NULL; l = g_slist_next (l))
     {
-      EmpathyIrcServer *server = l->data;
-      gchar *_address;
+      gchar *address;
 
-      g_object_get (server, "address", &_address, NULL);
-      found = (_address != NULL && strcmp (address, _address) == 0);
+      g_object_get (l->data, "address", &address, NULL);
 
-      g_free (_address);
+      if (address != NULL &&
+          g_hash_table_lookup (address_index, address) == NULL)
+        g_hash_table_insert (address_index, address, network);
+      else
+        g_free (address);
     }
 
   g_slist_foreach (servers, (GFunc) g_object_unref, NULL);
   g_slist_free (servers);
-
-  return found;
 }
 
 /**
@@ -811,14 +980,21 @@ empathy_irc_network_manager_find_network_by_address (
     const gchar *address)
 {
   EmpathyIrcNetworkManagerPriv *priv = GET_PRIV (self);
-  EmpathyIrcNetwork *network;
 
   g_return_val_if_fail (address != NULL, NULL);
 
-  network = g_hash_table_find (priv->networks,
-      (GHRFunc) find_network_by_address, (gchar *) address);
+  irc_network_manager_ensure_loaded (self);
+
+  /* Rebuilt after networks or servers changed */
+  if (!priv->address_index_valid)
+    {
+      g_hash_table_remove_all (priv->address_index);
+      g_hash_table_foreach (priv->networks,
+          (GHFunc) index_network_addresses, priv->address_index);
+      priv->address_index_valid = TRUE;
+    }
 
-  return network;
+  return g_hash_table_lookup (priv->address_index, address);
 }
 
 EmpathyIrcNetworkManager *
@@ -34,6 +34,7 @@
 
 #include <telepathy-glib/util.h>
 
+#include "empathy-file-store.h"
 #include "empathy-utils.h"
 #include "empathy-status-presets.h"
 
@@ -169,6 +170,14 @@ empathy_status_presets_get_all (void)
 	gchar *dir;
 	gchar *file_with_path;
 
+	dir = g_build_filename (g_get_user_config_dir (), PACKAGE_NAME, NULL);
+	g_mkdir_with_parents (dir, S_IRUSR | S_IWUSR | S_IXUSR);
+	file_with_path = g_build_filename (dir, STATUS_PRESETS_XML_FILENAME, NULL);
+	g_free (dir);
+
+	/* Don't read it back before the last changes are written */
+	empathy_file_store_flush (file_with_path);
+
 	/* If already set up clean up first. */
 	if (presets) {
 		g_list_foreach (presets, (GFunc) status_preset_free, NULL);
@@ -176,11 +185,6 @@ empathy_status_presets_get_all (void)
 		presets = NULL;
 	}
 
-	dir = g_build_filename (g_get_user_config_dir (), PACKAGE_NAME, NULL);
-	g_mkdir_with_parents (dir, S_IRUSR | S_IWUSR | S_IXUSR);
-	file_with_path = g_build_filename (dir, STATUS_PRESETS_XML_FILENAME, NULL);
-	g_free (dir);
-
 	if (g_file_test (file_with_path, G_FILE_TEST_EXISTS)) {
 		status_presets_file_parse (file_with_path);
 	}
@@ -188,14 +192,16 @@ empathy_status_presets_get_all (void)
 	g_free (file_with_path);
 }
 
-static gboolean
-status_presets_file_save (void)
+static gchar *
+status_presets_serialize (gsize    *length,
+			  gpointer  user_data)
 {
 	xmlDocPtr   doc;
 	xmlNodePtr  root;
 	GList      *l;
-	gchar      *dir;
-	gchar      *file;
+	xmlChar    *buffer;
+	gint        size;
+	gchar      *content;
 	gint        count[NUM_TP_CONNECTION_PRESENCE_TYPES];
 	gint        i;
 
@@ -203,11 +209,6 @@ status_presets_file_save (void)
 		count[i] = 0;
 	}
 
-	dir = g_build_filename (g_get_user_config_dir (), PACKAGE_NAME, NULL);
-	g_mkdir_with_parents (dir, S_IRUSR | S_IWUSR | S_IXUSR);
-	file = g_build_filename (dir, STATUS_PRESETS_XML_FILENAME, NULL);
-	g_free (dir);
-
 	doc = xmlNewDoc ((const xmlChar *) "1.0");
 	root = xmlNewNode (NULL, (const xmlChar *) "presets");
 	xmlDocSetRootElement (doc, root);
@@ -244,10 +245,26 @@ status_presets_file_save (void)
 	/* Make sure the XML is indented properly */
 	xmlIndentTreeOutput = 1;
 
-	DEBUG ("Saving file:'%s'", file);
-	xmlSaveFormatFileEnc (file, doc, "utf-8", 1);
+	xmlDocDumpFormatMemoryEnc (doc, &buffer, &size, "utf-8", 1);
 	xmlFreeDoc (doc);
 
+	content = g_strndup ((const gchar *) buffer, size);
+	*length = size;
+	xmlFree (buffer);
+
+	return content;
+}
+
+static gboolean
+status_presets_file_save (void)
+{
+	gchar *file;
+
+	file = g_build_filename (g_get_user_config_dir (), PACKAGE_NAME,
+				 STATUS_PRESETS_XML_FILENAME, NULL);
+
+	empathy_file_store_schedule (file, 1, status_presets_serialize, NULL);
+
 	g_free (file);
 
 	return TRUE;
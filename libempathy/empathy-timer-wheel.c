@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include "empathy-timer-wheel.h"
+#include "empathy-timer-wheel-internal.h"
+
+/* Expires items a fixed number of seconds after they were added, using a
+ * single main loop source ticking every second instead of one source per
+ * item. Items added between two ticks share a slot and expire together.
+ *
+ * The source only runs while the wheel holds items. */
+
+struct _EmpathyTimerWheel
+{
+  /* Ring of n_slots GPtrArray, the slot at 'current' expired last */
+  GPtrArray **slots;
+  guint n_slots;
+  guint current;
+  guint n_items;
+
+  guint source_id;
+
+  EmpathyTimerWheelFunc func;
+  gpointer user_data;
+  GDestroyNotify item_destroy;
+};
+
+static void
+timer_wheel_free_items (EmpathyTimerWheel *wheel,
+    GPtrArray *items)
+{
+  if (wheel->item_destroy != NULL)
+    g_ptr_array_foreach (items, (GFunc) wheel->item_destroy, NULL);
+}
+
+/* Returns: whether the wheel still holds items */
+static gboolean
+timer_wheel_tick (EmpathyTimerWheel *wheel)
+{
+  GPtrArray *expired;
+
+  wheel->current = (wheel->current + 1) % wheel->n_slots;
+  expired = wheel->slots[wheel->current];
+
+  if (expired->len > 0)
+    {
+      /* Give the slot a fresh array, so the callback can add items again */
+      wheel->slots[wheel->current] = g_ptr_array_new ();
+      wheel->n_items -= expired->len;
+
+      wheel->func (expired, wheel->user_data);
+
+      timer_wheel_free_items (wheel, expired);
+      g_ptr_array_unref (expired);
+    }
+
+  return wheel->n_items > 0;
+}
+
+static gboolean
+timer_wheel_tick_cb (gpointer user_data)
+{
+  EmpathyTimerWheel *wheel = user_data;
+
+  if (timer_wheel_tick (wheel))
+    return TRUE;
+
+  wheel->source_id = 0;
+  return FALSE;
+}
+
+/* Ticks now rather than waiting for the source, so tests don't have to
+ * wait for seconds */
+void
+_empathy_timer_wheel_tick (EmpathyTimerWheel *wheel)
+{
+  g_return_if_fail (wheel != NULL);
+
+  if (!timer_wheel_tick (wheel) && wheel->source_id != 0)
+    {
+      g_source_remove (wheel->source_id);
+      wheel->source_id = 0;
+    }
+}
+
+/**
+ * empathy_timer_wheel_new:
+ * @timeout: the number of seconds items stay in the wheel
+ * @func: called with the items expiring at each tick
+ * @user_data: data to pass to @func
+ * @item_destroy: function to free the items, or %NULL
+ *
+ * Items are passed to @func between @timeout and @timeout + 1 seconds after
+ * they were added. Items still in the wheel when it is freed are passed to
+ * @item_destroy without expiring.
+ *
+ * Returns: a new #EmpathyTimerWheel
+ */
+EmpathyTimerWheel *
+empathy_timer_wheel_new (guint timeout,
+    EmpathyTimerWheelFunc func,
+    gpointer user_data,
+    GDestroyNotify item_destroy)
+{
+  EmpathyTimerWheel *wheel;
+  guint i;
+
+  g_return_val_if_fail (timeout > 0, NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+
+  wheel = g_slice_new0 (EmpathyTimerWheel);
+
+  /* The next tick is less than a second away, so an item waits timeout + 1
+   * ticks. One more slot for the one which just expired. */
+  wheel->n_slots = timeout + 2;
+  wheel->slots = g_new (GPtrArray *, wheel->n_slots);
+  for (i = 0; i < wheel->n_slots; i++)
+    wheel->slots[i] = g_ptr_array_new ();
+
+  wheel->func = func;
+  wheel->user_data = user_data;
+  wheel->item_destroy = item_destroy;
+
+  return wheel;
+}
+
+void
+empathy_timer_wheel_add (EmpathyTimerWheel *wheel,
+    gpointer item)
+{
+  guint slot;
+
+  g_return_if_fail (wheel != NULL);
+
+  slot = (wheel->current + wheel->n_slots - 1) % wheel->n_slots;
+  g_ptr_array_add (wheel->slots[slot], item);
+  wheel->n_items++;
+
+  if (wheel->source_id == 0)
+    wheel->source_id = g_timeout_add_seconds (1, timer_wheel_tick_cb, wheel);
+}
+
+void
+empathy_timer_wheel_free (EmpathyTimerWheel *wheel)
+{
+  guint i;
+
+  if (wheel == NULL)
+    return;
+
+  if (wheel->source_id != 0)
+    g_source_remove (wheel->source_id);
+
+  for (i = 0; i < wheel->n_slots; i++)
+    {
+      timer_wheel_free_items (wheel, wheel->slots[i]);
+      g_ptr_array_unref (wheel->slots[i]);
+    }
+
+  g_free (wheel->slots);
+  g_slice_free (EmpathyTimerWheel, wheel);
+}
@@ -476,15 +476,15 @@ message_sent_cb (TpTextChannel   *channel,
 		 gchar              *token,
 		 EmpathyTpChat      *self)
 {
-	gchar *message_body;
-
-	message_body = tp_message_to_text (message, NULL);
+	if (DEBUGGING) {
+		gchar *message_body;
 
-	DEBUG ("Message sent: %s", message_body);
+		message_body = tp_message_to_text (message, NULL);
+		DEBUG ("Message sent: %s", message_body);
+		g_free (message_body);
+	}
 
 	tp_chat_build_message (self, message, FALSE);
-
-	g_free (message_body);
 }
 
 static TpChannelTextSendError
@@ -1331,20 +1331,20 @@ void
 empathy_tp_chat_send (EmpathyTpChat *self,
 		      TpMessage *message)
 {
-	gchar *message_body;
-
 	g_return_if_fail (EMPATHY_IS_TP_CHAT (self));
 	g_return_if_fail (TP_IS_CLIENT_MESSAGE (message));
 
-	message_body = tp_message_to_text (message, NULL);
+	if (DEBUGGING) {
+		gchar *message_body;
 
-	DEBUG ("Sending message: %s", message_body);
+		message_body = tp_message_to_text (message, NULL);
+		DEBUG ("Sending message: %s", message_body);
+		g_free (message_body);
+	}
 
 	tp_text_channel_send_message_async (TP_TEXT_CHANNEL (self),
 		message, TP_MESSAGE_SENDING_FLAG_REPORT_DELIVERY,
 		message_send_cb, self);
-
-	g_free (message_body);
 }
 
 const GList *
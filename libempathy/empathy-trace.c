@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+
+#include "empathy-trace.h"
+#include "empathy-utils.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_TRACE
+#include "empathy-debug.h"
+
+/* Spans are timed with the monotonic clock, relative to the call to
+ * empathy_trace_init(). They are always sent to the debug sender, under the
+ * "Trace" domain, and are also kept to be dumped as a Chrome trace-event file
+ * (see chrome://tracing) if $EMPATHY_TRACE_FILE is set.
+ *
+ * Everything here has to be called from the main thread. */
+
+typedef enum
+{
+  EVENT_SPAN,
+  EVENT_ASYNC_SPAN,
+  EVENT_MARK,
+} EventType;
+
+typedef struct
+{
+  EventType type;
+  gchar *name;
+  /* In microseconds, since origin */
+  gint64 begin;
+  gint64 duration;
+} Event;
+
+static gint64 origin = 0;
+static gchar *trace_file = NULL;
+/* Only recorded if there is a file to dump them to */
+static GArray *events = NULL;
+
+/**
+ * empathy_trace_init:
+ *
+ * Starts the clock all the spans are timed against. Call it as early as
+ * possible in main(); it's otherwise started by the first span.
+ */
+void
+empathy_trace_init (void)
+{
+  const gchar *file;
+
+  if (origin != 0)
+    return;
+
+  origin = g_get_monotonic_time ();
+
+  file = g_getenv (EMPATHY_TRACE_FILE_ENV);
+  if (!EMP_STR_EMPTY (file))
+    {
+      trace_file = g_strdup (file);
+      events = g_array_new (FALSE, FALSE, sizeof (Event));
+    }
+}
+
+/* Returns: the time to pass to empathy_trace_end() once the span is over */
+gint64
+empathy_trace_begin (void)
+{
+  empathy_trace_init ();
+
+  return g_get_monotonic_time ();
+}
+
+static void
+trace_record (EventType type,
+    const gchar *name,
+    gint64 begin,
+    gint64 end)
+{
+  Event event;
+
+  empathy_trace_init ();
+
+  if (type == EVENT_MARK)
+    DEBUG ("%s at %.1f ms", name, (begin - origin) / 1000.);
+  else
+    DEBUG ("%s took %.1f ms (%.1f ms to %.1f ms)", name,
+        (end - begin) / 1000., (begin - origin) / 1000.,
+        (end - origin) / 1000.);
+
+  if (events == NULL)
+    return;
+
+  event.type = type;
+  event.name = g_strdup (name);
+  event.begin = begin - origin;
+  event.duration = end - begin;
+
+  g_array_append_val (events, event);
+}
+
+/**
+ * empathy_trace_end:
+ * @name: the name of the span
+ * @begin: the value returned by empathy_trace_begin()
+ *
+ * Ends a span which is nested in the ones still running, as is the case when
+ * @begin was taken in the same function.
+ */
+void
+empathy_trace_end (const gchar *name,
+    gint64 begin)
+{
+  trace_record (EVENT_SPAN, name, begin, g_get_monotonic_time ());
+}
+
+/**
+ * empathy_trace_end_async:
+ * @name: the name of the span
+ * @begin: the value returned by empathy_trace_begin()
+ *
+ * Ends a span which was started before going back to the main loop, such as
+ * waiting for a proxy to be prepared, and so may overlap with others.
+ */
+void
+empathy_trace_end_async (const gchar *name,
+    gint64 begin)
+{
+  trace_record (EVENT_ASYNC_SPAN, name, begin, g_get_monotonic_time ());
+}
+
+void
+empathy_trace_mark (const gchar *name)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  trace_record (EVENT_MARK, name, now, now);
+}
+
+static void
+append_json_string (GString *json,
+    const gchar *str)
+{
+  const gchar *p;
+
+  g_string_append_c (json, '"');
+
+  for (p = str; *p != '\0'; p++)
+    {
+      if (*p == '"' || *p == '\\')
+        g_string_append_printf (json, "\\%c", *p);
+      else if ((guchar) *p < 0x20)
+        g_string_append_printf (json, "\\u%04x", *p);
+      else
+        g_string_append_c (json, *p);
+    }
+
+  g_string_append_c (json, '"');
+}
+
+static void
+append_event (GString *json,
+    const gchar *phase,
+    const gchar *name,
+    gint64 timestamp,
+    const gchar *extra)
+{
+  g_string_append (json, "{\"name\":");
+  append_json_string (json, name);
+  g_string_append_printf (json, ",\"cat\":\"empathy\",\"ph\":\"%s\","
+      "\"ts\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":1%s},\n",
+      phase, timestamp, (gint) getpid (), extra);
+}
+
+/**
+ * empathy_trace_dump:
+ *
+ * Writes the events recorded so far to $EMPATHY_TRACE_FILE, replacing its
+ * content. There is one event per line, so scripts don't need to fully parse
+ * the file to look for an event.
+ *
+ * Returns: %TRUE if the file was written
+ */
+gboolean
+empathy_trace_dump (void)
+{
+  GString *json;
+  GError *error = NULL;
+  gboolean result;
+  guint i;
+
+  if (events == NULL)
+    return FALSE;
+
+  json = g_string_new ("{\"traceEvents\":[\n");
+
+  for (i = 0; i < events->len; i++)
+    {
+      Event *event = &g_array_index (events, Event, i);
+      gchar *extra;
+
+      switch (event->type)
+        {
+          case EVENT_SPAN:
+            extra = g_strdup_printf (",\"dur\":%" G_GINT64_FORMAT,
+                event->duration);
+            append_event (json, "X", event->name, event->begin, extra);
+            g_free (extra);
+            break;
+
+          case EVENT_ASYNC_SPAN:
+            /* Async spans are matched by their id rather than nested */
+            extra = g_strdup_printf (",\"id\":%u", i);
+            append_event (json, "b", event->name, event->begin, extra);
+            append_event (json, "e", event->name,
+                event->begin + event->duration, extra);
+            g_free (extra);
+            break;
+
+          case EVENT_MARK:
+            append_event (json, "i", event->name, event->begin,
+                ",\"s\":\"p\"");
+            break;
+        }
+    }
+
+  /* Drop the trailing ",\n" */
+  if (events->len > 0)
+    g_string_truncate (json, json->len - 2);
+
+  g_string_append (json, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  result = g_file_set_contents (trace_file, json->str, json->len, &error);
+  if (!result)
+    {
+      DEBUG ("Failed to write %s: %s", trace_file, error->message);
+      g_error_free (error);
+    }
+
+  g_string_free (json, TRUE);
+
+  return result;
+}
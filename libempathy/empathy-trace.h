@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_TRACE_H__
+#define __EMPATHY_TRACE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Name of the environment variable giving the file the trace is dumped to */
+#define EMPATHY_TRACE_FILE_ENV "EMPATHY_TRACE_FILE"
+
+void empathy_trace_init (void);
+gint64 empathy_trace_begin (void);
+void empathy_trace_end (const gchar *name,
+    gint64 begin);
+void empathy_trace_end_async (const gchar *name,
+    gint64 begin);
+void empathy_trace_mark (const gchar *name);
+gboolean empathy_trace_dump (void);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_TRACE_H__ */
@@ -38,6 +38,7 @@
 
 #include <libempathy/empathy-utils.h>
 #include <libempathy/empathy-connection-managers.h>
+#include <libempathy/empathy-file-store.h>
 #include <libempathy-gtk/empathy-ui-utils.h>
 
 #include "empathy-accounts.h"
@@ -254,5 +255,7 @@ main (int argc, char *argv[])
 
   g_object_unref (app);
 
+  empathy_file_store_flush_all ();
+
   return retval;
 }
@@ -28,6 +28,7 @@
 
 #include <telepathy-glib/debug-sender.h>
 
+#include <libempathy/empathy-file-store.h>
 #include <libempathy-gtk/empathy-ui-utils.h>
 
 #include "empathy-streamed-media-window.h"
@@ -168,5 +169,7 @@ main (int argc,
   g_object_unref (debug_sender);
 #endif
 
+  empathy_file_store_flush_all ();
+
   return retval;
 }
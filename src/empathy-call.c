@@ -35,6 +35,7 @@
 #include <telepathy-yell/telepathy-yell.h>
 
 #include <libempathy/empathy-client-factory.h>
+#include <libempathy/empathy-file-store.h>
 
 #include <libempathy-gtk/empathy-ui-utils.h>
 
@@ -260,5 +261,7 @@ main (int argc,
   g_object_unref (debug_sender);
 #endif
 
+  empathy_file_store_flush_all ();
+
   return retval;
 }
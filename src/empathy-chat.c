@@ -30,6 +30,7 @@
 
 #include <telepathy-glib/debug-sender.h>
 
+#include <libempathy/empathy-file-store.h>
 #include <libempathy/empathy-presence-manager.h>
 
 #include <libempathy-gtk/empathy-theme-manager.h>
@@ -168,6 +169,8 @@ main (int argc,
   g_object_unref (debug_sender);
 #endif
 
+  empathy_file_store_flush_all ();
+
   notify_uninit ();
 
   return retval;
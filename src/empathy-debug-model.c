@@ -0,0 +1,844 @@
+/*
+*  Copyright (C) 2012 Collabora Ltd.
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation; either
+*  version 2.1 of the License, or (at your option) any later version.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "config.h"
+
+#include <string.h>
+
+#include <telepathy-glib/enums.h>
+
+#include "empathy-debug-model.h"
+
+/* EmpathyDebugModel shows the messages of an EmpathyDebugCache, without
+ * copying them. The rows shown for each filter are kept up to date in index
+ * arrays, so changing the filter doesn't have to look at every message. */
+
+#define N_LEVELS (TP_DEBUG_LEVEL_DEBUG + 1)
+
+/* The message is stored in a single block, split and stripped the way the
+ * view shows it */
+typedef struct
+{
+  gdouble timestamp;
+  guint level;
+  /* Point into strings */
+  const gchar *domain;
+  const gchar *category;
+  const gchar *message;
+  gchar strings[1];
+} DebugMessage;
+
+static DebugMessage *
+debug_message_new (gdouble timestamp,
+    const gchar *domain_category,
+    guint level,
+    const gchar *message)
+{
+  DebugMessage *retval;
+  const gchar *slash;
+  gsize domain_len, category_len, message_len;
+  gchar *p;
+
+  slash = strchr (domain_category, '/');
+  if (slash != NULL)
+    {
+      domain_len = slash - domain_category;
+      category_len = strlen (slash + 1);
+    }
+  else
+    {
+      domain_len = strlen (domain_category);
+      category_len = 0;
+    }
+
+  message_len = strlen (message);
+  if (g_str_has_suffix (message, "\n"))
+    {
+      while (message_len > 0 && g_ascii_isspace (message[message_len - 1]))
+        message_len--;
+    }
+
+  retval = g_malloc (G_STRUCT_OFFSET (DebugMessage, strings) +
+      domain_len + category_len + message_len + 3);
+
+  retval->timestamp = timestamp;
+  retval->level = level;
+
+  p = retval->strings;
+  retval->domain = p;
+  memcpy (p, domain_category, domain_len);
+  p += domain_len;
+  *p++ = '\0';
+
+  retval->category = p;
+  if (slash != NULL)
+    memcpy (p, slash + 1, category_len);
+  p += category_len;
+  *p++ = '\0';
+
+  retval->message = p;
+  memcpy (p, message, message_len);
+  p[message_len] = '\0';
+
+  return retval;
+}
+
+static const gchar *
+log_level_to_string (guint level)
+{
+  switch (level)
+    {
+    case TP_DEBUG_LEVEL_ERROR:
+      return "Error";
+      break;
+    case TP_DEBUG_LEVEL_CRITICAL:
+      return "Critical";
+      break;
+    case TP_DEBUG_LEVEL_WARNING:
+      return "Warning";
+      break;
+    case TP_DEBUG_LEVEL_MESSAGE:
+      return "Message";
+      break;
+    case TP_DEBUG_LEVEL_INFO:
+      return "Info";
+      break;
+    case TP_DEBUG_LEVEL_DEBUG:
+      return "Debug";
+      break;
+    default:
+      g_assert_not_reached ();
+      break;
+    }
+}
+
+/* Ascending sequence numbers of messages. Messages are only ever dropped
+ * from the front, so this is an array with a moving start. */
+typedef struct
+{
+  GArray *seqs;
+  guint start;
+} SeqIndex;
+
+static void
+seq_index_init (SeqIndex *index)
+{
+  index->seqs = g_array_new (FALSE, FALSE, sizeof (guint));
+  index->start = 0;
+}
+
+static void
+seq_index_clear (SeqIndex *index)
+{
+  g_array_set_size (index->seqs, 0);
+  index->start = 0;
+}
+
+static void
+seq_index_destroy (SeqIndex *index)
+{
+  g_array_unref (index->seqs);
+}
+
+static guint
+seq_index_get_len (SeqIndex *index)
+{
+  return index->seqs->len - index->start;
+}
+
+static guint
+seq_index_get (SeqIndex *index,
+    guint i)
+{
+  return g_array_index (index->seqs, guint, index->start + i);
+}
+
+static void
+seq_index_append (SeqIndex *index,
+    guint seq)
+{
+  g_array_append_val (index->seqs, seq);
+}
+
+/* Returns TRUE if @seq was the first one, and has been removed */
+static gboolean
+seq_index_drop_first (SeqIndex *index,
+    guint seq)
+{
+  if (seq_index_get_len (index) == 0 || seq_index_get (index, 0) != seq)
+    return FALSE;
+
+  index->start++;
+
+  /* Reclaim the space of the dropped ones once they are the majority */
+  if (index->start >= 1024 && index->start * 2 >= index->seqs->len)
+    {
+      g_array_remove_range (index->seqs, 0, index->start);
+      index->start = 0;
+    }
+
+  return TRUE;
+}
+
+static SeqIndex *
+seq_index_new (void)
+{
+  SeqIndex *index = g_slice_new (SeqIndex);
+
+  seq_index_init (index);
+
+  return index;
+}
+
+static void
+seq_index_free (SeqIndex *index)
+{
+  seq_index_destroy (index);
+  g_slice_free (SeqIndex, index);
+}
+
+struct _EmpathyDebugCache
+{
+  /* Ring buffer, growing up to size; then the oldest message is replaced */
+  DebugMessage **messages;
+  guint allocated;
+  guint size;
+  /* Index of the oldest message, and its sequence number. Sequence numbers
+   * keep increasing as messages are added; they may wrap around, so they
+   * are only compared for equality. */
+  guint first;
+  guint first_seq;
+  guint len;
+
+  /* Messages with a level lower or equal to the index */
+  SeqIndex levels[N_LEVELS];
+  /* owned gchar *domain -> owned SeqIndex of its messages. Domains stay
+   * once all their messages are dropped, so the one being filtered on
+   * doesn't disappear from under the user; there are only a few of them
+   * per service. */
+  GHashTable *domains;
+};
+
+EmpathyDebugCache *
+empathy_debug_cache_new (guint size)
+{
+  EmpathyDebugCache *cache;
+  guint i;
+
+  g_return_val_if_fail (size > 0, NULL);
+
+  cache = g_slice_new0 (EmpathyDebugCache);
+  cache->size = size;
+
+  for (i = 0; i < N_LEVELS; i++)
+    seq_index_init (&cache->levels[i]);
+
+  cache->domains = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) seq_index_free);
+
+  return cache;
+}
+
+static DebugMessage *
+debug_cache_lookup (EmpathyDebugCache *cache,
+    guint seq)
+{
+  return cache->messages[(cache->first + (seq - cache->first_seq)) %
+      cache->size];
+}
+
+static void
+debug_cache_clear (EmpathyDebugCache *cache)
+{
+  guint i;
+
+  for (i = 0; i < cache->len; i++)
+    g_free (cache->messages[(cache->first + i) % cache->size]);
+
+  cache->first_seq += cache->len;
+  cache->first = 0;
+  cache->len = 0;
+
+  for (i = 0; i < N_LEVELS; i++)
+    seq_index_clear (&cache->levels[i]);
+
+  g_hash_table_remove_all (cache->domains);
+}
+
+void
+empathy_debug_cache_free (EmpathyDebugCache *cache)
+{
+  guint i;
+
+  if (cache == NULL)
+    return;
+
+  debug_cache_clear (cache);
+  g_free (cache->messages);
+
+  for (i = 0; i < N_LEVELS; i++)
+    seq_index_destroy (&cache->levels[i]);
+
+  g_hash_table_unref (cache->domains);
+
+  g_slice_free (EmpathyDebugCache, cache);
+}
+
+static void
+debug_cache_drop_oldest (EmpathyDebugCache *cache)
+{
+  DebugMessage *dm = cache->messages[cache->first];
+  guint i;
+
+  for (i = dm->level; i < N_LEVELS; i++)
+    seq_index_drop_first (&cache->levels[i], cache->first_seq);
+
+  seq_index_drop_first (g_hash_table_lookup (cache->domains, dm->domain),
+      cache->first_seq);
+
+  g_free (dm);
+  cache->messages[cache->first] = NULL;
+  cache->first = (cache->first + 1) % cache->size;
+  cache->first_seq++;
+  cache->len--;
+}
+
+/* Returns the sequence number of @dm. The cache must not be full. */
+static guint
+debug_cache_append (EmpathyDebugCache *cache,
+    DebugMessage *dm,
+    gboolean *new_domain)
+{
+  SeqIndex *domain;
+  guint seq, i;
+
+  g_assert (cache->len < cache->size);
+
+  /* Until the cache is full the messages start at 0 */
+  if (cache->len == cache->allocated && cache->allocated < cache->size)
+    {
+      cache->allocated = CLAMP (cache->allocated * 2, 64, cache->size);
+      cache->messages = g_renew (DebugMessage *, cache->messages,
+          cache->allocated);
+    }
+
+  seq = cache->first_seq + cache->len;
+  cache->messages[(cache->first + cache->len) % cache->size] = dm;
+  cache->len++;
+
+  for (i = dm->level; i < N_LEVELS; i++)
+    seq_index_append (&cache->levels[i], seq);
+
+  domain = g_hash_table_lookup (cache->domains, dm->domain);
+  *new_domain = (domain == NULL);
+  if (domain == NULL)
+    {
+      domain = seq_index_new ();
+      g_hash_table_insert (cache->domains, g_strdup (dm->domain), domain);
+    }
+
+  seq_index_append (domain, seq);
+
+  return seq;
+}
+
+static void empathy_debug_model_tree_model_iface_init (
+    GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (EmpathyDebugModel, empathy_debug_model,
+    G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+        empathy_debug_model_tree_model_iface_init))
+
+enum
+{
+  DOMAIN_ADDED,
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
+struct _EmpathyDebugModelPriv
+{
+  /* borrowed, may be NULL */
+  EmpathyDebugCache *cache;
+
+  guint max_level;
+  gchar *domain;
+
+  /* The rows: either one of the cache's level indexes, or filtered */
+  SeqIndex *visible;
+  /* Messages of the domain with the right level, if there is a domain */
+  SeqIndex filtered;
+
+  gint stamp;
+};
+
+static void
+debug_model_update_visible (EmpathyDebugModel *self)
+{
+  EmpathyDebugModelPriv *priv = self->priv;
+  SeqIndex *domain;
+  guint i;
+
+  priv->stamp++;
+  seq_index_clear (&priv->filtered);
+
+  if (priv->cache == NULL)
+    {
+      priv->visible = &priv->filtered;
+      return;
+    }
+
+  if (priv->domain == NULL)
+    {
+      priv->visible = &priv->cache->levels[priv->max_level];
+      return;
+    }
+
+  priv->visible = &priv->filtered;
+
+  domain = g_hash_table_lookup (priv->cache->domains, priv->domain);
+  if (domain == NULL)
+    return;
+
+  for (i = 0; i < seq_index_get_len (domain); i++)
+    {
+      guint seq = seq_index_get (domain, i);
+
+      if (debug_cache_lookup (priv->cache, seq)->level <= priv->max_level)
+        seq_index_append (&priv->filtered, seq);
+    }
+}
+
+static gboolean
+debug_model_matches (EmpathyDebugModel *self,
+    DebugMessage *dm)
+{
+  return dm->level <= self->priv->max_level &&
+      !g_strcmp0 (dm->domain, self->priv->domain);
+}
+
+/**
+ * empathy_debug_model_append:
+ * @self: an #EmpathyDebugModel
+ * @timestamp: when the message was logged
+ * @domain_category: its domain, and category after a '/' if it has one
+ * @level: a #TpDebugLevel
+ * @message: the message
+ *
+ * Adds a message to the cache shown by @self, dropping its oldest message
+ * if it is full.
+ */
+void
+empathy_debug_model_append (EmpathyDebugModel *self,
+    gdouble timestamp,
+    const gchar *domain_category,
+    guint level,
+    const gchar *message)
+{
+  EmpathyDebugModelPriv *priv;
+  EmpathyDebugCache *cache;
+  DebugMessage *dm;
+  GtkTreePath *path;
+  GtkTreeIter iter;
+  gboolean new_domain;
+  guint seq, len;
+
+  g_return_if_fail (EMPATHY_IS_DEBUG_MODEL (self));
+  g_return_if_fail (self->priv->cache != NULL);
+
+  priv = self->priv;
+  cache = priv->cache;
+
+  if (cache->len == cache->size)
+    {
+      guint oldest = cache->first_seq;
+      gboolean shown;
+
+      shown = seq_index_get_len (priv->visible) > 0 &&
+          seq_index_get (priv->visible, 0) == oldest;
+
+      debug_cache_drop_oldest (cache);
+      seq_index_drop_first (&priv->filtered, oldest);
+
+      if (shown)
+        {
+          priv->stamp++;
+
+          path = gtk_tree_path_new_from_indices (0, -1);
+          gtk_tree_model_row_deleted (GTK_TREE_MODEL (self), path);
+          gtk_tree_path_free (path);
+        }
+    }
+
+  dm = debug_message_new (timestamp, domain_category, level, message);
+
+  len = seq_index_get_len (priv->visible);
+  seq = debug_cache_append (cache, dm, &new_domain);
+
+  if (priv->domain != NULL && debug_model_matches (self, dm))
+    seq_index_append (&priv->filtered, seq);
+
+  if (seq_index_get_len (priv->visible) > len)
+    {
+      iter.stamp = priv->stamp;
+      iter.user_data = GUINT_TO_POINTER (len);
+
+      path = gtk_tree_path_new_from_indices (len, -1);
+      gtk_tree_model_row_inserted (GTK_TREE_MODEL (self), path, &iter);
+      gtk_tree_path_free (path);
+    }
+
+  if (new_domain)
+    g_signal_emit (self, signals[DOMAIN_ADDED], 0, dm->domain);
+}
+
+/**
+ * empathy_debug_model_set_cache:
+ * @self: an #EmpathyDebugModel
+ * @cache: the #EmpathyDebugCache to show, or %NULL
+ *
+ * Shows the messages of @cache matching the current filter. @cache must
+ * stay alive as long as @self shows it.
+ */
+void
+empathy_debug_model_set_cache (EmpathyDebugModel *self,
+    EmpathyDebugCache *cache)
+{
+  g_return_if_fail (EMPATHY_IS_DEBUG_MODEL (self));
+
+  self->priv->cache = cache;
+  debug_model_update_visible (self);
+}
+
+void
+empathy_debug_model_clear_cache (EmpathyDebugModel *self)
+{
+  g_return_if_fail (EMPATHY_IS_DEBUG_MODEL (self));
+
+  if (self->priv->cache == NULL)
+    return;
+
+  debug_cache_clear (self->priv->cache);
+  debug_model_update_visible (self);
+}
+
+/**
+ * empathy_debug_model_set_filter:
+ * @self: an #EmpathyDebugModel
+ * @max_level: the least important #TpDebugLevel to show
+ * @domain: the only domain to show, or %NULL to show them all
+ *
+ * Without @domain, this takes constant time. Otherwise, it only looks at the
+ * messages of @domain.
+ */
+void
+empathy_debug_model_set_filter (EmpathyDebugModel *self,
+    guint max_level,
+    const gchar *domain)
+{
+  g_return_if_fail (EMPATHY_IS_DEBUG_MODEL (self));
+  g_return_if_fail (max_level < N_LEVELS);
+
+  self->priv->max_level = max_level;
+  g_free (self->priv->domain);
+  self->priv->domain = g_strdup (domain);
+
+  debug_model_update_visible (self);
+}
+
+/**
+ * empathy_debug_model_get_domains:
+ * @self: an #EmpathyDebugModel
+ *
+ * Returns: (transfer container): the domains of the messages in the cache,
+ * sorted. They are valid until the cache is changed.
+ */
+GList *
+empathy_debug_model_get_domains (EmpathyDebugModel *self)
+{
+  g_return_val_if_fail (EMPATHY_IS_DEBUG_MODEL (self), NULL);
+
+  if (self->priv->cache == NULL)
+    return NULL;
+
+  return g_list_sort (g_hash_table_get_keys (self->priv->cache->domains),
+      (GCompareFunc) g_strcmp0);
+}
+
+static void
+debug_model_finalize (GObject *object)
+{
+  EmpathyDebugModel *self = EMPATHY_DEBUG_MODEL (object);
+
+  seq_index_destroy (&self->priv->filtered);
+  g_free (self->priv->domain);
+
+  G_OBJECT_CLASS (empathy_debug_model_parent_class)->finalize (object);
+}
+
+static void
+empathy_debug_model_class_init (EmpathyDebugModelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = debug_model_finalize;
+
+  /**
+   * EmpathyDebugModel::domain-added:
+   * @self: the model
+   * @domain: the new domain
+   *
+   * Emitted when a message of a domain not seen before in the cache is
+   * added.
+   */
+  signals[DOMAIN_ADDED] = g_signal_new ("domain-added",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, 0,
+      NULL, NULL,
+      g_cclosure_marshal_VOID__STRING,
+      G_TYPE_NONE,
+      1, G_TYPE_STRING);
+
+  g_type_class_add_private (klass, sizeof (EmpathyDebugModelPriv));
+}
+
+static void
+empathy_debug_model_init (EmpathyDebugModel *self)
+{
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+      EMPATHY_TYPE_DEBUG_MODEL, EmpathyDebugModelPriv);
+
+  self->priv->max_level = TP_DEBUG_LEVEL_DEBUG;
+  self->priv->stamp = g_random_int ();
+  seq_index_init (&self->priv->filtered);
+  self->priv->visible = &self->priv->filtered;
+}
+
+EmpathyDebugModel *
+empathy_debug_model_new (void)
+{
+  return g_object_new (EMPATHY_TYPE_DEBUG_MODEL, NULL);
+}
+
+/* GtkTreeModel implementation: a list, the rows being the visible index */
+
+static gboolean
+debug_model_set_iter (EmpathyDebugModel *self,
+    GtkTreeIter *iter,
+    guint row)
+{
+  if (row >= seq_index_get_len (self->priv->visible))
+    {
+      iter->stamp = 0;
+      return FALSE;
+    }
+
+  iter->stamp = self->priv->stamp;
+  iter->user_data = GUINT_TO_POINTER (row);
+
+  return TRUE;
+}
+
+static GtkTreeModelFlags
+debug_model_get_flags (GtkTreeModel *model)
+{
+  return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+debug_model_get_n_columns (GtkTreeModel *model)
+{
+  return EMPATHY_DEBUG_MODEL_N_COLUMNS;
+}
+
+static GType
+debug_model_get_column_type (GtkTreeModel *model,
+    gint column)
+{
+  switch (column)
+    {
+      case EMPATHY_DEBUG_MODEL_COL_TIMESTAMP:
+        return G_TYPE_DOUBLE;
+      case EMPATHY_DEBUG_MODEL_COL_LEVEL_VALUE:
+        return G_TYPE_UINT;
+      default:
+        return G_TYPE_STRING;
+    }
+}
+
+static gboolean
+debug_model_get_iter (GtkTreeModel *model,
+    GtkTreeIter *iter,
+    GtkTreePath *path)
+{
+  if (gtk_tree_path_get_depth (path) != 1)
+    return FALSE;
+
+  return debug_model_set_iter (EMPATHY_DEBUG_MODEL (model), iter,
+      gtk_tree_path_get_indices (path)[0]);
+}
+
+static GtkTreePath *
+debug_model_get_path (GtkTreeModel *model,
+    GtkTreeIter *iter)
+{
+  g_return_val_if_fail (iter->stamp == EMPATHY_DEBUG_MODEL (model)->priv->stamp,
+      NULL);
+
+  return gtk_tree_path_new_from_indices (GPOINTER_TO_UINT (iter->user_data),
+      -1);
+}
+
+static void
+debug_model_get_value (GtkTreeModel *model,
+    GtkTreeIter *iter,
+    gint column,
+    GValue *value)
+{
+  EmpathyDebugModel *self = EMPATHY_DEBUG_MODEL (model);
+  DebugMessage *dm;
+  guint seq;
+
+  g_return_if_fail (iter->stamp == self->priv->stamp);
+
+  seq = seq_index_get (self->priv->visible,
+      GPOINTER_TO_UINT (iter->user_data));
+  dm = debug_cache_lookup (self->priv->cache, seq);
+
+  g_value_init (value, debug_model_get_column_type (model, column));
+
+  /* The strings live as long as the row */
+  switch (column)
+    {
+      case EMPATHY_DEBUG_MODEL_COL_TIMESTAMP:
+        g_value_set_double (value, dm->timestamp);
+        break;
+      case EMPATHY_DEBUG_MODEL_COL_DOMAIN:
+        g_value_set_static_string (value, dm->domain);
+        break;
+      case EMPATHY_DEBUG_MODEL_COL_CATEGORY:
+        g_value_set_static_string (value, dm->category);
+        break;
+      case EMPATHY_DEBUG_MODEL_COL_LEVEL_STRING:
+        g_value_set_static_string (value, log_level_to_string (dm->level));
+        break;
+      case EMPATHY_DEBUG_MODEL_COL_MESSAGE:
+        g_value_set_static_string (value, dm->message);
+        break;
+      case EMPATHY_DEBUG_MODEL_COL_LEVEL_VALUE:
+        g_value_set_uint (value, dm->level);
+        break;
+      default:
+        g_assert_not_reached ();
+    }
+}
+
+static gboolean
+debug_model_iter_next (GtkTreeModel *model,
+    GtkTreeIter *iter)
+{
+  g_return_val_if_fail (
+      iter->stamp == EMPATHY_DEBUG_MODEL (model)->priv->stamp, FALSE);
+
+  return debug_model_set_iter (EMPATHY_DEBUG_MODEL (model), iter,
+      GPOINTER_TO_UINT (iter->user_data) + 1);
+}
+
+static gboolean
+debug_model_iter_previous (GtkTreeModel *model,
+    GtkTreeIter *iter)
+{
+  guint row;
+
+  g_return_val_if_fail (
+      iter->stamp == EMPATHY_DEBUG_MODEL (model)->priv->stamp, FALSE);
+
+  row = GPOINTER_TO_UINT (iter->user_data);
+  if (row == 0)
+    {
+      iter->stamp = 0;
+      return FALSE;
+    }
+
+  return debug_model_set_iter (EMPATHY_DEBUG_MODEL (model), iter, row - 1);
+}
+
+static gboolean
+debug_model_iter_nth_child (GtkTreeModel *model,
+    GtkTreeIter *iter,
+    GtkTreeIter *parent,
+    gint n)
+{
+  if (parent != NULL)
+    return FALSE;
+
+  return debug_model_set_iter (EMPATHY_DEBUG_MODEL (model), iter, n);
+}
+
+static gboolean
+debug_model_iter_children (GtkTreeModel *model,
+    GtkTreeIter *iter,
+    GtkTreeIter *parent)
+{
+  return debug_model_iter_nth_child (model, iter, parent, 0);
+}
+
+static gboolean
+debug_model_iter_has_child (GtkTreeModel *model,
+    GtkTreeIter *iter)
+{
+  return FALSE;
+}
+
+static gint
+debug_model_iter_n_children (GtkTreeModel *model,
+    GtkTreeIter *iter)
+{
+  if (iter != NULL)
+    return 0;
+
+  return seq_index_get_len (EMPATHY_DEBUG_MODEL (model)->priv->visible);
+}
+
+static gboolean
+debug_model_iter_parent (GtkTreeModel *model,
+    GtkTreeIter *iter,
+    GtkTreeIter *child)
+{
+  return FALSE;
+}
+
+static void
+empathy_debug_model_tree_model_iface_init (GtkTreeModelIface *iface)
+{
+  iface->get_flags = debug_model_get_flags;
+  iface->get_n_columns = debug_model_get_n_columns;
+  iface->get_column_type = debug_model_get_column_type;
+  iface->get_iter = debug_model_get_iter;
+  iface->get_path = debug_model_get_path;
+  iface->get_value = debug_model_get_value;
+  iface->iter_next = debug_model_iter_next;
+  iface->iter_previous = debug_model_iter_previous;
+  iface->iter_children = debug_model_iter_children;
+  iface->iter_has_child = debug_model_iter_has_child;
+  iface->iter_n_children = debug_model_iter_n_children;
+  iface->iter_nth_child = debug_model_iter_nth_child;
+  iface->iter_parent = debug_model_iter_parent;
+}
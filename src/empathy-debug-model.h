@@ -0,0 +1,94 @@
+/*
+*  Copyright (C) 2012 Collabora Ltd.
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation; either
+*  version 2.1 of the License, or (at your option) any later version.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef __EMPATHY_DEBUG_MODEL_H__
+#define __EMPATHY_DEBUG_MODEL_H__
+
+#include <glib-object.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define EMPATHY_TYPE_DEBUG_MODEL (empathy_debug_model_get_type ())
+#define EMPATHY_DEBUG_MODEL(object) (G_TYPE_CHECK_INSTANCE_CAST \
+        ((object), EMPATHY_TYPE_DEBUG_MODEL, EmpathyDebugModel))
+#define EMPATHY_DEBUG_MODEL_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), \
+        EMPATHY_TYPE_DEBUG_MODEL, EmpathyDebugModelClass))
+#define EMPATHY_IS_DEBUG_MODEL(object) (G_TYPE_CHECK_INSTANCE_TYPE \
+    ((object), EMPATHY_TYPE_DEBUG_MODEL))
+#define EMPATHY_IS_DEBUG_MODEL_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_TYPE ((klass), EMPATHY_TYPE_DEBUG_MODEL))
+#define EMPATHY_DEBUG_MODEL_GET_CLASS(object) (G_TYPE_INSTANCE_GET_CLASS \
+    ((object), EMPATHY_TYPE_DEBUG_MODEL, EmpathyDebugModelClass))
+
+enum
+{
+  EMPATHY_DEBUG_MODEL_COL_TIMESTAMP = 0,
+  EMPATHY_DEBUG_MODEL_COL_DOMAIN,
+  EMPATHY_DEBUG_MODEL_COL_CATEGORY,
+  EMPATHY_DEBUG_MODEL_COL_LEVEL_STRING,
+  EMPATHY_DEBUG_MODEL_COL_MESSAGE,
+  EMPATHY_DEBUG_MODEL_COL_LEVEL_VALUE,
+  EMPATHY_DEBUG_MODEL_N_COLUMNS
+};
+
+/* The last messages of a service, indexed by level and domain */
+typedef struct _EmpathyDebugCache EmpathyDebugCache;
+
+typedef struct _EmpathyDebugModel EmpathyDebugModel;
+typedef struct _EmpathyDebugModelClass EmpathyDebugModelClass;
+typedef struct _EmpathyDebugModelPriv EmpathyDebugModelPriv;
+
+struct _EmpathyDebugModel
+{
+  GObject parent;
+  EmpathyDebugModelPriv *priv;
+};
+
+struct _EmpathyDebugModelClass
+{
+  GObjectClass parent_class;
+};
+
+EmpathyDebugCache * empathy_debug_cache_new (guint size);
+void empathy_debug_cache_free (EmpathyDebugCache *cache);
+
+GType empathy_debug_model_get_type (void) G_GNUC_CONST;
+
+EmpathyDebugModel * empathy_debug_model_new (void);
+
+void empathy_debug_model_append (EmpathyDebugModel *self,
+    gdouble timestamp,
+    const gchar *domain_category,
+    guint level,
+    const gchar *message);
+
+/* These change all the rows without signalling each of them, so the model
+ * must not be used by a view when calling them */
+void empathy_debug_model_set_cache (EmpathyDebugModel *self,
+    EmpathyDebugCache *cache);
+void empathy_debug_model_clear_cache (EmpathyDebugModel *self);
+void empathy_debug_model_set_filter (EmpathyDebugModel *self,
+    guint max_level,
+    const gchar *domain);
+
+GList * empathy_debug_model_get_domains (EmpathyDebugModel *self);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_DEBUG_MODEL_H__ */
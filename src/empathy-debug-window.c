@@ -42,6 +42,7 @@
 
 #include "extensions/extensions.h"
 
+#include "empathy-debug-model.h"
 #include "empathy-debug-window.h"
 
 G_DEFINE_TYPE (EmpathyDebugWindow, empathy_debug_window,
@@ -53,17 +54,6 @@ typedef enum
   SERVICE_TYPE_CLIENT,
 } ServiceType;
 
-enum
-{
-  COL_DEBUG_TIMESTAMP = 0,
-  COL_DEBUG_DOMAIN,
-  COL_DEBUG_CATEGORY,
-  COL_DEBUG_LEVEL_STRING,
-  COL_DEBUG_MESSAGE,
-  COL_DEBUG_LEVEL_VALUE,
-  NUM_DEBUG_COLS
-};
-
 enum
 {
   COL_NAME = 0,
@@ -79,6 +69,10 @@ enum
   NUM_COLS_LEVEL
 };
 
+/* Number of messages kept for each service, unless EMPATHY_DEBUG_CACHE_SIZE
+ * says otherwise. The oldest ones are dropped first. */
+#define DEBUG_CACHE_DEFAULT_SIZE 50000
+
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyDebugWindow)
 typedef struct
 {
@@ -90,13 +84,17 @@ typedef struct
   GtkToolItem *pause_button;
   GtkToolItem *level_label;
   GtkWidget *level_filter;
+  GtkToolItem *domain_label;
+  GtkWidget *domain_filter;
 
   /* Cache */
+  /* Hash: owned gchar *service name -> owned EmpathyDebugCache */
   GHashTable *cache;
+  guint cache_size;
 
   /* TreeView */
-  GtkListStore *store;
-  GtkTreeModel *store_filter;
+  /* Shows the cache of the active service */
+  EmpathyDebugModel *model;
   GtkWidget *view;
   GtkWidget *scrolled_win;
   GtkWidget *not_supported_label;
@@ -123,163 +121,105 @@ typedef struct
   TpAccountManager *am;
 } EmpathyDebugWindowPriv;
 
-static const gchar *
-log_level_to_string (guint level)
+static gchar *
+get_active_service_name (EmpathyDebugWindow *self)
 {
-  switch (level)
-    {
-    case TP_DEBUG_LEVEL_ERROR:
-      return "Error";
-      break;
-    case TP_DEBUG_LEVEL_CRITICAL:
-      return "Critical";
-      break;
-    case TP_DEBUG_LEVEL_WARNING:
-      return "Warning";
-      break;
-    case TP_DEBUG_LEVEL_MESSAGE:
-      return "Message";
-      break;
-    case TP_DEBUG_LEVEL_INFO:
-      return "Info";
-      break;
-    case TP_DEBUG_LEVEL_DEBUG:
-      return "Debug";
-      break;
-    default:
-      g_assert_not_reached ();
-      break;
-    }
+  EmpathyDebugWindowPriv *priv = GET_PRIV (self);
+  GtkTreeIter iter;
+  gchar *name;
+
+  if (!gtk_combo_box_get_active_iter (GTK_COMBO_BOX (priv->chooser), &iter))
+    return NULL;
+
+  gtk_tree_model_get (GTK_TREE_MODEL (priv->service_store), &iter,
+      COL_NAME, &name, -1);
+
+  return name;
 }
 
-typedef struct
+static EmpathyDebugCache *
+debug_window_get_active_cache (EmpathyDebugWindow *debug_window)
 {
-  gdouble timestamp;
-  gchar *domain;
-  guint level;
-  gchar *message;
-} DebugMessage;
+  EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
+  EmpathyDebugCache *cache;
+  gchar *name;
 
-static DebugMessage *
-debug_message_new (gdouble timestamp,
-    const gchar *domain,
-    guint level,
-    const gchar *message)
-{
-  DebugMessage *retval = g_slice_new0 (DebugMessage);
+  name = get_active_service_name (debug_window);
+  cache = g_hash_table_lookup (priv->cache, name);
 
-  retval->timestamp = timestamp;
-  retval->domain = g_strdup (domain);
-  retval->level = level;
-  retval->message = g_strdup (message);
+  if (cache == NULL)
+    {
+      cache = empathy_debug_cache_new (priv->cache_size);
+      g_hash_table_insert (priv->cache, name, cache);
+    }
+  else
+    {
+      g_free (name);
+    }
 
-  return retval;
+  return cache;
 }
 
+/* The model changes all its rows at once without telling the view, so it
+ * is detached meanwhile. That's also much faster than adding or removing
+ * each row from the view. */
 static void
-debug_message_free (DebugMessage *dm)
+debug_window_detach_model (EmpathyDebugWindow *debug_window)
 {
-  g_free (dm->domain);
-  g_free (dm->message);
+  EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
 
-  g_slice_free (DebugMessage, dm);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->view), NULL);
 }
 
 static void
-debug_message_list_free (gpointer data)
+debug_window_attach_model (EmpathyDebugWindow *debug_window)
 {
-  GList *list = data;
+  EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
 
-  g_list_foreach (list, (GFunc) debug_message_free, NULL);
-  g_list_free (list);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->view),
+      GTK_TREE_MODEL (priv->model));
 }
 
-static gchar *
-get_active_service_name (EmpathyDebugWindow *self)
+static void
+debug_window_fill_domain_filter (EmpathyDebugWindow *debug_window)
 {
-  EmpathyDebugWindowPriv *priv = GET_PRIV (self);
-  GtkTreeIter iter;
-  gchar *name;
+  EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
+  GtkComboBoxText *filter = GTK_COMBO_BOX_TEXT (priv->domain_filter);
+  GList *domains, *l;
 
-  if (!gtk_combo_box_get_active_iter (GTK_COMBO_BOX (priv->chooser), &iter))
-    return NULL;
+  gtk_combo_box_text_remove_all (filter);
+  gtk_combo_box_text_append (filter, NULL, _("All"));
 
-  gtk_tree_model_get (GTK_TREE_MODEL (priv->service_store), &iter,
-      COL_NAME, &name, -1);
+  domains = empathy_debug_model_get_domains (priv->model);
+  for (l = domains; l != NULL; l = l->next)
+    gtk_combo_box_text_append (filter, l->data, l->data);
+  g_list_free (domains);
 
-  return name;
+  /* Changes the filter, if it was set to a domain */
+  gtk_combo_box_set_active (GTK_COMBO_BOX (filter), 0);
 }
 
 static void
-debug_window_cache_new_message (EmpathyDebugWindow *debug_window,
-    gdouble timestamp,
-    const gchar *domain,
-    guint level,
-    const gchar *message)
+debug_window_show_active_cache (EmpathyDebugWindow *debug_window)
 {
   EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
-  GList *messages;
-  DebugMessage *dm;
-  char *name;
-
-  name = get_active_service_name (debug_window);
-  messages = g_hash_table_lookup (priv->cache, name);
-
-  dm = debug_message_new (timestamp, domain, level, message);
-  messages = g_list_append (messages, dm);
 
-  g_hash_table_insert (priv->cache, name, messages);
+  debug_window_detach_model (debug_window);
+  empathy_debug_model_set_cache (priv->model,
+      debug_window_get_active_cache (debug_window));
+  debug_window_fill_domain_filter (debug_window);
+  debug_window_attach_model (debug_window);
 }
 
 static void
-debug_window_add_message (EmpathyDebugWindow *debug_window,
-    gboolean should_cache,
-    gdouble timestamp,
-    const gchar *domain_category,
-    guint level,
-    const gchar *message)
+debug_window_domain_added_cb (EmpathyDebugModel *model,
+    const gchar *domain,
+    EmpathyDebugWindow *debug_window)
 {
   EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
-  gchar *domain, *category;
-  GtkTreeIter iter;
-  gchar *string;
-
-  if (should_cache)
-    debug_window_cache_new_message (debug_window, timestamp, domain_category,
-        level, message);
-
-  if (g_strrstr (domain_category, "/"))
-    {
-      gchar **parts = g_strsplit (domain_category, "/", 2);
-      domain = g_strdup (parts[0]);
-      category = g_strdup (parts[1]);
-      g_strfreev (parts);
-    }
-  else
-    {
-      domain = g_strdup (domain_category);
-      category = g_strdup ("");
-    }
-
-  if (g_str_has_suffix (message, "\n"))
-    string = g_strchomp (g_strdup (message));
-  else
-    string = g_strdup (message);
-
 
-  gtk_list_store_append (priv->store, &iter);
-  gtk_list_store_set (priv->store, &iter,
-      COL_DEBUG_TIMESTAMP, timestamp,
-      COL_DEBUG_DOMAIN, domain,
-      COL_DEBUG_CATEGORY, category,
-      COL_DEBUG_LEVEL_STRING, log_level_to_string (level),
-      COL_DEBUG_MESSAGE, string,
-      COL_DEBUG_LEVEL_VALUE, level,
-      -1);
-
-  g_free (string);
-  g_free (domain);
-  g_free (category);
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (priv->domain_filter),
+      domain, domain);
 }
 
 static void
@@ -292,8 +232,9 @@ debug_window_new_debug_message_cb (TpProxy *proxy,
     GObject *weak_object)
 {
   EmpathyDebugWindow *debug_window = (EmpathyDebugWindow *) user_data;
+  EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
 
-  debug_window_add_message (debug_window, TRUE, timestamp, domain, level,
+  empathy_debug_model_append (priv->model, timestamp, domain, level,
       message);
 }
 
@@ -325,6 +266,8 @@ debug_window_set_toolbar_sensitivity (EmpathyDebugWindow *debug_window,
   gtk_widget_set_sensitive (GTK_WIDGET (priv->pause_button), sensitive);
   gtk_widget_set_sensitive (GTK_WIDGET (priv->level_label), sensitive);
   gtk_widget_set_sensitive (GTK_WIDGET (priv->level_filter), sensitive);
+  gtk_widget_set_sensitive (GTK_WIDGET (priv->domain_label), sensitive);
+  gtk_widget_set_sensitive (GTK_WIDGET (priv->domain_filter), sensitive);
   gtk_widget_set_sensitive (GTK_WIDGET (priv->view), sensitive);
 
   if (sensitive && !priv->view_visible)
@@ -353,8 +296,6 @@ debug_window_get_messages_cb (TpProxy *proxy,
 {
   EmpathyDebugWindow *debug_window = (EmpathyDebugWindow *) user_data;
   EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
-  gchar *name;
-  GList *old_messages;
   guint i;
 
   if (error != NULL)
@@ -366,30 +307,27 @@ debug_window_get_messages_cb (TpProxy *proxy,
 
   debug_window_set_toolbar_sensitivity (debug_window, TRUE);
 
-  name = get_active_service_name (debug_window);
-  old_messages = g_hash_table_lookup (priv->cache, name);
-
   /* we call get_messages either when a new CM is added or
    * when a CM that we've already seen re-appears; in both cases
    * we don't need our old cache anymore.
    */
-  if (old_messages != NULL)
-    {
-      g_hash_table_remove (priv->cache, name);
-      debug_message_list_free (old_messages);
-    }
+  debug_window_detach_model (debug_window);
+  empathy_debug_model_clear_cache (priv->model);
 
   for (i = 0; i < messages->len; i++)
     {
       GValueArray *values = g_ptr_array_index (messages, i);
 
-      debug_window_add_message (debug_window, TRUE,
+      empathy_debug_model_append (priv->model,
           g_value_get_double (g_value_array_get_nth (values, 0)),
           g_value_get_string (g_value_array_get_nth (values, 1)),
           g_value_get_uint (g_value_array_get_nth (values, 2)),
           g_value_get_string (g_value_array_get_nth (values, 3)));
     }
 
+  debug_window_fill_domain_filter (debug_window);
+  debug_window_attach_model (debug_window);
+
   /* Connect to NewDebugMessage */
   priv->new_debug_message_signal = emp_cli_debug_connect_to_new_debug_message (
       proxy, debug_window_new_debug_message_cb, debug_window,
@@ -399,30 +337,6 @@ debug_window_get_messages_cb (TpProxy *proxy,
   debug_window_set_enabled (debug_window, !priv->paused);
 }
 
-static void
-debug_window_add_log_messages_from_cache (EmpathyDebugWindow *debug_window,
-    const gchar *name)
-{
-  GList *messages, *l;
-  DebugMessage *dm;
-  EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
-
-  DEBUG ("Adding logs from cache for CM %s", name);
-
-  messages = g_hash_table_lookup (priv->cache, name);
-
-  if (messages == NULL)
-    return;
-
-  for (l = messages; l != NULL; l = l->next)
-    {
-      dm = l->data;
-
-      debug_window_add_message (debug_window, FALSE, dm->timestamp,
-          dm->domain, dm->level, dm->message);
-    }
-}
-
 static void
 proxy_invalidated_cb (TpProxy *proxy,
     guint domain,
@@ -459,14 +373,14 @@ debug_window_service_chooser_changed_cb (GtkComboBox *chooser,
       return;
     }
 
-  gtk_list_store_clear (priv->store);
+  debug_window_show_active_cache (debug_window);
 
   gtk_tree_model_get (GTK_TREE_MODEL (priv->service_store), &iter,
       COL_NAME, &name, COL_GONE, &gone, -1);
 
   if (gone)
     {
-      debug_window_add_log_messages_from_cache (debug_window, name);
+      DEBUG ("Showing logs from cache for CM %s", name);
       g_free (name);
       return;
     }
@@ -938,39 +852,26 @@ debug_window_pause_toggled_cb (GtkToggleToolButton *pause_,
   debug_window_set_enabled (debug_window, !priv->paused);
 }
 
-static gboolean
-debug_window_visible_func (GtkTreeModel *model,
-    GtkTreeIter *iter,
-    gpointer user_data)
-{
-  EmpathyDebugWindow *debug_window = (EmpathyDebugWindow *) user_data;
-  EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
-  guint filter_value, level;
-  GtkTreeModel *filter_model;
-  GtkTreeIter filter_iter;
-
-  filter_model = gtk_combo_box_get_model (GTK_COMBO_BOX (priv->level_filter));
-  gtk_combo_box_get_active_iter (GTK_COMBO_BOX (priv->level_filter),
-      &filter_iter);
-
-  gtk_tree_model_get (model, iter, COL_DEBUG_LEVEL_VALUE, &level, -1);
-  gtk_tree_model_get (filter_model, &filter_iter,
-      COL_LEVEL_VALUE, &filter_value, -1);
-
-  if (level <= filter_value)
-    return TRUE;
-
-  return FALSE;
-}
-
 static void
 debug_window_filter_changed_cb (GtkComboBox *filter,
     EmpathyDebugWindow *debug_window)
 {
   EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
+  guint level;
+  GtkTreeModel *level_model;
+  GtkTreeIter level_iter;
+
+  level_model = gtk_combo_box_get_model (GTK_COMBO_BOX (priv->level_filter));
+  gtk_combo_box_get_active_iter (GTK_COMBO_BOX (priv->level_filter),
+      &level_iter);
 
-  gtk_tree_model_filter_refilter (
-      GTK_TREE_MODEL_FILTER (priv->store_filter));
+  gtk_tree_model_get (level_model, &level_iter,
+      COL_LEVEL_VALUE, &level, -1);
+
+  debug_window_detach_model (debug_window);
+  empathy_debug_model_set_filter (priv->model, level,
+      gtk_combo_box_get_active_id (GTK_COMBO_BOX (priv->domain_filter)));
+  debug_window_attach_model (debug_window);
 }
 
 static void
@@ -979,7 +880,10 @@ debug_window_clear_clicked_cb (GtkToolButton *clear_button,
 {
   EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
 
-  gtk_list_store_clear (priv->store);
+  debug_window_detach_model (debug_window);
+  empathy_debug_model_clear_cache (priv->model);
+  debug_window_fill_domain_filter (debug_window);
+  debug_window_attach_model (debug_window);
 }
 
 static void
@@ -1002,10 +906,10 @@ debug_window_menu_copy_activate_cb (GtkMenuItem *menu_item,
       return;
     }
 
-  gtk_tree_model_get_iter (priv->store_filter, &iter, path);
+  gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->model), &iter, path);
 
-  gtk_tree_model_get (priv->store_filter, &iter,
-      COL_DEBUG_MESSAGE, &message,
+  gtk_tree_model_get (GTK_TREE_MODEL (priv->model), &iter,
+      EMPATHY_DEBUG_MODEL_COL_MESSAGE, &message,
       -1);
 
   if (EMP_STR_EMPTY (message))
@@ -1110,7 +1014,8 @@ debug_window_time_formatter (GtkTreeViewColumn *tree_column,
   gdouble timestamp;
   gchar *time_str;
 
-  gtk_tree_model_get (tree_model, iter, COL_DEBUG_TIMESTAMP, &timestamp, -1);
+  gtk_tree_model_get (tree_model, iter,
+      EMPATHY_DEBUG_MODEL_COL_TIMESTAMP, &timestamp, -1);
 
   time_str = debug_window_format_timestamp (timestamp);
 
@@ -1120,7 +1025,7 @@ debug_window_time_formatter (GtkTreeViewColumn *tree_column,
 }
 
 static gboolean
-debug_window_store_filter_foreach (GtkTreeModel *model,
+debug_window_model_foreach (GtkTreeModel *model,
     GtkTreePath *path,
     GtkTreeIter *iter,
     gpointer user_data)
@@ -1133,11 +1038,11 @@ debug_window_store_filter_foreach (GtkTreeModel *model,
   gboolean out = FALSE;
 
   gtk_tree_model_get (model, iter,
-      COL_DEBUG_TIMESTAMP, &timestamp,
-      COL_DEBUG_DOMAIN, &domain,
-      COL_DEBUG_CATEGORY, &category,
-      COL_DEBUG_LEVEL_STRING, &level_str,
-      COL_DEBUG_MESSAGE, &message,
+      EMPATHY_DEBUG_MODEL_COL_TIMESTAMP, &timestamp,
+      EMPATHY_DEBUG_MODEL_COL_DOMAIN, &domain,
+      EMPATHY_DEBUG_MODEL_COL_CATEGORY, &category,
+      EMPATHY_DEBUG_MODEL_COL_LEVEL_STRING, &level_str,
+      EMPATHY_DEBUG_MODEL_COL_MESSAGE, &message,
       -1);
 
   level_upper = g_ascii_strup (level_str, -1);
@@ -1199,8 +1104,8 @@ debug_window_save_file_chooser_response_cb (GtkDialog *dialog,
       goto OUT;
     }
 
-  gtk_tree_model_foreach (priv->store_filter,
-      debug_window_store_filter_foreach, output_stream);
+  gtk_tree_model_foreach (GTK_TREE_MODEL (priv->model),
+      debug_window_model_foreach, output_stream);
 
 OUT:
   if (gfile != NULL)
@@ -1275,11 +1180,11 @@ debug_window_copy_model_foreach (GtkTreeModel *model,
   gchar *line, *time_str;
 
   gtk_tree_model_get (model, iter,
-      COL_DEBUG_TIMESTAMP, &timestamp,
-      COL_DEBUG_DOMAIN, &domain,
-      COL_DEBUG_CATEGORY, &category,
-      COL_DEBUG_LEVEL_STRING, &level_str,
-      COL_DEBUG_MESSAGE, &message,
+      EMPATHY_DEBUG_MODEL_COL_TIMESTAMP, &timestamp,
+      EMPATHY_DEBUG_MODEL_COL_DOMAIN, &domain,
+      EMPATHY_DEBUG_MODEL_COL_CATEGORY, &category,
+      EMPATHY_DEBUG_MODEL_COL_LEVEL_STRING, &level_str,
+      EMPATHY_DEBUG_MODEL_COL_MESSAGE, &message,
       -1);
 
   level_upper = g_ascii_strup (level_str, -1);
@@ -1317,7 +1222,7 @@ debug_window_copy_clicked_cb (GtkToolButton *tool_button,
 
   text = g_strdup ("");
 
-  gtk_tree_model_foreach (priv->store_filter,
+  gtk_tree_model_foreach (GTK_TREE_MODEL (priv->model),
       debug_window_copy_model_foreach, &text);
 
   clipboard = gtk_clipboard_get_for_display (
@@ -1584,6 +1489,28 @@ am_prepared_cb (GObject *am,
   g_signal_connect (priv->level_filter, "changed",
       G_CALLBACK (debug_window_filter_changed_cb), object);
 
+  /* Domain */
+  priv->domain_label = gtk_tool_item_new ();
+  gtk_widget_show (GTK_WIDGET (priv->domain_label));
+  label = gtk_label_new (_("Domain "));
+  gtk_widget_show (label);
+  gtk_container_add (GTK_CONTAINER (priv->domain_label), label);
+  gtk_toolbar_insert (GTK_TOOLBAR (toolbar), priv->domain_label, -1);
+
+  priv->domain_filter = gtk_combo_box_text_new ();
+  gtk_widget_show (priv->domain_filter);
+
+  item = gtk_tool_item_new ();
+  gtk_widget_show (GTK_WIDGET (item));
+  gtk_container_add (GTK_CONTAINER (item), priv->domain_filter);
+  gtk_toolbar_insert (GTK_TOOLBAR (toolbar), item, -1);
+
+  gtk_combo_box_text_append (GTK_COMBO_BOX_TEXT (priv->domain_filter),
+      NULL, _("All"));
+  gtk_combo_box_set_active (GTK_COMBO_BOX (priv->domain_filter), 0);
+  g_signal_connect (priv->domain_filter, "changed",
+      G_CALLBACK (debug_window_filter_changed_cb), object);
+
   /* Debug treeview */
   priv->view = gtk_tree_view_new ();
   gtk_tree_view_set_rules_hint (GTK_TREE_VIEW (priv->view), TRUE);
@@ -1598,32 +1525,29 @@ am_prepared_cb (GObject *am,
       -1, _("Time"), renderer,
       (GtkTreeCellDataFunc) debug_window_time_formatter, NULL, NULL);
   gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (priv->view),
-      -1, _("Domain"), renderer, "text", COL_DEBUG_DOMAIN, NULL);
+      -1, _("Domain"), renderer,
+      "text", EMPATHY_DEBUG_MODEL_COL_DOMAIN, NULL);
   gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (priv->view),
-      -1, _("Category"), renderer, "text", COL_DEBUG_CATEGORY, NULL);
+      -1, _("Category"), renderer,
+      "text", EMPATHY_DEBUG_MODEL_COL_CATEGORY, NULL);
   gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (priv->view),
-      -1, _("Level"), renderer, "text", COL_DEBUG_LEVEL_STRING, NULL);
+      -1, _("Level"), renderer,
+      "text", EMPATHY_DEBUG_MODEL_COL_LEVEL_STRING, NULL);
 
   renderer = gtk_cell_renderer_text_new ();
   g_object_set (renderer, "family", "Monospace", NULL);
   gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (priv->view),
-      -1, _("Message"), renderer, "text", COL_DEBUG_MESSAGE, NULL);
-
-  priv->store = gtk_list_store_new (NUM_DEBUG_COLS, G_TYPE_DOUBLE,
-      G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
-      G_TYPE_UINT);
-
-  priv->store_filter = gtk_tree_model_filter_new (
-      GTK_TREE_MODEL (priv->store), NULL);
+      -1, _("Message"), renderer,
+      "text", EMPATHY_DEBUG_MODEL_COL_MESSAGE, NULL);
 
-  gtk_tree_model_filter_set_visible_func (
-      GTK_TREE_MODEL_FILTER (priv->store_filter),
-      debug_window_visible_func, object, NULL);
+  priv->model = empathy_debug_model_new ();
+  g_signal_connect (priv->model, "domain-added",
+      G_CALLBACK (debug_window_domain_added_cb), object);
 
-  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->view), priv->store_filter);
+  debug_window_attach_model (EMPATHY_DEBUG_WINDOW (object));
 
   gtk_tree_view_set_search_column (GTK_TREE_VIEW (priv->view),
-      COL_DEBUG_MESSAGE);
+      EMPATHY_DEBUG_MODEL_COL_MESSAGE);
   gtk_tree_view_set_search_equal_func (GTK_TREE_VIEW (priv->view),
       tree_view_search_equal_func_cb, NULL, NULL);
 
@@ -1667,12 +1591,20 @@ empathy_debug_window_init (EmpathyDebugWindow *empathy_debug_window)
   EmpathyDebugWindowPriv *priv =
       G_TYPE_INSTANCE_GET_PRIVATE (empathy_debug_window,
       EMPATHY_TYPE_DEBUG_WINDOW, EmpathyDebugWindowPriv);
+  const gchar *cache_size;
 
   empathy_debug_window->priv = priv;
 
   priv->dispose_run = FALSE;
   priv->cache = g_hash_table_new_full (g_str_hash, g_str_equal,
-      g_free, NULL);
+      g_free, (GDestroyNotify) empathy_debug_cache_free);
+
+  cache_size = g_getenv ("EMPATHY_DEBUG_CACHE_SIZE");
+  if (cache_size != NULL)
+    priv->cache_size = g_ascii_strtoull (cache_size, NULL, 10);
+
+  if (priv->cache_size == 0)
+    priv->cache_size = DEBUG_CACHE_DEFAULT_SIZE;
 }
 
 static void
@@ -1707,20 +1639,9 @@ static void
 debug_window_finalize (GObject *object)
 {
   EmpathyDebugWindowPriv *priv = GET_PRIV (object);
-  GHashTableIter iter;
-  char *key;
-  GList *values;
 
   g_free (priv->select_name);
 
-  g_hash_table_iter_init (&iter, priv->cache);
-
-  while (g_hash_table_iter_next (&iter, (gpointer *) &key,
-          (gpointer *) &values))
-    {
-      debug_message_list_free (values);
-    }
-
   g_hash_table_unref (priv->cache);
 
   (G_OBJECT_CLASS (empathy_debug_window_parent_class)->finalize) (object);
@@ -1737,8 +1658,14 @@ debug_window_dispose (GObject *object)
 
   priv->dispose_run = TRUE;
 
-  if (priv->store != NULL)
-    g_object_unref (priv->store);
+  /* The caches are only freed in finalize, but don't let the model keep
+   * pointing at them */
+  if (priv->model != NULL)
+    {
+      empathy_debug_model_set_cache (priv->model, NULL);
+      g_object_unref (priv->model);
+      priv->model = NULL;
+    }
 
   if (priv->name_owner_changed_signal != NULL)
     tp_proxy_signal_connection_disconnect (priv->name_owner_changed_signal);
@@ -22,6 +22,7 @@
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
 
+#include <libempathy/empathy-file-store.h>
 #include <libempathy/empathy-utils.h>
 #include <libempathy-gtk/empathy-ui-utils.h>
 
@@ -121,5 +122,7 @@ main (int argc,
 
   g_object_unref (app);
 
+  empathy_file_store_flush_all ();
+
   return retval;
 }
@@ -142,6 +142,7 @@ struct _EmpathyRosterWindowPriv {
   GtkAction *room_join_favorites;
   GtkWidget *room_menu;
   GtkWidget *room_separator;
+  guint room_menu_setup_id;
   GtkWidget *edit_context;
   GtkWidget *edit_context_separator;
 
@@ -179,103 +180,115 @@ roster_window_flash_stop (EmpathyRosterWindow *self)
   self->priv->flash_on = FALSE;
 }
 
-typedef struct
-{
-  EmpathyEvent *event;
-  gboolean on;
-  EmpathyRosterWindow *self;
-} FlashForeachData;
-
-static gboolean
-roster_window_flash_foreach (GtkTreeModel *model,
-    GtkTreePath *path,
-    GtkTreeIter *iter,
-    gpointer user_data)
+/* Returns the rows of the contact of @event, to free with
+ * g_list_free_full (iters, (GDestroyNotify) gtk_tree_iter_free) */
+static GList *
+roster_window_find_event_rows (EmpathyRosterWindow *self,
+    EmpathyEvent *event)
 {
-  FlashForeachData *data = (FlashForeachData *) user_data;
   FolksIndividual *individual;
   EmpathyContact *contact;
-  const gchar *icon_name;
-  GtkTreePath *parent_path = NULL;
-  GtkTreeIter parent_iter;
-  GdkPixbuf *pixbuf = NULL;
-
-  gtk_tree_model_get (model, iter,
-          EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual,
-          -1);
+  GList *iters = NULL;
 
+  individual = empathy_individual_store_lookup_contact (
+      self->priv->individual_store, event->contact);
   if (individual == NULL)
-    return FALSE;
+    return NULL;
 
+  /* Only rows of the individual whose main contact is the event's one */
   contact = empathy_contact_dup_from_folks_individual (individual);
-  if (contact != data->event->contact)
-    goto out;
+  if (contact == event->contact)
+    iters = empathy_individual_store_find_individual (
+        self->priv->individual_store, individual);
 
-  if (data->on)
-    {
-      icon_name = data->event->icon_name;
-      pixbuf = empathy_pixbuf_from_icon_name (icon_name, GTK_ICON_SIZE_MENU);
-    }
-  else
-    {
-      pixbuf = empathy_individual_store_get_individual_status_icon (
-              data->self->priv->individual_store,
-              individual);
-      if (pixbuf != NULL)
-        g_object_ref (pixbuf);
-    }
+  tp_clear_object (&contact);
 
-  gtk_tree_store_set (GTK_TREE_STORE (model), iter,
-      EMPATHY_INDIVIDUAL_STORE_COL_ICON_STATUS, pixbuf,
-      -1);
+  return iters;
+}
 
-  /* To make sure the parent is shown correctly, we emit
-   * the row-changed signal on the parent so it prompts
-   * it to be refreshed by the filter func.
-   */
-  if (gtk_tree_model_iter_parent (model, &parent_iter, iter))
-    {
-      parent_path = gtk_tree_model_get_path (model, &parent_iter);
-    }
+static void
+roster_window_flash_event (EmpathyRosterWindow *self,
+    EmpathyEvent *event,
+    gboolean on)
+{
+  GtkTreeModel *model = GTK_TREE_MODEL (self->priv->individual_store);
+  GList *iters, *l;
+
+  iters = roster_window_find_event_rows (self, event);
 
-  if (parent_path != NULL)
+  for (l = iters; l != NULL; l = l->next)
     {
-      gtk_tree_model_row_changed (model, parent_path, &parent_iter);
-      gtk_tree_path_free (parent_path);
-    }
+      GtkTreeIter *iter = l->data;
+      FolksIndividual *individual;
+      GtkTreePath *parent_path = NULL;
+      GtkTreeIter parent_iter;
+      GdkPixbuf *pixbuf = NULL;
 
-out:
-  g_object_unref (individual);
-  tp_clear_object (&contact);
-  tp_clear_object (&pixbuf);
+      gtk_tree_model_get (model, iter,
+          EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual,
+          -1);
 
-  return FALSE;
+      if (individual == NULL)
+        continue;
+
+      if (on)
+        {
+          pixbuf = empathy_pixbuf_from_icon_name (event->icon_name,
+              GTK_ICON_SIZE_MENU);
+        }
+      else
+        {
+          pixbuf = empathy_individual_store_get_individual_status_icon (
+                  self->priv->individual_store,
+                  individual);
+          if (pixbuf != NULL)
+            g_object_ref (pixbuf);
+        }
+
+      gtk_tree_store_set (GTK_TREE_STORE (model), iter,
+          EMPATHY_INDIVIDUAL_STORE_COL_ICON_STATUS, pixbuf,
+          -1);
+
+      /* To make sure the parent is shown correctly, we emit
+       * the row-changed signal on the parent so it prompts
+       * it to be refreshed by the filter func.
+       */
+      if (gtk_tree_model_iter_parent (model, &parent_iter, iter))
+        {
+          parent_path = gtk_tree_model_get_path (model, &parent_iter);
+        }
+
+      if (parent_path != NULL)
+        {
+          gtk_tree_model_row_changed (model, parent_path, &parent_iter);
+          gtk_tree_path_free (parent_path);
+        }
+
+      g_object_unref (individual);
+      tp_clear_object (&pixbuf);
+    }
+
+  g_list_free_full (iters, (GDestroyNotify) gtk_tree_iter_free);
 }
 
 static gboolean
 roster_window_flash_cb (EmpathyRosterWindow *self)
 {
-  GtkTreeModel *model;
   GSList *events, *l;
   gboolean found_event = FALSE;
-  FlashForeachData  data;
 
   self->priv->flash_on = !self->priv->flash_on;
-  data.on = self->priv->flash_on;
-  model = GTK_TREE_MODEL (self->priv->individual_store);
 
   events = empathy_event_manager_get_events (self->priv->event_manager);
   for (l = events; l; l = l->next)
     {
-      data.event = l->data;
-      data.self = self;
-      if (!data.event->contact || !data.event->must_ack)
+      EmpathyEvent *event = l->data;
+
+      if (!event->contact || !event->must_ack)
         continue;
 
       found_event = TRUE;
-      gtk_tree_model_foreach (model,
-          roster_window_flash_foreach,
-          &data);
+      roster_window_flash_event (self, event, self->priv->flash_on);
     }
 
   if (!found_event)
@@ -422,80 +435,45 @@ roster_window_auth_display (EmpathyRosterWindow *self,
 }
 
 static void
-modify_event_count (GtkTreeModel *model,
-    GtkTreeIter *iter,
+modify_event_count (EmpathyRosterWindow *self,
     EmpathyEvent *event,
     gboolean increase)
 {
-  FolksIndividual *individual;
-  EmpathyContact *contact;
-  guint count;
+  GtkTreeModel *model = GTK_TREE_MODEL (self->priv->individual_store);
+  GList *iters, *l;
 
-  gtk_tree_model_get (model, iter,
-      EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual,
-      EMPATHY_INDIVIDUAL_STORE_COL_EVENT_COUNT, &count,
-      -1);
+  iters = roster_window_find_event_rows (self, event);
 
-  if (individual == NULL)
-    return;
-
-  increase ? count++ : count--;
-
-  contact = empathy_contact_dup_from_folks_individual (individual);
-  if (contact == event->contact)
-    gtk_tree_store_set (GTK_TREE_STORE (model), iter,
-        EMPATHY_INDIVIDUAL_STORE_COL_EVENT_COUNT, count, -1);
+  for (l = iters; l != NULL; l = l->next)
+    {
+      GtkTreeIter *iter = l->data;
+      guint count;
 
-  tp_clear_object (&contact);
-  g_object_unref (individual);
-}
+      gtk_tree_model_get (model, iter,
+          EMPATHY_INDIVIDUAL_STORE_COL_EVENT_COUNT, &count,
+          -1);
 
-static gboolean
-increase_event_count_foreach (GtkTreeModel *model,
-    GtkTreePath *path,
-    GtkTreeIter *iter,
-    gpointer user_data)
-{
-  EmpathyEvent *event = user_data;
+      increase ? count++ : count--;
 
-  modify_event_count (model, iter, event, TRUE);
+      gtk_tree_store_set (GTK_TREE_STORE (model), iter,
+          EMPATHY_INDIVIDUAL_STORE_COL_EVENT_COUNT, count, -1);
+    }
 
-  return FALSE;
+  g_list_free_full (iters, (GDestroyNotify) gtk_tree_iter_free);
 }
 
 static void
 increase_event_count (EmpathyRosterWindow *self,
     EmpathyEvent *event)
 {
-  GtkTreeModel *model;
-
-  model = GTK_TREE_MODEL (self->priv->individual_store);
-
-  gtk_tree_model_foreach (model, increase_event_count_foreach, event);
-}
-
-static gboolean
-decrease_event_count_foreach (GtkTreeModel *model,
-    GtkTreePath *path,
-    GtkTreeIter *iter,
-    gpointer user_data)
-{
-  EmpathyEvent *event = user_data;
-
-  modify_event_count (model, iter, event, FALSE);
-
-  return FALSE;
+  modify_event_count (self, event, TRUE);
 }
 
 static void
 decrease_event_count (EmpathyRosterWindow *self,
     EmpathyEvent *event)
 {
-  GtkTreeModel *model;
-
-  model = GTK_TREE_MODEL (self->priv->individual_store);
-
-  gtk_tree_model_foreach (model, decrease_event_count_foreach, event);
+  modify_event_count (self, event, FALSE);
 }
 
 static void
@@ -520,8 +498,6 @@ roster_window_event_removed_cb (EmpathyEventManager *manager,
     EmpathyEvent *event,
     EmpathyRosterWindow *self)
 {
-  FlashForeachData data;
-
   if (event->type == EMPATHY_EVENT_TYPE_AUTH)
     {
       roster_window_remove_auth (self, event);
@@ -533,13 +509,7 @@ roster_window_event_removed_cb (EmpathyEventManager *manager,
 
   decrease_event_count (self, event);
 
-  data.on = FALSE;
-  data.event = event;
-  data.self = self;
-
-  gtk_tree_model_foreach (GTK_TREE_MODEL (self->priv->individual_store),
-      roster_window_flash_foreach,
-      &data);
+  roster_window_flash_event (self, event, FALSE);
 }
 
 static gboolean
@@ -1349,6 +1319,9 @@ empathy_roster_window_finalize (GObject *window)
   /* Save user-defined accelerators. */
   roster_window_accels_save ();
 
+  if (self->priv->room_menu_setup_id != 0)
+    g_source_remove (self->priv->room_menu_setup_id);
+
   g_list_free (self->priv->actions_connected);
 
   g_object_unref (self->priv->account_manager);
@@ -1372,7 +1345,7 @@ empathy_roster_window_finalize (GObject *window)
   g_object_unref (self->priv->call_observer);
   g_object_unref (self->priv->event_manager);
   g_object_unref (self->priv->ui_manager);
-  g_object_unref (self->priv->chatroom_manager);
+  tp_clear_object (&self->priv->chatroom_manager);
 
   g_object_unref (self->priv->gsettings_ui);
   g_object_unref (self->priv->gsettings_contacts);
@@ -1819,26 +1792,23 @@ roster_window_favorite_chatroom_menu_removed_cb (
   g_list_free (chatrooms);
 }
 
-static void
-roster_window_favorite_chatroom_menu_setup (EmpathyRosterWindow *self)
+static gboolean
+roster_window_favorite_chatroom_menu_fill_cb (gpointer user_data)
 {
+  EmpathyRosterWindow *self = user_data;
   GList *chatrooms, *l;
-  GtkWidget *room;
+
+  self->priv->room_menu_setup_id = 0;
 
   self->priv->chatroom_manager = empathy_chatroom_manager_dup_singleton (NULL);
   chatrooms = empathy_chatroom_manager_get_chatrooms (
     self->priv->chatroom_manager, NULL);
-  room = gtk_ui_manager_get_widget (self->priv->ui_manager,
-    "/menubar/room");
-  self->priv->room_menu = gtk_menu_item_get_submenu (GTK_MENU_ITEM (room));
-  self->priv->room_separator = gtk_ui_manager_get_widget (self->priv->ui_manager,
-    "/menubar/room/room_separator");
 
   for (l = chatrooms; l; l = l->next)
     roster_window_favorite_chatroom_menu_add (self, l->data);
 
-  if (!chatrooms)
-    gtk_widget_hide (self->priv->room_separator);
+  if (chatrooms)
+    gtk_widget_show (self->priv->room_separator);
 
   gtk_action_set_sensitive (self->priv->room_join_favorites, chatrooms != NULL);
 
@@ -1851,6 +1821,27 @@ roster_window_favorite_chatroom_menu_setup (EmpathyRosterWindow *self)
       self);
 
   g_list_free (chatrooms);
+
+  return FALSE;
+}
+
+static void
+roster_window_favorite_chatroom_menu_setup (EmpathyRosterWindow *self)
+{
+  GtkWidget *room;
+
+  room = gtk_ui_manager_get_widget (self->priv->ui_manager,
+    "/menubar/room");
+  self->priv->room_menu = gtk_menu_item_get_submenu (GTK_MENU_ITEM (room));
+  self->priv->room_separator = gtk_ui_manager_get_widget (self->priv->ui_manager,
+    "/menubar/room/room_separator");
+
+  gtk_widget_hide (self->priv->room_separator);
+  gtk_action_set_sensitive (self->priv->room_join_favorites, FALSE);
+
+  /* Loading the favourite rooms doesn't have to delay the first frame */
+  self->priv->room_menu_setup_id = g_idle_add_full (G_PRIORITY_LOW,
+      roster_window_favorite_chatroom_menu_fill_cb, self, NULL);
 }
 
 static void
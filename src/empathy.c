@@ -55,11 +55,13 @@
 #include <libempathy/empathy-chatroom-manager.h>
 #include <libempathy/empathy-account-settings.h>
 #include <libempathy/empathy-connectivity.h>
+#include <libempathy/empathy-file-store.h>
 #include <libempathy/empathy-connection-managers.h>
 #include <libempathy/empathy-request-util.h>
 #include <libempathy/empathy-ft-factory.h>
 #include <libempathy/empathy-gsettings.h>
 #include <libempathy/empathy-tp-chat.h>
+#include <libempathy/empathy-trace.h>
 
 #include <libempathy-gtk/empathy-ui-utils.h>
 #include <libempathy-gtk/empathy-location-manager.h>
@@ -79,6 +81,10 @@
 
 #define EMPATHY_DBUS_NAME "org.gnome.Empathy"
 
+/* Seconds to wait for the roster to be painted before setting up the rest
+ * anyway, in case it never is */
+#define FIRST_DRAW_TIMEOUT 5
+
 #define EMPATHY_TYPE_APP (empathy_app_get_type ())
 #define EMPATHY_APP(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), EMPATHY_TYPE_APP, EmpathyApp))
 #define EMPATHY_APP_CLASS(obj) (G_TYPE_CHECK_CLASS_CAST ((obj), EMPATHY_TYPE_APP, EmpathyAppClass))
@@ -133,6 +139,18 @@ struct _EmpathyApp
 #endif
 
   gboolean shell_running;
+  /* Whether shell_running has been found out */
+  gboolean shell_checked;
+
+  /* Everything not needed to show the roster is only set up once it has been
+   * painted */
+  gulong first_draw_id;
+  guint first_draw_timeout_id;
+  guint deferred_startup_id;
+  gboolean deferred_started;
+
+  /* Startup tracing; 0 once the account manager is prepared */
+  gint64 account_manager_prepare_begin;
 };
 
 
@@ -158,6 +176,18 @@ empathy_app_dispose (GObject *object)
   tp_clear_object (&self->debug_sender);
 #endif
 
+  if (self->first_draw_timeout_id != 0)
+    {
+      g_source_remove (self->first_draw_timeout_id);
+      self->first_draw_timeout_id = 0;
+    }
+
+  if (self->deferred_startup_id != 0)
+    {
+      g_source_remove (self->deferred_startup_id);
+      self->deferred_startup_id = 0;
+    }
+
   tp_clear_object (&self->presence_mgr);
   tp_clear_object (&self->connectivity);
   tp_clear_object (&self->icon);
@@ -257,6 +287,19 @@ empathy_presence_manager_set_auto_away_cb (GSettings *gsettings,
       g_settings_get_boolean (gsettings, key));
 }
 
+static void
+empathy_app_ensure_status_icon (EmpathyApp *self)
+{
+  /* Not needed if GNOME Shell is running, and not needed before the roster
+   * has been painted otherwise */
+  if (self->icon != NULL || !self->shell_checked || self->shell_running ||
+      !self->deferred_started)
+    return;
+
+  self->icon = empathy_status_icon_new (GTK_WINDOW (self->window),
+      self->start_hidden);
+}
+
 #define GNOME_SHELL_BUS_NAME "org.gnome.Shell"
 
 static void
@@ -282,6 +325,8 @@ list_names_cb (TpDBusDaemon *bus_daemon,
     }
 
 out:
+  self->shell_checked = TRUE;
+
   if (self->shell_running)
     {
       DEBUG ("GNOME Shell is running, don't create status icon");
@@ -296,8 +341,7 @@ out:
     {
       gboolean autoaway;
 
-      self->icon = empathy_status_icon_new (GTK_WINDOW (self->window),
-          self->start_hidden);
+      empathy_app_ensure_status_icon (self);
 
       /* Allow Empathy to watch session state */
       autoaway = g_settings_get_boolean (self->gsettings,
@@ -312,6 +356,51 @@ out:
     }
 }
 
+static void empathy_app_queue_deferred_startup (EmpathyApp *self);
+
+static gboolean
+roster_window_first_draw_cb (GtkWidget *window,
+    cairo_t *cr,
+    EmpathyApp *self)
+{
+  g_signal_handler_disconnect (window, self->first_draw_id);
+  self->first_draw_id = 0;
+
+  if (self->first_draw_timeout_id != 0)
+    {
+      g_source_remove (self->first_draw_timeout_id);
+      self->first_draw_timeout_id = 0;
+    }
+
+  empathy_trace_mark ("roster-window-drawn");
+  empathy_app_queue_deferred_startup (self);
+
+  return FALSE;
+}
+
+/* The roster may never be painted, if it's mapped on another workspace or
+ * minimised for instance */
+static gboolean
+roster_window_first_draw_timeout_cb (gpointer user_data)
+{
+  EmpathyApp *self = user_data;
+
+  DEBUG ("Roster not painted after %u seconds, setting up the rest anyway",
+      FIRST_DRAW_TIMEOUT);
+
+  self->first_draw_timeout_id = 0;
+
+  if (self->first_draw_id != 0)
+    {
+      g_signal_handler_disconnect (self->window, self->first_draw_id);
+      self->first_draw_id = 0;
+    }
+
+  empathy_app_queue_deferred_startup (self);
+
+  return FALSE;
+}
+
 static int
 empathy_app_command_line (GApplication *app,
     GApplicationCommandLine *cmdline)
@@ -337,28 +426,17 @@ empathy_app_command_line (GApplication *app,
     {
       GError *error = NULL;
       TpDBusDaemon *dbus;
-
-      /* Create the FT factory */
-      self->ft_factory = empathy_ft_factory_dup_singleton ();
-      g_signal_connect (self->ft_factory, "new-ft-handler",
-          G_CALLBACK (new_ft_handler_cb), NULL);
-      g_signal_connect (self->ft_factory, "new-incoming-transfer",
-          G_CALLBACK (new_incoming_transfer_cb), NULL);
-
-      if (!empathy_ft_factory_register (self->ft_factory, &error))
-        {
-          g_warning ("Failed to register FileTransfer handler: %s",
-              error->message);
-          g_error_free (error);
-        }
+      gint64 begin;
 
       self->activated = TRUE;
 
       /* Setting up UI */
+      begin = empathy_trace_begin ();
       self->window = empathy_roster_window_dup ();
 
       gtk_application_add_window (GTK_APPLICATION (app),
           GTK_WINDOW (self->window));
+      empathy_trace_end ("roster-window", begin);
 
       /* check if Shell is running */
       dbus = tp_dbus_daemon_dup (&error);
@@ -369,8 +447,16 @@ empathy_app_command_line (GApplication *app,
 
       g_object_unref (dbus);
 
-      self->notifications_approver =
-        empathy_notifications_approver_dup_singleton ();
+      if (self->start_hidden)
+        empathy_app_queue_deferred_startup (self);
+      else
+        {
+          self->first_draw_id = tp_g_signal_connect_object (self->window,
+              "draw", G_CALLBACK (roster_window_first_draw_cb), self,
+              G_CONNECT_AFTER);
+          self->first_draw_timeout_id = g_timeout_add_seconds (
+              FIRST_DRAW_TIMEOUT, roster_window_first_draw_timeout_cb, self);
+        }
     }
   else
     {
@@ -385,7 +471,10 @@ empathy_app_command_line (GApplication *app,
         EMPATHY_ROSTER_WINDOW (self->window), self->preferences_tab);
 
   if (!self->start_hidden)
-    empathy_window_present (GTK_WINDOW (self->window));
+    {
+      empathy_window_present (GTK_WINDOW (self->window));
+      empathy_trace_mark ("roster-window-presented");
+    }
 
   /* Display the accounts dialog if needed */
   tp_proxy_prepare_async (self->account_manager, NULL,
@@ -428,6 +517,7 @@ empathy_app_local_command_line (GApplication *app,
   gboolean retval = FALSE;
   GError *error = NULL;
   gboolean no_connect = FALSE, start_hidden = FALSE;
+  gint64 begin;
 
   GOptionContext *optcontext;
   GOptionGroup *group;
@@ -449,6 +539,8 @@ empathy_app_local_command_line (GApplication *app,
       { NULL }
   };
 
+  begin = empathy_trace_begin ();
+
   /* We create a group so that GOptionArgFuncs get the user data */
   group = g_option_group_new ("empathy", NULL, NULL, app, NULL);
   g_option_group_add_entries (group, options);
@@ -485,6 +577,8 @@ empathy_app_local_command_line (GApplication *app,
   self->no_connect = no_connect;
   self->start_hidden = start_hidden;
 
+  empathy_trace_end ("local-command-line", begin);
+
   return retval;
 }
 
@@ -631,6 +725,17 @@ account_manager_ready_cb (GObject *source_object,
   EmpathyApp *self = user_data;
   GError *error = NULL;
   TpConnectionPresenceType presence;
+  gboolean first;
+
+  /* Both empathy_app_constructed() and empathy_app_command_line() prepare it,
+   * the first one to finish ends the startup */
+  first = (self->account_manager_prepare_begin != 0);
+  if (first)
+    {
+      empathy_trace_end_async ("account-manager-prepare",
+          self->account_manager_prepare_begin);
+      self->account_manager_prepare_begin = 0;
+    }
 
   if (!tp_proxy_prepare_finish (manager, result, &error))
     {
@@ -669,6 +774,12 @@ account_manager_ready_cb (GObject *source_object,
   /* Pop up the accounts dialog if we don't have any account */
   if (!empathy_accounts_has_accounts (manager))
     show_accounts_ui (self, gdk_screen_get_default (), TRUE);
+
+  if (first)
+    {
+      empathy_trace_mark ("startup-complete");
+      empathy_trace_dump ();
+    }
 }
 
 static void
@@ -716,6 +827,7 @@ account_manager_chatroom_ready_cb (GObject *source_object,
   EmpathyChatroomManager *chatroom_manager = user_data;
   GList *accounts, *l;
   GError *error = NULL;
+  gint64 begin;
 
   if (!tp_proxy_prepare_finish (account_manager, result, &error))
     {
@@ -724,6 +836,7 @@ account_manager_chatroom_ready_cb (GObject *source_object,
       return;
     }
 
+  begin = empathy_trace_begin ();
   accounts = tp_account_manager_get_valid_accounts (account_manager);
 
   for (l = accounts; l != NULL; l = g_list_next (l))
@@ -738,6 +851,9 @@ account_manager_chatroom_ready_cb (GObject *source_object,
         G_CALLBACK (account_connection_changed_cb), chatroom_manager, 0);
     }
   g_list_free (accounts);
+
+  empathy_trace_end ("chatroom-auto-join", begin);
+  empathy_trace_dump ();
 }
 
 static void
@@ -751,11 +867,93 @@ chatroom_manager_ready_cb (EmpathyChatroomManager *chatroom_manager,
       account_manager_chatroom_ready_cb, chatroom_manager);
 }
 
+static gboolean
+empathy_app_deferred_startup_cb (gpointer user_data)
+{
+  EmpathyApp *self = user_data;
+  GError *error = NULL;
+  gboolean chatroom_manager_ready;
+  gint64 begin, phase;
+
+  self->deferred_startup_id = 0;
+  self->deferred_started = TRUE;
+
+  begin = empathy_trace_begin ();
+
+  /* Create the FT factory */
+  phase = empathy_trace_begin ();
+  self->ft_factory = empathy_ft_factory_dup_singleton ();
+  g_signal_connect (self->ft_factory, "new-ft-handler",
+      G_CALLBACK (new_ft_handler_cb), NULL);
+  g_signal_connect (self->ft_factory, "new-incoming-transfer",
+      G_CALLBACK (new_incoming_transfer_cb), NULL);
+
+  if (!empathy_ft_factory_register (self->ft_factory, &error))
+    {
+      g_warning ("Failed to register FileTransfer handler: %s",
+          error->message);
+      g_error_free (error);
+    }
+  empathy_trace_end ("ft-factory", phase);
+
+  phase = empathy_trace_begin ();
+  self->notifications_approver =
+    empathy_notifications_approver_dup_singleton ();
+  empathy_trace_end ("notifications-approver", phase);
+
+  empathy_app_ensure_status_icon (self);
+
+  /* Logging */
+  phase = empathy_trace_begin ();
+  self->log_manager = tpl_log_manager_dup_singleton ();
+  empathy_trace_end ("log-manager", phase);
+
+  phase = empathy_trace_begin ();
+  self->chatroom_manager = empathy_chatroom_manager_dup_singleton (NULL);
+  empathy_trace_end ("chatroom-manager", phase);
+
+  g_object_get (self->chatroom_manager, "ready", &chatroom_manager_ready, NULL);
+  if (!chatroom_manager_ready)
+    {
+      g_signal_connect (G_OBJECT (self->chatroom_manager), "notify::ready",
+          G_CALLBACK (chatroom_manager_ready_cb), self->account_manager);
+    }
+  else
+    {
+      chatroom_manager_ready_cb (self->chatroom_manager, NULL,
+          self->account_manager);
+    }
+
+  /* Location mananger */
+#ifdef HAVE_GEOCLUE
+  phase = empathy_trace_begin ();
+  self->location_manager = empathy_location_manager_dup_singleton ();
+  empathy_trace_end ("location-manager", phase);
+#endif
+
+  empathy_trace_end ("deferred-startup", begin);
+  empathy_trace_dump ();
+
+  return FALSE;
+}
+
+static void
+empathy_app_queue_deferred_startup (EmpathyApp *self)
+{
+  if (self->deferred_started || self->deferred_startup_id != 0)
+    return;
+
+  self->deferred_startup_id = g_idle_add_full (G_PRIORITY_LOW,
+      empathy_app_deferred_startup_cb, self, NULL);
+}
+
 static void
 empathy_app_constructed (GObject *object)
 {
   EmpathyApp *self = (EmpathyApp *) object;
-  gboolean chatroom_manager_ready;
+  gint64 begin, phase;
+
+  begin = empathy_trace_begin ();
 
   g_set_application_name (_(PACKAGE_NAME));
 
@@ -768,55 +966,46 @@ empathy_app_constructed (GObject *object)
   g_log_set_default_handler (tp_debug_sender_log_handler, G_LOG_DOMAIN);
 #endif
 
+  phase = empathy_trace_begin ();
   notify_init (_(PACKAGE_NAME));
+  empathy_trace_end ("notify-init", phase);
 
   /* Setting up Idle */
+  phase = empathy_trace_begin ();
   self->presence_mgr = empathy_presence_manager_dup_singleton ();
+  empathy_trace_end ("presence-manager", phase);
 
   self->gsettings = g_settings_new (EMPATHY_PREFS_SCHEMA);
 
   /* Setting up Connectivity */
+  phase = empathy_trace_begin ();
   self->connectivity = empathy_connectivity_dup_singleton ();
   use_conn_notify_cb (self->gsettings, EMPATHY_PREFS_USE_CONN,
       self->connectivity);
   g_signal_connect (self->gsettings,
       "changed::" EMPATHY_PREFS_USE_CONN,
       G_CALLBACK (use_conn_notify_cb), self->connectivity);
+  empathy_trace_end ("connectivity", phase);
 
   /* account management */
   self->account_manager = tp_account_manager_dup ();
+  self->account_manager_prepare_begin = empathy_trace_begin ();
   tp_proxy_prepare_async (self->account_manager, NULL,
       account_manager_ready_cb, self);
 
+  phase = empathy_trace_begin ();
   migrate_config_to_xdg_dir ();
+  empathy_trace_end ("migrate-config", phase);
 
-  /* Logging */
-  self->log_manager = tpl_log_manager_dup_singleton ();
-
-  self->chatroom_manager = empathy_chatroom_manager_dup_singleton (NULL);
-
-  g_object_get (self->chatroom_manager, "ready", &chatroom_manager_ready, NULL);
-  if (!chatroom_manager_ready)
-    {
-      g_signal_connect (G_OBJECT (self->chatroom_manager), "notify::ready",
-          G_CALLBACK (chatroom_manager_ready_cb), self->account_manager);
-    }
-  else
-    {
-      chatroom_manager_ready_cb (self->chatroom_manager, NULL,
-          self->account_manager);
-    }
-
-  /* Location mananger */
-#ifdef HAVE_GEOCLUE
-  self->location_manager = empathy_location_manager_dup_singleton ();
-#endif
-
+  phase = empathy_trace_begin ();
   self->conn_aggregator = empathy_connection_aggregator_dup_singleton ();
+  empathy_trace_end ("connection-aggregator", phase);
 
   self->activated = FALSE;
   self->ft_factory = NULL;
   self->window = NULL;
+
+  empathy_trace_end ("app-constructed", begin);
 }
 
 static void
@@ -845,6 +1034,10 @@ main (int argc, char *argv[])
 {
   EmpathyApp *app;
   gint retval;
+  gint64 begin;
+
+  empathy_trace_init ();
+  begin = empathy_trace_begin ();
 
   g_thread_init (NULL);
   g_type_init ();
@@ -861,6 +1054,8 @@ main (int argc, char *argv[])
 
   add_empathy_features ();
 
+  empathy_trace_end ("init", begin);
+
   app = g_object_new (EMPATHY_TYPE_APP,
       "application-id", EMPATHY_DBUS_NAME,
       "flags", G_APPLICATION_HANDLES_COMMAND_LINE,
@@ -868,6 +1063,12 @@ main (int argc, char *argv[])
 
   retval = g_application_run (G_APPLICATION (app), argc, argv);
 
+  empathy_trace_dump ();
+
+  /* Some files are serialized with libxml, so don't leave them to the exit
+   * hook */
+  empathy_file_store_flush_all ();
+
   notify_uninit ();
   xmlCleanupParser ();
 
@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "test-helper.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_TESTS
+#include <libempathy/empathy-debug.h>
+
+#include <libempathy/empathy-avatar-loader.h>
+
+#define N_FILES 50
+#define N_OBJECTS_PER_FILE 3
+
+typedef struct
+{
+  GMainLoop *loop;
+  guint n_pending;
+  guint n_loaded;
+  guint n_failed;
+  /* filename -> first EmpathyAvatar delivered for it */
+  GHashTable *avatars;
+} Fixture;
+
+static void
+loaded_cb (GObject *object,
+    const gchar *filename,
+    EmpathyAvatar *avatar,
+    gpointer user_data)
+{
+  Fixture *fixture = user_data;
+  EmpathyAvatar *first;
+
+  if (avatar != NULL)
+    {
+      fixture->n_loaded++;
+      g_assert_cmpstr (avatar->filename, ==, filename);
+      g_assert_cmpstr (avatar->format, ==, "image/png");
+
+      /* Requests for the same file are coalesced */
+      first = g_hash_table_lookup (fixture->avatars, filename);
+      if (first == NULL)
+        g_hash_table_insert (fixture->avatars, g_strdup (filename),
+            empathy_avatar_ref (avatar));
+      else
+        g_assert (first == avatar);
+    }
+  else
+    {
+      fixture->n_failed++;
+    }
+
+  fixture->n_pending--;
+  if (fixture->n_pending == 0)
+    g_main_loop_quit (fixture->loop);
+}
+
+static void
+not_called_cb (GObject *object,
+    const gchar *filename,
+    EmpathyAvatar *avatar,
+    gpointer user_data)
+{
+  g_assert_not_reached ();
+}
+
+static void
+test_avatar_loader_load (void)
+{
+  EmpathyAvatarLoader *loader;
+  Fixture fixture = { NULL, };
+  GPtrArray *objects;
+  GObject *gone;
+  gchar *dir, *missing;
+  gchar *filenames[N_FILES];
+  guint i, j;
+
+  dir = g_dir_make_tmp ("empathy-avatar-loader-test-XXXXXX", NULL);
+  g_assert (dir != NULL);
+
+  for (i = 0; i < N_FILES; i++)
+    {
+      gchar *data;
+
+      filenames[i] = g_strdup_printf ("%s/avatar%u", dir, i);
+      data = g_strdup_printf ("avatar %u", i);
+      g_assert (g_file_set_contents (filenames[i], data, -1, NULL));
+      g_free (data);
+    }
+
+  missing = g_build_filename (dir, "missing", NULL);
+
+  fixture.loop = g_main_loop_new (NULL, FALSE);
+  fixture.avatars = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, (GDestroyNotify) empathy_avatar_unref);
+  objects = g_ptr_array_new_with_free_func (g_object_unref);
+  loader = empathy_avatar_loader_dup_singleton ();
+
+  for (j = 0; j < N_OBJECTS_PER_FILE; j++)
+    {
+      for (i = 0; i < N_FILES; i++)
+        {
+          GObject *object = g_object_new (G_TYPE_OBJECT, NULL);
+
+          g_ptr_array_add (objects, object);
+          empathy_avatar_loader_load (loader, filenames[i], "image/png",
+              object, loaded_cb, &fixture);
+          fixture.n_pending++;
+        }
+    }
+
+  g_ptr_array_add (objects, g_object_new (G_TYPE_OBJECT, NULL));
+  empathy_avatar_loader_load (loader, missing, "image/png",
+      g_ptr_array_index (objects, objects->len - 1), loaded_cb, &fixture);
+  fixture.n_pending++;
+
+  /* Objects finalized before their avatar is read are forgotten */
+  gone = g_object_new (G_TYPE_OBJECT, NULL);
+  empathy_avatar_loader_load (loader, filenames[0], "image/png", gone,
+      not_called_cb, NULL);
+  g_object_unref (gone);
+
+  g_object_unref (loader);
+  g_main_loop_run (fixture.loop);
+
+  g_assert_cmpuint (fixture.n_loaded, ==, N_FILES * N_OBJECTS_PER_FILE);
+  g_assert_cmpuint (fixture.n_failed, ==, 1);
+  g_assert_cmpuint (g_hash_table_size (fixture.avatars), ==, N_FILES);
+
+  for (i = 0; i < N_FILES; i++)
+    {
+      EmpathyAvatar *avatar;
+      gchar *data;
+
+      avatar = g_hash_table_lookup (fixture.avatars, filenames[i]);
+      data = g_strdup_printf ("avatar %u", i);
+      g_assert_cmpuint (avatar->len, ==, strlen (data));
+      g_assert (memcmp (avatar->data, data, avatar->len) == 0);
+      g_free (data);
+
+      g_unlink (filenames[i]);
+      g_free (filenames[i]);
+    }
+
+  g_rmdir (dir);
+  g_free (dir);
+  g_free (missing);
+  g_ptr_array_unref (objects);
+  g_hash_table_unref (fixture.avatars);
+  g_main_loop_unref (fixture.loop);
+}
+
+int
+main (int argc,
+    char **argv)
+{
+  int result;
+
+  test_init (argc, argv);
+
+  g_test_add_func ("/avatar-loader/load", test_avatar_loader_load);
+
+  result = g_test_run ();
+  test_deinit ();
+
+  return result;
+}
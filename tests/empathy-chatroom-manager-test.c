@@ -3,7 +3,9 @@
 #include <string.h>
 #include <glib/gstdio.h>
 
+#include <telepathy-glib/account.h>
 #include <telepathy-glib/account-manager.h>
+#include <telepathy-glib/dbus.h>
 #include <telepathy-glib/util.h>
 
 #include <libempathy/empathy-chatroom-manager.h>
@@ -382,6 +384,58 @@ START_TEST (test_empathy_chatroom_manager_change_chatroom)
 END_TEST
 #endif
 
+static void
+test_empathy_chatroom_manager_duplicate (void)
+{
+  EmpathyChatroomManager *mgr;
+  EmpathyChatroom *first, *second;
+  TpDBusDaemon *dbus;
+  TpAccount *account;
+  GError *error = NULL;
+  gchar *dir, *file;
+
+  dbus = tp_dbus_daemon_dup (&error);
+  g_assert_no_error (error);
+
+  account = tp_account_new (dbus,
+      TP_ACCOUNT_OBJECT_PATH_BASE "fake/fake/account", &error);
+  g_assert_no_error (error);
+
+  dir = g_dir_make_tmp ("empathy-chatroom-manager-test-XXXXXX", NULL);
+  g_assert (dir != NULL);
+  file = g_build_filename (dir, CHATROOM_FILE, NULL);
+
+  mgr = empathy_chatroom_manager_dup_singleton (file);
+
+  first = empathy_chatroom_new_full (account, "room1", "name1", FALSE);
+  second = empathy_chatroom_new_full (account, "room2", "name2", FALSE);
+  g_assert (empathy_chatroom_manager_add (mgr, first));
+  g_assert (empathy_chatroom_manager_add (mgr, second));
+
+  /* Both chatrooms now have the same room; the one added last is found */
+  empathy_chatroom_set_room (second, "room1");
+  g_assert (empathy_chatroom_manager_find (mgr, account, "room1") == second);
+  g_assert (empathy_chatroom_manager_find (mgr, account, "room2") == NULL);
+
+  /* Removing it leaves the other one */
+  empathy_chatroom_manager_remove (mgr, second);
+  g_assert (empathy_chatroom_manager_find (mgr, account, "room1") == first);
+
+  empathy_chatroom_manager_remove (mgr, first);
+  g_assert (empathy_chatroom_manager_find (mgr, account, "room1") == NULL);
+
+  g_object_unref (mgr);
+  g_object_unref (first);
+  g_object_unref (second);
+  g_object_unref (account);
+  g_object_unref (dbus);
+
+  g_unlink (file);
+  g_rmdir (dir);
+  g_free (file);
+  g_free (dir);
+}
+
 int
 main (int argc,
     char **argv)
@@ -401,6 +455,8 @@ main (int argc,
   g_test_add_func ("/chatroom-manager/change-chatroom",
       test_empathy_chatroom_manager_change_chatroom);
 #endif
+  g_test_add_func ("/chatroom-manager/duplicate",
+      test_empathy_chatroom_manager_duplicate);
 
   result = g_test_run ();
   test_deinit ();
@@ -0,0 +1,309 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <telepathy-glib/enums.h>
+#include <telepathy-glib/util.h>
+
+#include "test-helper.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_TESTS
+#include <libempathy/empathy-debug.h>
+
+#include "empathy-debug-model.h"
+
+#define CACHE_SIZE 8
+#define N_MESSAGES (CACHE_SIZE * 3 + 3)
+
+typedef struct
+{
+  const gchar *domain;
+  guint level;
+  gchar *message;
+} Message;
+
+typedef struct
+{
+  guint max_level;
+  const gchar *domain;
+} Filter;
+
+static Filter filters[] = {
+  { TP_DEBUG_LEVEL_DEBUG, NULL },
+  { TP_DEBUG_LEVEL_WARNING, NULL },
+  { TP_DEBUG_LEVEL_DEBUG, "a" },
+  { TP_DEBUG_LEVEL_WARNING, "a" },
+  { TP_DEBUG_LEVEL_DEBUG, "c" },
+  { TP_DEBUG_LEVEL_ERROR, "unknown" },
+};
+
+static void
+message_init (Message *message,
+    guint i)
+{
+  static const gchar * const domains[] = { "a", "b", "a", "c", "b" };
+  static const guint levels[] = { TP_DEBUG_LEVEL_DEBUG,
+      TP_DEBUG_LEVEL_WARNING, TP_DEBUG_LEVEL_INFO, TP_DEBUG_LEVEL_ERROR };
+
+  message->domain = domains[i % G_N_ELEMENTS (domains)];
+  message->level = levels[i % G_N_ELEMENTS (levels)];
+  message->message = g_strdup_printf ("message %u", i);
+}
+
+static gboolean
+filter_matches (Filter *filter,
+    Message *message)
+{
+  return message->level <= filter->max_level &&
+      (filter->domain == NULL || !tp_strdiff (filter->domain,
+          message->domain));
+}
+
+/* The indexes of the messages from @first to @last matching @filter */
+static GArray *
+expected_rows (Filter *filter,
+    Message *messages,
+    guint first,
+    guint last)
+{
+  GArray *rows = g_array_new (FALSE, FALSE, sizeof (guint));
+  guint i;
+
+  for (i = first; i < last; i++)
+    {
+      if (filter_matches (filter, &messages[i]))
+        g_array_append_val (rows, i);
+    }
+
+  return rows;
+}
+
+static void
+check_row (GtkTreeModel *model,
+    GtkTreeIter *iter,
+    gint row,
+    Message *expected)
+{
+  GtkTreePath *path;
+  gchar *domain, *message;
+  guint level;
+
+  path = gtk_tree_model_get_path (model, iter);
+  g_assert_cmpint (gtk_tree_path_get_depth (path), ==, 1);
+  g_assert_cmpint (gtk_tree_path_get_indices (path)[0], ==, row);
+  gtk_tree_path_free (path);
+
+  gtk_tree_model_get (model, iter,
+      EMPATHY_DEBUG_MODEL_COL_DOMAIN, &domain,
+      EMPATHY_DEBUG_MODEL_COL_LEVEL_VALUE, &level,
+      EMPATHY_DEBUG_MODEL_COL_MESSAGE, &message,
+      -1);
+
+  g_assert_cmpstr (domain, ==, expected->domain);
+  g_assert_cmpuint (level, ==, expected->level);
+  g_assert_cmpstr (message, ==, expected->message);
+
+  g_free (domain);
+  g_free (message);
+}
+
+static void
+check_model (GtkTreeModel *model,
+    Filter *filter,
+    Message *messages,
+    guint first,
+    guint last)
+{
+  GArray *rows;
+  GtkTreeIter iter;
+  gboolean valid;
+  guint i;
+
+  rows = expected_rows (filter, messages, first, last);
+
+  g_assert_cmpint (gtk_tree_model_iter_n_children (model, NULL), ==,
+      rows->len);
+
+  for (i = 0; i < rows->len; i++)
+    {
+      g_assert (gtk_tree_model_iter_nth_child (model, &iter, NULL, i));
+      check_row (model, &iter, i,
+          &messages[g_array_index (rows, guint, i)]);
+    }
+
+  g_assert (!gtk_tree_model_iter_nth_child (model, &iter, NULL, rows->len));
+
+  /* Walking the rows gives the same ones */
+  valid = gtk_tree_model_get_iter_first (model, &iter);
+  for (i = 0; valid; i++)
+    {
+      g_assert_cmpuint (i, <, rows->len);
+      check_row (model, &iter, i,
+          &messages[g_array_index (rows, guint, i)]);
+      valid = gtk_tree_model_iter_next (model, &iter);
+    }
+
+  g_assert_cmpuint (i, ==, rows->len);
+
+  g_array_unref (rows);
+}
+
+static void
+row_inserted_cb (GtkTreeModel *model,
+    GtkTreePath *path,
+    GtkTreeIter *iter,
+    GString *events)
+{
+  GtkTreePath *iter_path;
+
+  /* The new row can be used right away */
+  iter_path = gtk_tree_model_get_path (model, iter);
+  g_assert (gtk_tree_path_compare (path, iter_path) == 0);
+  gtk_tree_path_free (iter_path);
+
+  g_string_append_printf (events, "inserted %d;",
+      gtk_tree_path_get_indices (path)[0]);
+}
+
+static void
+row_deleted_cb (GtkTreeModel *model,
+    GtkTreePath *path,
+    GString *events)
+{
+  g_string_append_printf (events, "deleted %d;",
+      gtk_tree_path_get_indices (path)[0]);
+}
+
+static void
+test_debug_model_filters (void)
+{
+  Message messages[N_MESSAGES];
+  guint f, i;
+
+  for (i = 0; i < N_MESSAGES; i++)
+    message_init (&messages[i], i);
+
+  for (f = 0; f < G_N_ELEMENTS (filters); f++)
+    {
+      Filter *filter = &filters[f];
+      EmpathyDebugCache *cache;
+      EmpathyDebugModel *model;
+      GString *events, *expected;
+
+      DEBUG ("Filter %u: level %u, domain %s", f, filter->max_level,
+          filter->domain != NULL ? filter->domain : "(all)");
+
+      cache = empathy_debug_cache_new (CACHE_SIZE);
+      model = empathy_debug_model_new ();
+      empathy_debug_model_set_cache (model, cache);
+      empathy_debug_model_set_filter (model, filter->max_level,
+          filter->domain);
+
+      events = g_string_new (NULL);
+      expected = g_string_new (NULL);
+      g_signal_connect (model, "row-inserted", G_CALLBACK (row_inserted_cb),
+          events);
+      g_signal_connect (model, "row-deleted", G_CALLBACK (row_deleted_cb),
+          events);
+
+      for (i = 0; i < N_MESSAGES; i++)
+        {
+          guint first = i < CACHE_SIZE ? 0 : i + 1 - CACHE_SIZE;
+          GArray *rows;
+
+          /* Once the cache is full, the oldest message goes away before the
+           * new one is added */
+          g_string_truncate (expected, 0);
+          if (i >= CACHE_SIZE &&
+              filter_matches (filter, &messages[i - CACHE_SIZE]))
+            g_string_append (expected, "deleted 0;");
+
+          if (filter_matches (filter, &messages[i]))
+            {
+              rows = expected_rows (filter, messages, first, i + 1);
+              g_string_append_printf (expected, "inserted %u;",
+                  rows->len - 1);
+              g_array_unref (rows);
+            }
+
+          g_string_truncate (events, 0);
+          empathy_debug_model_append (model, i, messages[i].domain,
+              messages[i].level, messages[i].message);
+
+          g_assert_cmpstr (events->str, ==, expected->str);
+          check_model (GTK_TREE_MODEL (model), filter, messages, first,
+              i + 1);
+        }
+
+      /* Changing the filter of a full cache which has wrapped */
+      for (i = 0; i < G_N_ELEMENTS (filters); i++)
+        {
+          empathy_debug_model_set_filter (model, filters[i].max_level,
+              filters[i].domain);
+          check_model (GTK_TREE_MODEL (model), &filters[i], messages,
+              N_MESSAGES - CACHE_SIZE, N_MESSAGES);
+        }
+
+      empathy_debug_model_clear_cache (model);
+      g_assert_cmpint (gtk_tree_model_iter_n_children (
+            GTK_TREE_MODEL (model), NULL), ==, 0);
+
+      g_string_free (events, TRUE);
+      g_string_free (expected, TRUE);
+      g_object_unref (model);
+      empathy_debug_cache_free (cache);
+    }
+
+  for (i = 0; i < N_MESSAGES; i++)
+    g_free (messages[i].message);
+}
+
+static void
+test_debug_model_domains (void)
+{
+  EmpathyDebugCache *cache;
+  EmpathyDebugModel *model;
+  GList *domains;
+
+  cache = empathy_debug_cache_new (2);
+  model = empathy_debug_model_new ();
+  empathy_debug_model_set_cache (model, cache);
+
+  empathy_debug_model_append (model, 0, "b/category", TP_DEBUG_LEVEL_DEBUG,
+      "first");
+  empathy_debug_model_append (model, 1, "a", TP_DEBUG_LEVEL_DEBUG,
+      "second");
+  empathy_debug_model_append (model, 2, "a", TP_DEBUG_LEVEL_DEBUG,
+      "third");
+
+  /* All the messages of b were dropped, but it can still be picked */
+  domains = empathy_debug_model_get_domains (model);
+  g_assert_cmpuint (g_list_length (domains), ==, 2);
+  g_assert_cmpstr (domains->data, ==, "a");
+  g_assert_cmpstr (domains->next->data, ==, "b");
+  g_list_free (domains);
+
+  empathy_debug_model_set_filter (model, TP_DEBUG_LEVEL_DEBUG, "b");
+  g_assert_cmpint (gtk_tree_model_iter_n_children (GTK_TREE_MODEL (model),
+        NULL), ==, 0);
+
+  g_object_unref (model);
+  empathy_debug_cache_free (cache);
+}
+
+int
+main (int argc,
+    char **argv)
+{
+  int result;
+
+  test_init (argc, argv);
+
+  g_test_add_func ("/debug-model/filters", test_debug_model_filters);
+  g_test_add_func ("/debug-model/domains", test_debug_model_domains);
+
+  result = g_test_run ();
+  test_deinit ();
+
+  return result;
+}
@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <glib/gstdio.h>
+
+#include "test-helper.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_TESTS
+#include <libempathy/empathy-debug.h>
+
+#include <libempathy/empathy-file-store.h>
+
+typedef struct
+{
+  const gchar *contents;
+  guint n_serialized;
+} Data;
+
+static gchar *
+serialize (gsize *length,
+    gpointer user_data)
+{
+  Data *data = user_data;
+
+  data->n_serialized++;
+
+  if (data->contents == NULL)
+    return NULL;
+
+  *length = strlen (data->contents);
+  return g_strdup (data->contents);
+}
+
+static void
+assert_contents (const gchar *filename,
+    const gchar *expected)
+{
+  gchar *contents;
+
+  g_assert (g_file_get_contents (filename, &contents, NULL, NULL));
+  g_assert_cmpstr (contents, ==, expected);
+  g_free (contents);
+}
+
+static guint
+count_files (const gchar *dirname)
+{
+  GDir *dir;
+  guint n = 0;
+
+  dir = g_dir_open (dirname, 0, NULL);
+  g_assert (dir != NULL);
+
+  while (g_dir_read_name (dir) != NULL)
+    n++;
+
+  g_dir_close (dir);
+
+  return n;
+}
+
+static void
+test_file_store_coalesce (void)
+{
+  Data data = { NULL, 0 };
+  gchar *dir, *filename;
+  guint i;
+
+  dir = g_dir_make_tmp ("empathy-file-store-test-XXXXXX", NULL);
+  g_assert (dir != NULL);
+  filename = g_build_filename (dir, "file", NULL);
+
+  /* Changes are only serialized once the file is written */
+  for (i = 0; i < 10; i++)
+    {
+      data.contents = i % 2 ? "odd" : "even";
+      empathy_file_store_schedule (filename, 60, serialize, &data);
+    }
+
+  g_assert_cmpuint (data.n_serialized, ==, 0);
+
+  empathy_file_store_flush (filename);
+  g_assert_cmpuint (data.n_serialized, ==, 1);
+  assert_contents (filename, "odd");
+
+  /* Nothing left to flush */
+  empathy_file_store_flush (filename);
+  g_assert_cmpuint (data.n_serialized, ==, 1);
+
+  /* The temporary file was renamed */
+  g_assert_cmpuint (count_files (dir), ==, 1);
+
+  g_unlink (filename);
+  g_rmdir (dir);
+  g_free (filename);
+  g_free (dir);
+}
+
+static gboolean
+quit_cb (gpointer user_data)
+{
+  g_main_loop_quit (user_data);
+
+  return FALSE;
+}
+
+static void
+test_file_store_delay (void)
+{
+  Data data = { "contents", 0 };
+  GMainLoop *loop;
+  gchar *dir, *filename;
+
+  dir = g_dir_make_tmp ("empathy-file-store-test-XXXXXX", NULL);
+  g_assert (dir != NULL);
+  filename = g_build_filename (dir, "file", NULL);
+
+  empathy_file_store_schedule (filename, 0, serialize, &data);
+
+  /* Timeouts in seconds can fire up to a second late */
+  loop = g_main_loop_new (NULL, FALSE);
+  g_timeout_add (2000, quit_cb, loop);
+  g_main_loop_run (loop);
+  g_main_loop_unref (loop);
+
+  g_assert_cmpuint (data.n_serialized, ==, 1);
+
+  /* Waits for the writer */
+  empathy_file_store_flush (filename);
+  g_assert_cmpuint (data.n_serialized, ==, 1);
+  assert_contents (filename, "contents");
+
+  g_unlink (filename);
+  g_rmdir (dir);
+  g_free (filename);
+  g_free (dir);
+}
+
+static void
+test_file_store_flush_all (void)
+{
+  Data first = { "first", 0 }, second = { "second", 0 }, none = { NULL, 0 };
+  gchar *dir, *subdir, *first_file, *second_file, *none_file;
+
+  dir = g_dir_make_tmp ("empathy-file-store-test-XXXXXX", NULL);
+  g_assert (dir != NULL);
+
+  /* Missing directories are created */
+  subdir = g_build_filename (dir, "subdir", NULL);
+  first_file = g_build_filename (subdir, "first", NULL);
+  second_file = g_build_filename (dir, "second", NULL);
+  none_file = g_build_filename (dir, "none", NULL);
+
+  empathy_file_store_schedule (first_file, 60, serialize, &first);
+  empathy_file_store_schedule (second_file, 60, serialize, &second);
+  empathy_file_store_schedule (none_file, 60, serialize, &none);
+
+  empathy_file_store_flush_all ();
+
+  g_assert_cmpuint (first.n_serialized, ==, 1);
+  g_assert_cmpuint (second.n_serialized, ==, 1);
+  g_assert_cmpuint (none.n_serialized, ==, 1);
+
+  assert_contents (first_file, "first");
+  assert_contents (second_file, "second");
+  g_assert (!g_file_test (none_file, G_FILE_TEST_EXISTS));
+
+  g_unlink (first_file);
+  g_unlink (second_file);
+  g_rmdir (subdir);
+  g_rmdir (dir);
+  g_free (first_file);
+  g_free (second_file);
+  g_free (none_file);
+  g_free (subdir);
+  g_free (dir);
+}
+
+static guint
+file_mode (const gchar *filename)
+{
+  GStatBuf buf;
+
+  g_assert (g_stat (filename, &buf) == 0);
+
+  return buf.st_mode & 0777;
+}
+
+static void
+test_file_store_mode (void)
+{
+  Data data = { "contents", 0 };
+  gchar *dir, *filename;
+  mode_t mask;
+
+  dir = g_dir_make_tmp ("empathy-file-store-test-XXXXXX", NULL);
+  g_assert (dir != NULL);
+  filename = g_build_filename (dir, "file", NULL);
+
+  /* New files are created like any other, according to the umask */
+  mask = umask (022);
+  empathy_file_store_schedule (filename, 60, serialize, &data);
+  empathy_file_store_flush (filename);
+  umask (mask);
+  g_assert_cmpuint (file_mode (filename), ==, 0644);
+
+  /* Replacing a file keeps its mode */
+  g_assert (g_chmod (filename, 0600) == 0);
+  empathy_file_store_schedule (filename, 60, serialize, &data);
+  empathy_file_store_flush (filename);
+  g_assert_cmpuint (file_mode (filename), ==, 0600);
+
+  g_assert (g_chmod (filename, 0640) == 0);
+  empathy_file_store_schedule (filename, 60, serialize, &data);
+  empathy_file_store_flush (filename);
+  g_assert_cmpuint (file_mode (filename), ==, 0640);
+
+  g_assert_cmpuint (data.n_serialized, ==, 3);
+
+  g_unlink (filename);
+  g_rmdir (dir);
+  g_free (filename);
+  g_free (dir);
+}
+
+int
+main (int argc,
+    char **argv)
+{
+  int result;
+
+  test_init (argc, argv);
+
+  g_test_add_func ("/file-store/coalesce", test_file_store_coalesce);
+  g_test_add_func ("/file-store/delay", test_file_store_delay);
+  g_test_add_func ("/file-store/flush-all", test_file_store_flush_all);
+  g_test_add_func ("/file-store/mode", test_file_store_mode);
+
+  result = g_test_run ();
+  test_deinit ();
+
+  return result;
+}
@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test-helper.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_TESTS
+#include <libempathy/empathy-debug.h>
+
+#include <libempathy/empathy-ft-handler-internal.h>
+
+/* Same as EmpathyFTHandler */
+#define BUFFER_SIZE (1024 * 1024)
+
+typedef struct
+{
+  const gchar *name;
+  GChecksumType type;
+} HashType;
+
+static TpFileHashType
+choose_hash_type (const gchar *protocol,
+    const guint *offered,
+    guint n_offered)
+{
+  GArray *array;
+  TpFileHashType type;
+
+  array = g_array_new (FALSE, FALSE, sizeof (guint));
+  g_array_append_vals (array, offered, n_offered);
+
+  type = _empathy_ft_handler_choose_hash_type (protocol, array);
+
+  g_array_unref (array);
+
+  return type;
+}
+
+static void
+test_ft_hash_choose (void)
+{
+  const guint all[] = { TP_FILE_HASH_TYPE_SHA256, TP_FILE_HASH_TYPE_SHA1,
+      TP_FILE_HASH_TYPE_MD5 };
+  const guint sha[] = { TP_FILE_HASH_TYPE_SHA256, TP_FILE_HASH_TYPE_SHA1 };
+  const guint sha256[] = { TP_FILE_HASH_TYPE_SHA256 };
+  const guint with_none[] = { TP_FILE_HASH_TYPE_NONE,
+      TP_FILE_HASH_TYPE_SHA256 };
+  const guint unknown[] = { TP_FILE_HASH_TYPE_NONE, 42 };
+
+  /* The cheapest one, whatever the order */
+  g_assert_cmpuint (choose_hash_type ("jabber", all, G_N_ELEMENTS (all)), ==,
+      TP_FILE_HASH_TYPE_MD5);
+  g_assert_cmpuint (choose_hash_type ("jabber", sha, G_N_ELEMENTS (sha)), ==,
+      TP_FILE_HASH_TYPE_SHA1);
+  g_assert_cmpuint (choose_hash_type ("jabber", sha256,
+        G_N_ELEMENTS (sha256)), ==, TP_FILE_HASH_TYPE_SHA256);
+
+  /* Types we can't compute are never picked */
+  g_assert_cmpuint (choose_hash_type ("jabber", with_none,
+        G_N_ELEMENTS (with_none)), ==, TP_FILE_HASH_TYPE_SHA256);
+  g_assert_cmpuint (choose_hash_type ("jabber", unknown,
+        G_N_ELEMENTS (unknown)), ==, TP_FILE_HASH_TYPE_NONE);
+  g_assert_cmpuint (choose_hash_type ("jabber", NULL, 0), ==,
+      TP_FILE_HASH_TYPE_NONE);
+
+  /* Files sent to people nearby aren't hashed */
+  g_assert_cmpuint (choose_hash_type ("local-xmpp", all, G_N_ELEMENTS (all)),
+      ==, TP_FILE_HASH_TYPE_NONE);
+  g_assert_cmpuint (choose_hash_type ("local-xmpp", sha256,
+        G_N_ELEMENTS (sha256)), ==, TP_FILE_HASH_TYPE_NONE);
+}
+
+static void
+test_ft_hash_benchmark (void)
+{
+  /* Cheapest first, as EmpathyFTHandler ranks them */
+  const HashType types[] =
+    {
+      { "MD5", G_CHECKSUM_MD5 },
+      { "SHA1", G_CHECKSUM_SHA1 },
+      { "SHA256", G_CHECKSUM_SHA256 },
+    };
+  const guint64 sizes[] =
+    {
+      G_GUINT64_CONSTANT (100) * 1024 * 1024,
+      G_GUINT64_CONSTANT (1024) * 1024 * 1024,
+      G_GUINT64_CONSTANT (4096) * 1024 * 1024,
+    };
+  guchar *buffer;
+  GTimer *timer;
+  guint i, j;
+
+  if (!g_test_perf ())
+    return;
+
+  /* The files are fed from memory, so only the hashing itself is measured
+   * and not the disk */
+  buffer = g_malloc (BUFFER_SIZE);
+  for (i = 0; i < BUFFER_SIZE; i++)
+    buffer[i] = g_test_rand_int_range (0, 256);
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      for (j = 0; j < G_N_ELEMENTS (types); j++)
+        {
+          GChecksum *checksum;
+          guint64 hashed;
+          gdouble elapsed;
+
+          checksum = g_checksum_new (types[j].type);
+
+          g_timer_start (timer);
+          for (hashed = 0; hashed < sizes[i]; hashed += BUFFER_SIZE)
+            g_checksum_update (checksum, buffer, BUFFER_SIZE);
+          elapsed = g_timer_elapsed (timer, NULL);
+
+          DEBUG ("%s: %s", types[j].name, g_checksum_get_string (checksum));
+
+          g_test_message ("%s: %" G_GUINT64_FORMAT " MiB in %f seconds "
+              "(%.0f MiB/s)", types[j].name, sizes[i] / (1024 * 1024),
+              elapsed, sizes[i] / (1024 * 1024) / elapsed);
+
+          /* What outgoing transfers use when they can */
+          if (types[j].type == G_CHECKSUM_MD5)
+            g_test_minimized_result (elapsed,
+                "MD5: %" G_GUINT64_FORMAT " MiB in %f seconds",
+                sizes[i] / (1024 * 1024), elapsed);
+
+          g_checksum_free (checksum);
+        }
+    }
+
+  g_timer_destroy (timer);
+  g_free (buffer);
+}
+
+int
+main (int argc,
+    char **argv)
+{
+  int result;
+
+  test_init (argc, argv);
+
+  g_test_add_func ("/ft-hash/choose", test_ft_hash_choose);
+  g_test_add_func ("/ft-hash/benchmark", test_ft_hash_benchmark);
+
+  result = g_test_run ();
+  test_deinit ();
+
+  return result;
+}
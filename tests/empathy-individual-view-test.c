@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <folks/folks.h>
+
+#include "test-helper.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_TESTS
+#include <libempathy/empathy-debug.h>
+
+#include <libempathy-gtk/empathy-individual-store.h>
+#include <libempathy-gtk/empathy-individual-view.h>
+#include <libempathy-gtk/empathy-individual-view-private.h>
+#include <libempathy-gtk/empathy-live-search.h>
+
+#define N_GROUPS 100
+#define N_CONTACTS_PER_GROUP 99
+
+static const gchar *first_names[] =
+  {
+    "John", "Johanna", "Jonathan", "Joseph", "Julia", "Alice", "Bob",
+    "Xavier", "Guillaume", "Danielle", "Emilio", "Gaëtan", "Jörgen",
+  };
+
+static const gchar *last_names[] =
+  {
+    "Smith", "Claessens", "Desmottes", "Johnson", "Jones", "Pocock",
+    "Madeley", "Élève", "Thompson", "Jordan", "Miller",
+  };
+
+typedef struct
+{
+  EmpathyIndividualStore *store;
+  EmpathyIndividualView *view;
+  EmpathyLiveSearch *search;
+  /* FolksIndividual -> owned name */
+  GHashTable *names;
+  guint n_matches;
+} Fixture;
+
+/* The individuals have no personas, so they're matched by the names they
+ * were given */
+static gboolean
+match_func (FolksIndividual *individual,
+    const gchar *text,
+    GPtrArray *words,
+    gpointer user_data)
+{
+  Fixture *fixture = user_data;
+
+  fixture->n_matches++;
+
+  return empathy_live_search_match (fixture->search,
+      g_hash_table_lookup (fixture->names, individual));
+}
+
+static void
+fixture_setup (Fixture *fixture)
+{
+  GeeSet *personas;
+  guint i, j;
+
+  personas = GEE_SET (gee_hash_set_new (FOLKS_TYPE_PERSONA, g_object_ref,
+        g_object_unref, g_direct_hash, g_direct_equal));
+  fixture->names = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+  /* 100 groups of 99 contacts, 10k rows */
+  fixture->store = g_object_new (EMPATHY_TYPE_INDIVIDUAL_STORE, NULL);
+  for (i = 0; i < N_GROUPS; i++)
+    {
+      GtkTreeIter group_iter;
+      gchar *group;
+
+      group = g_strdup_printf ("Group %u", i);
+      gtk_tree_store_insert_with_values (GTK_TREE_STORE (fixture->store),
+          &group_iter, NULL, -1,
+          EMPATHY_INDIVIDUAL_STORE_COL_NAME, group,
+          EMPATHY_INDIVIDUAL_STORE_COL_IS_GROUP, TRUE,
+          -1);
+      g_free (group);
+
+      for (j = 0; j < N_CONTACTS_PER_GROUP; j++)
+        {
+          GtkTreeIter iter;
+          FolksIndividual *individual;
+          gchar *name;
+
+          name = g_strdup_printf ("%s %s %u",
+              first_names[(i + j) % G_N_ELEMENTS (first_names)],
+              last_names[(i * j) % G_N_ELEMENTS (last_names)], j);
+          individual = folks_individual_new (personas);
+          gtk_tree_store_insert_with_values (GTK_TREE_STORE (fixture->store),
+              &iter, &group_iter, -1,
+              EMPATHY_INDIVIDUAL_STORE_COL_NAME, name,
+              EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, individual,
+              EMPATHY_INDIVIDUAL_STORE_COL_IS_GROUP, FALSE,
+              EMPATHY_INDIVIDUAL_STORE_COL_IS_ONLINE, TRUE,
+              -1);
+          g_hash_table_insert (fixture->names, individual, name);
+          g_object_unref (individual);
+        }
+    }
+
+  g_object_unref (personas);
+
+  fixture->view = empathy_individual_view_new (fixture->store, 0, 0);
+  g_object_ref_sink (fixture->view);
+  /* Individuals without personas are uninteresting */
+  empathy_individual_view_set_show_uninteresting (fixture->view, TRUE);
+  empathy_individual_view_set_match_func (fixture->view, match_func, fixture);
+
+  fixture->search = EMPATHY_LIVE_SEARCH (empathy_live_search_new (
+      GTK_WIDGET (fixture->view)));
+  g_object_ref_sink (fixture->search);
+  empathy_individual_view_set_live_search (fixture->view, fixture->search);
+
+  empathy_individual_view_refilter (fixture->view);
+}
+
+static void
+fixture_teardown (Fixture *fixture)
+{
+  empathy_individual_view_set_live_search (fixture->view, NULL);
+  gtk_widget_destroy (GTK_WIDGET (fixture->search));
+  g_object_unref (fixture->search);
+  gtk_widget_destroy (GTK_WIDGET (fixture->view));
+  g_object_unref (fixture->view);
+  g_object_unref (fixture->store);
+  g_hash_table_unref (fixture->names);
+}
+
+static gboolean
+count_visible_contacts_foreach (GtkTreeModel *model,
+    GtkTreePath *path,
+    GtkTreeIter *iter,
+    guint *count)
+{
+  if (gtk_tree_path_get_depth (path) > 1)
+    (*count)++;
+
+  return FALSE;
+}
+
+static guint
+count_visible_contacts (Fixture *fixture)
+{
+  GtkTreeModel *model;
+  guint count = 0;
+
+  model = gtk_tree_view_get_model (GTK_TREE_VIEW (fixture->view));
+  gtk_tree_model_foreach (model,
+      (GtkTreeModelForeachFunc) count_visible_contacts_foreach, &count);
+
+  return count;
+}
+
+static gboolean
+count_matching_contacts_foreach (GtkTreeModel *model,
+    GtkTreePath *path,
+    GtkTreeIter *iter,
+    gpointer user_data)
+{
+  const gchar *text = ((gpointer *) user_data)[0];
+  guint *count = ((gpointer *) user_data)[1];
+  gchar *name;
+
+  if (gtk_tree_path_get_depth (path) == 1)
+    return FALSE;
+
+  gtk_tree_model_get (model, iter,
+      EMPATHY_INDIVIDUAL_STORE_COL_NAME, &name,
+      -1);
+
+  if (empathy_live_search_match_string (name, text))
+    (*count)++;
+
+  g_free (name);
+
+  return FALSE;
+}
+
+static guint
+count_matching_contacts (Fixture *fixture,
+    const gchar *text)
+{
+  guint count = 0;
+  gpointer data[] = { (gpointer) text, &count };
+
+  gtk_tree_model_foreach (GTK_TREE_MODEL (fixture->store),
+      count_matching_contacts_foreach, data);
+
+  return count;
+}
+
+static void
+test_individual_view_search (void)
+{
+  /* Growing, shrinking and replaced queries */
+  const gchar *queries[] =
+    {
+      "j", "jo", "joh", "john", "john s", "john", "jo", "jul", "x", "ele",
+      "élèv", "", "g",
+      NULL
+    };
+  Fixture fixture = { NULL, };
+  guint i;
+
+  fixture_setup (&fixture);
+
+  for (i = 0; queries[i] != NULL; i++)
+    {
+      guint visible;
+
+      fixture.n_matches = 0;
+      empathy_live_search_set_text (fixture.search, queries[i]);
+
+      visible = count_visible_contacts (&fixture);
+      DEBUG ("'%s': %u contacts, %u matched", queries[i], visible,
+          fixture.n_matches);
+      g_assert_cmpuint (visible, ==,
+          count_matching_contacts (&fixture, queries[i]));
+
+      /* When the search text grows, only the individuals which matched the
+       * previous one are matched again */
+      if (i > 0 && *queries[i - 1] != '\0' &&
+          g_str_has_prefix (queries[i], queries[i - 1]))
+        g_assert_cmpuint (fixture.n_matches, <=,
+            count_matching_contacts (&fixture, queries[i - 1]));
+    }
+
+  fixture_teardown (&fixture);
+}
+
+static void
+test_individual_view_search_benchmark (void)
+{
+  const gchar *queries[] = { "j", "jo", "joh", "john", "john s", NULL };
+  Fixture fixture = { NULL, };
+  GTimer *timer;
+  gdouble incremental, full;
+  guint incremental_matches, full_matches;
+  guint i;
+
+  if (!g_test_perf ())
+    return;
+
+  fixture_setup (&fixture);
+  timer = g_timer_new ();
+
+  /* Typing: every row is checked, but only the individuals which matched
+   * the previous text are matched again */
+  fixture.n_matches = 0;
+  g_timer_start (timer);
+  for (i = 0; queries[i] != NULL; i++)
+    empathy_live_search_set_text (fixture.search, queries[i]);
+  incremental = g_timer_elapsed (timer, NULL);
+  incremental_matches = fixture.n_matches;
+
+  /* Same queries, matching every individual again */
+  empathy_live_search_set_text (fixture.search, "");
+  full = 0;
+  full_matches = 0;
+  for (i = 0; queries[i] != NULL; i++)
+    {
+      guint matches;
+
+      empathy_live_search_set_text (fixture.search, queries[i]);
+
+      matches = fixture.n_matches;
+      g_timer_start (timer);
+      empathy_individual_view_refilter (fixture.view);
+      full += g_timer_elapsed (timer, NULL);
+      full_matches += fixture.n_matches - matches;
+    }
+
+  g_test_message ("Full refilter: %u individuals matched in %f seconds",
+      full_matches, full);
+  g_test_minimized_result (incremental,
+      "Typing: %u individuals matched in %f seconds",
+      incremental_matches, incremental);
+
+  g_timer_destroy (timer);
+  fixture_teardown (&fixture);
+}
+
+int
+main (int argc,
+    char **argv)
+{
+  int result;
+
+  test_init (argc, argv);
+
+  g_test_add_func ("/individual-view/search",
+      test_individual_view_search);
+  g_test_add_func ("/individual-view/search-benchmark",
+      test_individual_view_search_benchmark);
+
+  result = g_test_run ();
+  test_deinit ();
+
+  return result;
+}
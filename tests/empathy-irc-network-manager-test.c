@@ -788,6 +788,79 @@ test_empathy_irc_network_manager_find_network_by_address (void)
   g_object_unref (mgr);
 }
 
+static void
+check_test_server (EmpathyIrcNetworkManager *mgr,
+    const gchar *name)
+{
+  EmpathyIrcNetwork *network;
+  struct server_t test_servers[] = {
+    { "irc.test.org", 6669, TRUE }};
+
+  network = empathy_irc_network_manager_find_network_by_address (mgr,
+      "irc.test.org");
+  g_assert (network != NULL);
+  check_network (network, name, "ISO-8859-1", test_servers, 1);
+}
+
+static void
+test_global_file_cache (void)
+{
+  EmpathyIrcNetworkManager *mgr;
+  EmpathyIrcNetwork *network;
+  EmpathyIrcServer *server;
+  GSList *networks;
+  gchar *global_file, *contents, *renamed;
+  gchar **split;
+
+  copy_xml_file (GLOBAL_SAMPLE, "global-irc-networks.xml");
+  global_file = get_user_xml_file ("global-irc-networks.xml");
+
+  /* Parses the file and writes the cache, if it was not there already */
+  mgr = empathy_irc_network_manager_new (global_file, NULL);
+  check_test_server (mgr, "Test Server");
+  g_object_unref (mgr);
+
+  /* Loaded from the cache */
+  mgr = empathy_irc_network_manager_new (global_file, NULL);
+  networks = empathy_irc_network_manager_get_networks (mgr);
+  g_assert_cmpuint (g_slist_length (networks), ==, 4);
+  g_slist_foreach (networks, (GFunc) g_object_unref, NULL);
+  g_slist_free (networks);
+  check_test_server (mgr, "Test Server");
+
+  /* The address index follows changes of the servers */
+  network = empathy_irc_network_manager_find_network_by_address (mgr,
+      "irc.test.org");
+  server = empathy_irc_server_new ("irc.example.org", 6667, FALSE);
+  empathy_irc_network_append_server (network, server);
+  g_assert (empathy_irc_network_manager_find_network_by_address (mgr,
+        "irc.example.org") == network);
+  g_object_set (server, "address", "irc2.example.org", NULL);
+  g_assert (empathy_irc_network_manager_find_network_by_address (mgr,
+        "irc.example.org") == NULL);
+  g_assert (empathy_irc_network_manager_find_network_by_address (mgr,
+        "irc2.example.org") == network);
+  g_object_unref (server);
+  g_object_unref (mgr);
+
+  /* Changing the global file makes the cache out of date; the size changes
+   * too as the mtime could be the same */
+  g_assert (g_file_get_contents (global_file, &contents, NULL, NULL));
+  split = g_strsplit (contents, "Test Server", -1);
+  renamed = g_strjoinv ("Tested Server", split);
+  g_assert (g_file_set_contents (global_file, renamed, -1, NULL));
+  g_strfreev (split);
+  g_free (contents);
+  g_free (renamed);
+
+  mgr = empathy_irc_network_manager_new (global_file, NULL);
+  check_test_server (mgr, "Tested Server");
+  g_object_unref (mgr);
+
+  g_unlink (global_file);
+  g_free (global_file);
+}
+
 static void
 test_no_modify_with_empty_user_file (void)
 {
@@ -817,11 +890,46 @@ test_no_modify_with_empty_user_file (void)
   g_object_unref (mgr);
 }
 
+/* Removes the directory and the files in it and in its subdirectories */
+static void
+remove_dir (const gchar *dirname)
+{
+  GDir *dir;
+  const gchar *name;
+
+  dir = g_dir_open (dirname, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      gchar *path = g_build_filename (dirname, name, NULL);
+
+      if (g_file_test (path, G_FILE_TEST_IS_DIR))
+        remove_dir (path);
+      else
+        g_unlink (path);
+
+      g_free (path);
+    }
+
+  g_dir_close (dir);
+  g_rmdir (dirname);
+}
+
 int
 main (int argc,
     char **argv)
 {
   int result;
+  gchar *cache_dir;
+
+  /* Caches of the global files are written there rather than in the
+   * user's cache. Has to be set before anything looks it up. */
+  cache_dir = g_dir_make_tmp ("empathy-irc-network-manager-test-XXXXXX",
+      NULL);
+  g_assert (cache_dir != NULL);
+  g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
 
   test_init (argc, argv);
 
@@ -842,8 +950,14 @@ main (int argc,
       test_empathy_irc_network_manager_find_network_by_address);
   g_test_add_func ("/irc-network-manager/no-modify-with-empty-user-file",
       test_no_modify_with_empty_user_file);
+  g_test_add_func ("/irc-network-manager/global-file-cache",
+      test_global_file_cache);
 
   result = g_test_run ();
   test_deinit ();
+
+  remove_dir (cache_dir);
+  g_free (cache_dir);
+
   return result;
 }
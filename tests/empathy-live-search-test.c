@@ -46,6 +46,10 @@ test_live_search (void)
       { "Foo Bar Baz", "   b  ", TRUE },
       { "Foo Bar Baz", "bar bazz", FALSE },
 
+      /* A prefix can go on in the next word */
+      { "Hello World", "hellow", TRUE },
+      { "Hello World", "hellor", FALSE },
+
       { NULL, NULL, FALSE }
     };
   guint i;
@@ -53,6 +57,7 @@ test_live_search (void)
   DEBUG ("Started");
   for (i = 0; tests[i].string != NULL; i ++)
     {
+      GPtrArray *string_words, *words;
       gboolean match;
       gboolean ok;
 
@@ -64,6 +69,18 @@ test_live_search (void)
           ok ? "OK" : "FAILED");
 
       g_assert (ok);
+
+      /* Same result when the string has been stripped beforehand */
+      string_words = empathy_live_search_strip_utf8_string (tests[i].string);
+      words = empathy_live_search_strip_utf8_string (tests[i].prefix);
+
+      match = empathy_live_search_match_stripped_words (string_words, words);
+      g_assert (match == tests[i].should_match);
+
+      if (string_words != NULL)
+        g_ptr_array_unref (string_words);
+      if (words != NULL)
+        g_ptr_array_unref (words);
     }
 }
 
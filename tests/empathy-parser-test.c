@@ -10,6 +10,7 @@
 #include <libempathy/empathy-debug.h>
 
 #include <libempathy-gtk/empathy-string-parser.h>
+#include <libempathy-gtk/empathy-webkit-utils.h>
 
 static void
 test_replace_match (const gchar *text,
@@ -117,10 +118,107 @@ test_parsers (void)
       DEBUG ("'%s' => '%s': %s", tests[i], string->str, ok ? "OK" : "FAILED");
       g_assert (ok);
 
+      /* The single pass parser must give the same result */
+      g_string_truncate (string, 0);
+      empathy_string_parser_fused (tests[i], -1, test_replace_match,
+          test_replace_match, NULL, string);
+
+      ok = !tp_strdiff (tests[i + 1], string->str);
+      DEBUG ("fused: '%s' => '%s': %s", tests[i], string->str,
+          ok ? "OK" : "FAILED");
+      g_assert (ok);
+
       g_string_free (string, TRUE);
     }
 }
 
+static void
+test_parsers_fused (void)
+{
+  const gchar *tests[] =
+    {
+      "",
+      "plain text",
+      "http://foo.com\nwww.bar.com :)\r\n<b>&amp;</b>",
+      "first.last@server.com@mail.server.org.",
+      "mailto:a@b@c.d.e'?; mailto:@x.y",
+      "http://x.org/?q='a'&b=\"c\" :-D\tftp.foo.org/(bar)",
+      "ünïcödé http://fôô.com/bär :) ¿qué?\u00a0www.test.com\u00a0",
+      "control \x01\x1f\x7f \xc2\x80\xc2\x85 chars",
+      NULL
+    };
+  guint i;
+
+  for (i = 0; tests[i] != NULL; i++)
+    {
+      GString *chained, *fused;
+
+      chained = g_string_new (NULL);
+      fused = g_string_new (NULL);
+
+      empathy_string_parser_substr (tests[i], -1,
+          empathy_webkit_get_string_parser (TRUE), chained);
+      empathy_webkit_parse_text (tests[i], -1, TRUE, fused);
+
+      DEBUG ("'%s' => '%s'", tests[i], fused->str);
+      g_assert_cmpstr (chained->str, ==, fused->str);
+
+      g_string_free (chained, TRUE);
+      g_string_free (fused, TRUE);
+    }
+}
+
+static void
+test_parsers_benchmark (void)
+{
+  GString *text, *string;
+  GTimer *timer;
+  gdouble chained, fused;
+  guint i;
+
+  if (!g_test_perf ())
+    return;
+
+  /* Long pasted messages, with a few links and smileys */
+  text = g_string_new (NULL);
+  for (i = 0; i < 200; i++)
+    {
+      g_string_append (text, "Lorem ipsum dolor sit amet, \"consectetur\" "
+          "adipiscing elit; sed do eiusmod <tempor> incididunt & co.\n");
+      if (i % 10 == 0)
+        g_string_append (text, "See http://www.example.com/a?b=c or "
+            "mail first.last@example.com :-)\n");
+    }
+
+  string = g_string_new (NULL);
+  timer = g_timer_new ();
+
+  for (i = 0; i < 100; i++)
+    {
+      g_string_truncate (string, 0);
+      empathy_string_parser_substr (text->str, text->len,
+          empathy_webkit_get_string_parser (TRUE), string);
+    }
+  chained = g_timer_elapsed (timer, NULL);
+
+  g_timer_start (timer);
+  for (i = 0; i < 100; i++)
+    {
+      g_string_truncate (string, 0);
+      empathy_webkit_parse_text (text->str, text->len, TRUE, string);
+    }
+  fused = g_timer_elapsed (timer, NULL);
+
+  g_test_message ("Chained parsers: parsed %" G_GSIZE_FORMAT
+      " bytes 100 times in %f seconds", text->len, chained);
+  g_test_minimized_result (fused, "Single pass parser: parsed %"
+      G_GSIZE_FORMAT " bytes 100 times in %f seconds", text->len, fused);
+
+  g_timer_destroy (timer);
+  g_string_free (string, TRUE);
+  g_string_free (text, TRUE);
+}
+
 int
 main (int argc,
     char **argv)
@@ -130,6 +228,8 @@ main (int argc,
   test_init (argc, argv);
 
   g_test_add_func ("/parsers", test_parsers);
+  g_test_add_func ("/parsers/fused", test_parsers_fused);
+  g_test_add_func ("/parsers/benchmark", test_parsers_benchmark);
 
   result = g_test_run ();
   test_deinit ();
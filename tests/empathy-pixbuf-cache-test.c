@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test-helper.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_TESTS
+#include <libempathy/empathy-debug.h>
+
+#include <libempathy-gtk/empathy-pixbuf-cache.h>
+
+static GdkPixbuf *
+new_pixbuf (gint size)
+{
+  return gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+}
+
+static gsize
+pixbuf_size (GdkPixbuf *pixbuf)
+{
+  return gdk_pixbuf_get_rowstride (pixbuf) * gdk_pixbuf_get_height (pixbuf);
+}
+
+static void
+test_pixbuf_cache_lookup (void)
+{
+  EmpathyPixbufCache *cache;
+  GdkPixbuf *small, *big, *pixbuf;
+
+  cache = empathy_pixbuf_cache_new (1024 * 1024);
+  small = new_pixbuf (32);
+  big = new_pixbuf (48);
+
+  g_assert (empathy_pixbuf_cache_lookup (cache, "a", 32, 32) == NULL);
+
+  empathy_pixbuf_cache_insert (cache, "a", 32, 32, small);
+  empathy_pixbuf_cache_insert (cache, "a", 48, 48, big);
+  g_assert_cmpuint (empathy_pixbuf_cache_get_size (cache), ==,
+      pixbuf_size (small) + pixbuf_size (big));
+
+  /* Same avatar, different sizes */
+  pixbuf = empathy_pixbuf_cache_lookup (cache, "a", 32, 32);
+  g_assert (pixbuf == small);
+  g_object_unref (pixbuf);
+
+  pixbuf = empathy_pixbuf_cache_lookup (cache, "a", 48, 48);
+  g_assert (pixbuf == big);
+  g_object_unref (pixbuf);
+
+  g_assert (empathy_pixbuf_cache_lookup (cache, "b", 32, 32) == NULL);
+
+  /* Replacing */
+  empathy_pixbuf_cache_insert (cache, "a", 32, 32, big);
+  g_assert_cmpuint (empathy_pixbuf_cache_get_size (cache), ==,
+      2 * pixbuf_size (big));
+
+  empathy_pixbuf_cache_free (cache);
+  g_object_unref (small);
+  g_object_unref (big);
+}
+
+static void
+test_pixbuf_cache_budget (void)
+{
+  EmpathyPixbufCache *cache;
+  GdkPixbuf *pixbuf, *found;
+
+  pixbuf = new_pixbuf (32);
+  cache = empathy_pixbuf_cache_new (3 * pixbuf_size (pixbuf));
+
+  empathy_pixbuf_cache_insert (cache, "a", 32, 32, pixbuf);
+  empathy_pixbuf_cache_insert (cache, "b", 32, 32, pixbuf);
+  empathy_pixbuf_cache_insert (cache, "c", 32, 32, pixbuf);
+
+  /* "a" is now the most recently used, so "b" goes away */
+  found = empathy_pixbuf_cache_lookup (cache, "a", 32, 32);
+  g_assert (found != NULL);
+  g_object_unref (found);
+
+  empathy_pixbuf_cache_insert (cache, "d", 32, 32, pixbuf);
+  g_assert_cmpuint (empathy_pixbuf_cache_get_size (cache), ==,
+      3 * pixbuf_size (pixbuf));
+
+  g_assert (empathy_pixbuf_cache_lookup (cache, "b", 32, 32) == NULL);
+
+  found = empathy_pixbuf_cache_lookup (cache, "a", 32, 32);
+  g_assert (found != NULL);
+  g_object_unref (found);
+
+  found = empathy_pixbuf_cache_lookup (cache, "c", 32, 32);
+  g_assert (found != NULL);
+  g_object_unref (found);
+
+  g_object_unref (pixbuf);
+
+  /* Bigger than the whole budget */
+  pixbuf = new_pixbuf (64);
+  empathy_pixbuf_cache_insert (cache, "e", 64, 64, pixbuf);
+  g_assert (empathy_pixbuf_cache_lookup (cache, "e", 64, 64) == NULL);
+  g_object_unref (pixbuf);
+
+  empathy_pixbuf_cache_free (cache);
+}
+
+int
+main (int argc,
+    char **argv)
+{
+  int result;
+
+  test_init (argc, argv);
+
+  g_test_add_func ("/pixbuf-cache/lookup", test_pixbuf_cache_lookup);
+  g_test_add_func ("/pixbuf-cache/budget", test_pixbuf_cache_budget);
+
+  result = g_test_run ();
+  test_deinit ();
+
+  return result;
+}
@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test-helper.h"
+
+#include <telepathy-glib/util.h>
+
+#define DEBUG_FLAG EMPATHY_DEBUG_TESTS
+#include <libempathy/empathy-debug.h>
+
+#include <libempathy-gtk/empathy-smiley-manager.h>
+
+typedef struct
+{
+  const gchar *text;
+  /* start and end of each expected hit, terminated by -1 */
+  gint hits[7];
+} SmileyTest;
+
+static void
+test_smiley_manager_parse (void)
+{
+  SmileyTest tests[] =
+    {
+      { "no smiley here", { -1 } },
+      { ":)", { 0, 2, -1 } },
+      { "a:)b", { 1, 3, -1 } },
+      { ">:)", { 0, 3, -1 } },
+      /* Backtracking: ">:(" is not a smiley but ":(" is */
+      { ">:(", { 1, 3, -1 } },
+      /* Longest match */
+      { ":-))", { 0, 4, -1 } },
+      { ":):(", { 0, 2, 2, 4, -1 } },
+      { "héhé :-D ünïcödé ;)", { 7, 10, 23, 25, -1 } },
+      { NULL, }
+    };
+  EmpathySmileyManager *manager;
+  GArray *hits;
+  guint i;
+
+  manager = empathy_smiley_manager_dup_singleton ();
+  hits = g_array_new (FALSE, FALSE, sizeof (EmpathySmileyHit));
+
+  for (i = 0; tests[i].text != NULL; i++)
+    {
+      guint n_hits, j;
+
+      g_array_set_size (hits, 0);
+      n_hits = empathy_smiley_manager_parse_len (manager, tests[i].text, -1,
+          hits);
+      g_assert_cmpuint (n_hits, ==, hits->len);
+
+      for (j = 0; tests[i].hits[j * 2] != -1; j++)
+        {
+          EmpathySmileyHit *hit;
+
+          g_assert_cmpuint (j, <, hits->len);
+
+          hit = &g_array_index (hits, EmpathySmileyHit, j);
+          g_assert_cmpuint (hit->start, ==, tests[i].hits[j * 2]);
+          g_assert_cmpuint (hit->end, ==, tests[i].hits[j * 2 + 1]);
+          g_assert (hit->pixbuf != NULL);
+        }
+
+      g_assert_cmpuint (j, ==, hits->len);
+    }
+
+  g_array_unref (hits);
+  g_object_unref (manager);
+}
+
+static void
+test_smiley_manager_benchmark (void)
+{
+  EmpathySmileyManager *manager;
+  GArray *hits;
+  GString *text;
+  GTimer *timer;
+  guint i, n_hits = 0;
+
+  if (!g_test_perf ())
+    return;
+
+  /* Mostly plain text, with the odd smiley, like real conversations */
+  text = g_string_new (NULL);
+  for (i = 0; i < 1000; i++)
+    {
+      g_string_append (text, "Lorem ipsum dolor sit amet, consectetur "
+          "adipiscing elit: sed do eiusmod (tempor) incididunt ");
+      if (i % 10 == 0)
+        g_string_append (text, ":-) ");
+    }
+
+  manager = empathy_smiley_manager_dup_singleton ();
+  hits = g_array_new (FALSE, FALSE, sizeof (EmpathySmileyHit));
+
+  timer = g_timer_new ();
+  for (i = 0; i < 100; i++)
+    {
+      g_array_set_size (hits, 0);
+      n_hits += empathy_smiley_manager_parse_len (manager, text->str,
+          text->len, hits);
+    }
+  g_timer_stop (timer);
+
+  g_assert_cmpuint (n_hits, ==, 100 * 100);
+  g_test_minimized_result (g_timer_elapsed (timer, NULL),
+      "Parsed %" G_GSIZE_FORMAT " bytes 100 times in %f seconds",
+      text->len, g_timer_elapsed (timer, NULL));
+
+  g_timer_destroy (timer);
+  g_array_unref (hits);
+  g_object_unref (manager);
+  g_string_free (text, TRUE);
+}
+
+int
+main (int argc,
+    char **argv)
+{
+  int result;
+
+  test_init (argc, argv);
+
+  g_test_add_func ("/smiley-manager/parse", test_smiley_manager_parse);
+  g_test_add_func ("/smiley-manager/benchmark",
+      test_smiley_manager_benchmark);
+
+  result = g_test_run ();
+  test_deinit ();
+
+  return result;
+}
@@ -0,0 +1,147 @@
+#!/bin/sh
+# empathy-startup-benchmark.sh - time cold starts of the empathy binary
+#
+# usage: empathy-startup-benchmark.sh [number of runs]
+#
+# Each run starts empathy on its own temporary D-Bus session bus, so Mission
+# Control and the other services are activated as they are when logging in,
+# and with empty XDG directories, so none of our caches are warm. There is one
+# account, on the fake connection manager described in tests/test.manager,
+# and empathy is started with --no-connect so the connection manager doesn't
+# have to exist.
+#
+# A run ends when empathy reaches the $EVENT trace event: "startup-complete"
+# once the account manager is prepared, or "roster-window-drawn" once the
+# roster has been painted for the first time. The Chrome trace-event files
+# are kept, so they can be loaded in chrome://tracing.
+#
+# If /proc/sys/vm/drop_caches is writable (ie, when running as root), the
+# page cache is dropped before each run as well.
+#
+# Environment:
+#   EMPATHY          the empathy binary (default: src/empathy)
+#   EMPATHY_SRCDIR   the top source directory (default: the parent directory
+#                    of this script's)
+#   EVENT            the trace event timed (default: startup-complete)
+#   TIMEOUT          seconds to wait for each run (default: 60)
+
+set -e
+
+me=`basename "$0"`
+EMPATHY_SRCDIR=${EMPATHY_SRCDIR:-`dirname "$0"`/..}
+EMPATHY=${EMPATHY:-src/empathy}
+EVENT=${EVENT:-startup-complete}
+TIMEOUT=${TIMEOUT:-60}
+
+# Runs empathy once, on the bus set up by with-session-bus.sh
+run_once ()
+{
+  home="$1"
+  trace="$2"
+
+  mkdir -p "$home/data/telepathy/mission-control"
+  cat > "$home/data/telepathy/mission-control/accounts.cfg" <<EOF
+[test/test/benchmark0]
+manager=test
+protocol=test
+DisplayName=Benchmark
+Enabled=true
+ConnectAutomatically=false
+EOF
+
+  XDG_CONFIG_HOME="$home/config" \
+  XDG_DATA_HOME="$home/data" \
+  XDG_CACHE_HOME="$home/cache" \
+  MC_MANAGER_DIR="$EMPATHY_SRCDIR/tests" \
+  MC_PROFILE_DIR="$EMPATHY_SRCDIR/tests" \
+  EMPATHY_TRACE_FILE="$trace" \
+    "$EMPATHY" --no-connect > "$home/empathy.log" 2>&1 &
+  pid=$!
+
+  # The trace is written atomically, so it's complete once it exists
+  waited=0
+  until test -f "$trace" && grep -q "\"$EVENT\"" "$trace"; do
+    if ! kill -0 $pid 2> /dev/null; then
+      echo "$me: empathy exited early, see $home/empathy.log" >&2
+      exit 1
+    fi
+
+    if test $waited -ge `expr $TIMEOUT \* 10`; then
+      echo "$me: timed out, see $home/empathy.log" >&2
+      kill $pid
+      exit 1
+    fi
+
+    sleep 0.1
+    waited=`expr $waited + 1`
+  done
+
+  kill $pid
+  wait $pid || true
+}
+
+if test "z$1" = "z--run"; then
+  run_once "$2" "$3"
+  exit 0
+fi
+
+runs=${1:-5}
+tmpdir=`mktemp -d "${TMPDIR:-/tmp}/empathy-startup-benchmark-XXXXXX"`
+results="$tmpdir/results"
+
+# with-session-bus.sh needs a writable current directory
+cd "$tmpdir"
+case "$EMPATHY" in
+  /*) ;;
+  *) EMPATHY="$OLDPWD/$EMPATHY" ;;
+esac
+case "$EMPATHY_SRCDIR" in
+  /*) ;;
+  *) EMPATHY_SRCDIR="$OLDPWD/$EMPATHY_SRCDIR" ;;
+esac
+export EMPATHY EMPATHY_SRCDIR EVENT TIMEOUT
+
+script="$EMPATHY_SRCDIR/tests/$me"
+
+i=1
+while test $i -le $runs; do
+  if test -w /proc/sys/vm/drop_caches; then
+    sync
+    echo 3 > /proc/sys/vm/drop_caches
+  fi
+
+  trace="$tmpdir/trace-$i.json"
+
+  sh "$EMPATHY_SRCDIR/tools/with-session-bus.sh" --session -- \
+    sh "$script" --run "$tmpdir/home-$i" "$trace"
+
+  # Timestamps are in microseconds since empathy's main()
+  sed -n "s/.*\"name\":\"$EVENT\".*\"ts\":\([0-9]*\).*/\1/p" "$trace" \
+    >> "$results"
+  echo "run $i: `tail -n1 "$results" | awk '{ printf "%.1f", $1 / 1000 }'` ms"
+
+  i=`expr $i + 1`
+done
+
+sort -n "$results" | awk '
+  { t[NR] = $1 / 1000; sum += t[NR] }
+  END {
+    printf "'"$EVENT"' over %d runs: min %.1f ms, median %.1f ms, " \
+      "mean %.1f ms, max %.1f ms\n", NR, t[1], t[int ((NR + 1) / 2)],
+      sum / NR, t[NR]
+  }'
+
+echo "Phases of the last run:"
+sed -n 's/.*"name":"\([^"]*\)".*"ph":"X".*"dur":\([0-9]*\).*/\2 \1/p' \
+  "$tmpdir/trace-$runs.json" | \
+  awk '{ printf "  %-28s %8.1f ms\n", $2, $1 / 1000 }'
+sed -n 's/.*"name":"\([^"]*\)".*"ph":"\([be]\)","ts":\([0-9]*\).*"id":\([0-9]*\).*/\4 \2 \3 \1/p' \
+  "$tmpdir/trace-$runs.json" | \
+  awk '{
+    if ($2 == "b")
+      begin[$1] = $3
+    else
+      printf "  %-28s %8.1f ms (async)\n", $4, ($3 - begin[$1]) / 1000
+  }'
+
+echo "Traces are in $tmpdir"
@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test-helper.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_TESTS
+#include <libempathy/empathy-debug.h>
+
+#include <libempathy/empathy-timer-wheel.h>
+#include <libempathy/empathy-timer-wheel-internal.h>
+
+#define TIMEOUT 2
+
+typedef struct
+{
+  EmpathyTimerWheel *wheel;
+  /* The items passed to the callback, separated by spaces, with ';' after
+   * each tick */
+  GString *fired;
+  guint n_destroyed;
+  /* Items starting with this are added again when they expire */
+  const gchar *reschedule_prefix;
+} Test;
+
+static Test *current_test = NULL;
+
+static void
+item_destroy (gpointer item)
+{
+  current_test->n_destroyed++;
+  g_free (item);
+}
+
+static void
+expired_cb (GPtrArray *expired,
+    gpointer user_data)
+{
+  Test *test = user_data;
+  guint i;
+
+  for (i = 0; i < expired->len; i++)
+    {
+      const gchar *item = g_ptr_array_index (expired, i);
+
+      g_string_append_printf (test->fired, "%s%s", i > 0 ? " " : "", item);
+
+      /* Expired items are destroyed after this, so add a copy */
+      if (test->reschedule_prefix != NULL &&
+          g_str_has_prefix (item, test->reschedule_prefix))
+        empathy_timer_wheel_add (test->wheel, g_strconcat (item, "'", NULL));
+    }
+
+  g_string_append_c (test->fired, ';');
+}
+
+static void
+setup (Test *test,
+    gconstpointer data)
+{
+  test->wheel = empathy_timer_wheel_new (TIMEOUT, expired_cb, test,
+      item_destroy);
+  test->fired = g_string_new (NULL);
+  test->n_destroyed = 0;
+  test->reschedule_prefix = NULL;
+
+  current_test = test;
+}
+
+static void
+teardown (Test *test,
+    gconstpointer data)
+{
+  empathy_timer_wheel_free (test->wheel);
+  g_string_free (test->fired, TRUE);
+
+  current_test = NULL;
+}
+
+static void
+add (Test *test,
+    const gchar *item)
+{
+  empathy_timer_wheel_add (test->wheel, g_strdup (item));
+}
+
+/* Ticks, and checks what expired */
+static void
+tick (Test *test,
+    const gchar *expected)
+{
+  g_string_truncate (test->fired, 0);
+  _empathy_timer_wheel_tick (test->wheel);
+  g_assert_cmpstr (test->fired->str, ==, expected);
+}
+
+static void
+test_timer_wheel_order (Test *test,
+    gconstpointer data)
+{
+  /* Items expire TIMEOUT + 1 ticks after they were added, those of the
+   * same tick together in the order they were added */
+  add (test, "a");
+  add (test, "b");
+  tick (test, "");
+  add (test, "c");
+  tick (test, "");
+  tick (test, "a b;");
+  tick (test, "c;");
+  tick (test, "");
+
+  g_assert_cmpuint (test->n_destroyed, ==, 3);
+}
+
+static void
+test_timer_wheel_wrap (Test *test,
+    gconstpointer data)
+{
+  guint i;
+
+  /* Go around the wheel a few times, with an item in each slot */
+  for (i = 0; i < (TIMEOUT + 2) * 3; i++)
+    {
+      gchar *item, *expected;
+
+      item = g_strdup_printf ("%u", i);
+      add (test, item);
+      g_free (item);
+
+      if (i >= TIMEOUT)
+        expected = g_strdup_printf ("%u;", i - TIMEOUT);
+      else
+        expected = g_strdup ("");
+
+      tick (test, expected);
+      g_free (expected);
+    }
+
+  g_assert_cmpuint (test->n_destroyed, ==, (TIMEOUT + 2) * 3 - TIMEOUT);
+}
+
+static void
+test_timer_wheel_reschedule (Test *test,
+    gconstpointer data)
+{
+  guint i;
+
+  /* Items can be added again from the callback; they wait as long as new
+   * ones, going around the wheel */
+  test->reschedule_prefix = "again";
+
+  add (test, "again");
+  add (test, "once");
+
+  for (i = 0; i < TIMEOUT; i++)
+    tick (test, "");
+
+  tick (test, "again once;");
+
+  for (i = 0; i < TIMEOUT; i++)
+    tick (test, "");
+
+  tick (test, "again';");
+
+  for (i = 0; i < TIMEOUT; i++)
+    tick (test, "");
+
+  tick (test, "again'';");
+  g_assert_cmpuint (test->n_destroyed, ==, 4);
+
+  test->reschedule_prefix = NULL;
+
+  for (i = 0; i < TIMEOUT; i++)
+    tick (test, "");
+
+  tick (test, "again''';");
+  tick (test, "");
+  g_assert_cmpuint (test->n_destroyed, ==, 5);
+}
+
+static void
+test_timer_wheel_cancel (Test *test,
+    gconstpointer data)
+{
+  guint i;
+
+  /* Items in all the slots which don't expire yet, on both sides of the
+   * wrap */
+  for (i = 0; i < TIMEOUT; i++)
+    {
+      add (test, "never");
+      tick (test, "");
+    }
+
+  add (test, "never");
+
+  /* Freeing the wheel destroys them without expiring them */
+  empathy_timer_wheel_free (test->wheel);
+  test->wheel = NULL;
+
+  g_assert_cmpstr (test->fired->str, ==, "");
+  g_assert_cmpuint (test->n_destroyed, ==, TIMEOUT + 1);
+}
+
+int
+main (int argc,
+    char **argv)
+{
+  int result;
+
+  test_init (argc, argv);
+
+  g_test_add ("/timer-wheel/order", Test, NULL,
+      setup, test_timer_wheel_order, teardown);
+  g_test_add ("/timer-wheel/wrap", Test, NULL,
+      setup, test_timer_wheel_wrap, teardown);
+  g_test_add ("/timer-wheel/reschedule", Test, NULL,
+      setup, test_timer_wheel_reschedule, teardown);
+  g_test_add ("/timer-wheel/cancel", Test, NULL,
+      setup, test_timer_wheel_cancel, teardown);
+
+  result = g_test_run ();
+  test_deinit ();
+
+  return result;
+}
@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "test-helper.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_TESTS
+#include <libempathy/empathy-debug.h>
+
+#include <libempathy/empathy-trace.h>
+
+static gchar *trace_dir = NULL;
+static gchar *trace_file = NULL;
+
+/* Returns the line of the trace with the given event */
+static const gchar *
+find_event (gchar **lines,
+    const gchar *name,
+    const gchar *phase)
+{
+  gchar *event;
+  guint i;
+
+  event = g_strdup_printf ("{\"name\":\"%s\",\"cat\":\"empathy\","
+      "\"ph\":\"%s\",", name, phase);
+
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      if (g_str_has_prefix (lines[i], event))
+        break;
+    }
+
+  g_free (event);
+
+  return lines[i];
+}
+
+static void
+test_trace_dump (void)
+{
+  gchar *contents;
+  gchar **lines;
+  gint64 outer, inner, async;
+
+  outer = empathy_trace_begin ();
+  async = empathy_trace_begin ();
+  inner = empathy_trace_begin ();
+  g_usleep (1000);
+  empathy_trace_end ("inner", inner);
+  empathy_trace_end ("outer", outer);
+  empathy_trace_mark ("mark");
+  empathy_trace_end_async ("async \"quoted\"", async);
+
+  g_assert (empathy_trace_dump ());
+  g_assert (g_file_get_contents (trace_file, &contents, NULL, NULL));
+
+  g_assert (g_str_has_prefix (contents, "{\"traceEvents\":[\n"));
+  g_assert (g_str_has_suffix (contents, "}\n"));
+
+  /* One event per line */
+  lines = g_strsplit (contents, "\n", 0);
+  g_assert_cmpuint (g_strv_length (lines), ==, 8);
+
+  g_assert (find_event (lines, "inner", "X") != NULL);
+  g_assert (find_event (lines, "outer", "X") != NULL);
+  g_assert (find_event (lines, "mark", "i") != NULL);
+  g_assert (find_event (lines, "async \\\"quoted\\\"", "b") != NULL);
+  g_assert (find_event (lines, "async \\\"quoted\\\"", "e") != NULL);
+  g_assert (find_event (lines, "missing", "X") == NULL);
+
+  /* Nothing is left dangling once the last event's comma is dropped */
+  g_assert (g_str_has_suffix (lines[5], "}"));
+  g_assert_cmpstr (lines[6], ==, "],\"displayTimeUnit\":\"ms\"}");
+
+  g_strfreev (lines);
+  g_free (contents);
+}
+
+int
+main (int argc,
+    char **argv)
+{
+  int result;
+
+  test_init (argc, argv);
+
+  /* Has to be set before the first span starts the clock */
+  trace_dir = g_dir_make_tmp ("empathy-trace-test-XXXXXX", NULL);
+  g_assert (trace_dir != NULL);
+  trace_file = g_build_filename (trace_dir, "trace.json", NULL);
+  g_setenv (EMPATHY_TRACE_FILE_ENV, trace_file, TRUE);
+  empathy_trace_init ();
+
+  g_test_add_func ("/trace/dump", test_trace_dump);
+
+  result = g_test_run ();
+  test_deinit ();
+
+  g_unlink (trace_file);
+  g_rmdir (trace_dir);
+  g_free (trace_file);
+  g_free (trace_dir);
+
+  return result;
+}